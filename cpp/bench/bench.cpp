@@ -0,0 +1,272 @@
+// Benchmarks and the golden-frame check, kept out of the daemon so its
+// global allocator stays the stock one:
+//   raspberrypi_stats_bench --bench-collectors [N]
+//   raspberrypi_stats_bench --bench-effects
+//   raspberrypi_stats_bench --render-fixtures DIR [--update] [--layout FILE]
+#include "stats.h"
+#include "display_backend.h"
+#include "layout.h"
+#include "panel_fx.h"
+#include "ssd1306.h"
+#include "widgets.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <new>
+
+// Count heap allocations so the benchmark can show the collectors stay off
+// the heap: one relaxed increment per operator new.
+static std::atomic<unsigned long> g_allocs{0};
+
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Per-sample cost of StatsCollector::collect(), and of the process ranking
+// on its own
+static int benchCollectors(int samples) {
+    if (samples <= 0) samples = 10000;
+    StatsCollector collector;
+    collector.collect(); // open fds, resolve paths
+
+    unsigned long a0 = g_allocs.load(std::memory_order_relaxed);
+    auto t0 = std::chrono::steady_clock::now();
+    int sink = 0;
+    for (int i = 0; i < samples; ++i) sink += collector.collect().cpu_percent;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    unsigned long allocs = g_allocs.load(std::memory_order_relaxed) - a0;
+
+    printf("collect: samples=%d ns/sample=%lld allocs/sample=%.2f (sink=%d)\n", samples,
+           static_cast<long long>(ns / samples),
+           static_cast<double>(allocs) / samples, sink);
+
+    // The process ranking on its own: it dominates a full collect() and
+    // grows with the process count, so report it per scan
+    ProcessSampler procs;
+    procs.sample();
+    const int scans = samples / 100 > 10 ? samples / 100 : 10;
+    a0 = g_allocs.load(std::memory_order_relaxed);
+    uint64_t scanUs = 0, worstUs = 0;
+    for (int i = 0; i < scans; ++i) {
+        procs.sample();
+        scanUs += procs.scanUs();
+        if (procs.scanUs() > worstUs) worstUs = procs.scanUs();
+    }
+    allocs = g_allocs.load(std::memory_order_relaxed) - a0;
+    printf("procs: scans=%d processes=%d us/scan=%llu worst_us=%llu allocs/scan=%.2f\n", scans,
+           procs.processCount(), static_cast<unsigned long long>(scanUs / static_cast<uint64_t>(scans)),
+           static_cast<unsigned long long>(worstUs), static_cast<double>(allocs) / scans);
+    return 0;
+}
+
+namespace {
+
+struct RenderFixture {
+    const char* name;
+    const char* ip;
+    int cpu, mem, disk;
+    double ghz, temp, volts;
+    uint32_t throttle;
+    uint32_t available;
+};
+
+constexpr uint32_t kAllSources = SRC_IP | SRC_FREQ | SRC_TEMP | SRC_VOLTAGE | SRC_THROTTLE;
+
+// Fixed inputs covering every branch of the portrait layout
+const RenderFixture kFixtures[] = {
+    {"idle",       "42",  3,  21, 40, 0.6, 41.2, 1.2500, 0x0,     kAllSources},
+    {"busy",       "7",   97, 88, 71, 1.8, 78.4, 1.2625, 0x0,     kAllSources},
+    {"throttled",  "193", 100, 64, 55, 1.0, 84.9, 1.2000, 0x50005, kAllSources},
+    {"undervolt",  "12",  45, 33, 90, 1.5, 55.0, 1.1500, 0x0,     kAllSources},
+    {"no-sources", "0",   0,  0,  0,  0.0, 0.0,  0.0,    0x0,     0},
+};
+
+Stats fixtureStats(const RenderFixture& f) {
+    Stats s;
+    std::snprintf(s.ip_last_octet, sizeof(s.ip_last_octet), "%s", f.ip);
+    s.cpu_percent = f.cpu;
+    s.mem_percent = f.mem;
+    s.disk_percent = f.disk;
+    s.cpu_freq_ghz = f.ghz;
+    s.cpu_temp_c = f.temp;
+    s.voltage_v = f.volts;
+    s.throttle_raw = f.throttle;
+    s.throttled = (f.throttle & 0xF) != 0;
+    s.available = f.available;
+    return s;
+}
+
+} // namespace
+
+// Render fixed Stats through the portrait layout, report render time and
+// bytes sent per frame, and compare each frame against
+// DIR/<fixture>_<phase>.pbm (or rewrite them with `update`). With `layout`
+// (a layout file's [32x128] section) frames go through that retained widget
+// tree instead of the built-in screen, so the same goldens check it.
+// Non-zero on any mismatch or missing golden frame.
+static int benchRender(const char* goldenDir, bool update, const WidgetTree* layout) {
+    auto bus = std::make_unique<MockI2CBus>();
+    MockI2CBus* panel = bus.get();
+    SSD1306 oled(std::move(bus), 0x3C);
+    oled.init();
+    PortraitCanvas canvas(oled);
+    // Retained across fixtures, as on a live panel
+    std::unique_ptr<WidgetTree> tree;
+    if (layout) tree = std::make_unique<WidgetTree>(*layout);
+
+    constexpr int kIterations = 2000;
+    int mismatches = 0, missing = 0;
+    for (const RenderFixture& f : kFixtures) {
+        Stats s = fixtureStats(f);
+        for (int phase = 0; phase < 2; ++phase) {
+            bool phaseA = phase == 0;
+            auto t0 = std::chrono::steady_clock::now();
+            if (tree) {
+                ScreenView v = makeScreenView(s, phaseA ? Page::Main : Page::Thermal, 1.20);
+                for (int i = 0; i < kIterations; ++i) tree->render(canvas, v);
+            } else {
+                for (int i = 0; i < kIterations; ++i) renderPortrait(canvas, s, phaseA, 1.20);
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0).count() / kIterations;
+            // Bytes are relative to the previous fixture frame, as on a live panel
+            oled.display();
+
+            // Compare what the emulated panel holds, so the transport path is covered too
+            std::string img = encodePbm(panel->gddram(), SSD1306::WIDTH, SSD1306::HEIGHT);
+            std::string path = std::string(goldenDir) + "/" + f.name + (phaseA ? "_a" : "_b") + ".pbm";
+            const char* verdict = "ok";
+            if (update) {
+                verdict = writeFileAtomic(path, img) ? "written" : "write-failed";
+            } else {
+                std::ifstream in(path, std::ios::binary);
+                std::string golden((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                if (!in && golden.empty()) { verdict = "missing"; ++missing; }
+                else if (golden != img) { verdict = "MISMATCH"; ++mismatches; }
+            }
+            printf("%-10s %c render_ns=%lld bytes=%zu %s\n", f.name, phaseA ? 'A' : 'B',
+                   static_cast<long long>(ns), oled.lastFrameBytes(), verdict);
+        }
+    }
+    printf("frames=%zu mismatches=%d missing=%d\n", sizeof(kFixtures) / sizeof(kFixtures[0]) * 2,
+           mismatches, missing);
+    return (mismatches || missing) ? 1 : 0;
+}
+
+// I2C bytes a 128-step ticker and a blink cost when the host redraws every
+// step, against the hardware scroll of the ticker's page and the inversion
+// and contrast commands
+// (on an emulated SSD1306). Non-zero if the emulated controller ends up in
+// the wrong state.
+static int benchEffects() {
+    auto bus = std::make_unique<MockI2CBus>();
+    MockI2CBus* panel = bus.get();
+    SSD1306 oled(std::move(bus), 0x3C);
+    oled.init();
+    PortraitCanvas canvas(oled);
+    renderPortrait(canvas, fixtureStats(kFixtures[1]), true, 1.20);
+    oled.display();
+    bool ok = true;
+
+    // Ticker: the stats line in the last page, moved one column per step
+    constexpr int kSteps = SSD1306::WIDTH;
+    constexpr int kBand = SSD1306::PAGES - 1;
+    char line[48];
+    formatTicker(makeScreenView(fixtureStats(kFixtures[1]), Page::Main, 1.20), line, sizeof(line));
+    drawTickerBand(canvas, line);
+    oled.markDirty(0, SSD1306::WIDTH - 1, kBand);
+    uint64_t b0 = oled.totalBytesSent();
+    oled.display();
+    const uint64_t tickerSetup = oled.totalBytesSent() - b0;
+    b0 = oled.totalBytesSent();
+    for (int i = 0; i < kSteps; ++i) {
+        uint8_t* row = oled.buffer() + kBand * SSD1306::WIDTH;
+        uint8_t first = row[0];
+        std::memmove(row, row + 1, SSD1306::WIDTH - 1);
+        row[SSD1306::WIDTH - 1] = first;
+        oled.markDirty(0, SSD1306::WIDTH - 1, kBand);
+        oled.display();
+    }
+    const uint64_t softMarquee = oled.totalBytesSent() - b0;
+    b0 = oled.totalBytesSent();
+    ok = oled.startScroll(ScrollDir::Left, kBand, kBand, 64) && panel->scrolling() && ok;
+    const uint64_t hwMarquee = oled.totalBytesSent() - b0;
+    // An unchanged next frame only stops the scroll: the band stays where
+    // the scroll left it, and nothing else is resent
+    b0 = oled.totalBytesSent();
+    oled.display();
+    const uint64_t resume = oled.totalBytesSent() - b0;
+    ok = !panel->scrolling() && ok;
+
+    // Blink: invert, then back, once per phase
+    b0 = oled.totalBytesSent();
+    for (int i = 0; i < 2 * kSteps; ++i) {
+        for (int j = 0; j < SSD1306::WIDTH * SSD1306::PAGES; ++j) oled.buffer()[j] = static_cast<uint8_t>(~oled.buffer()[j]);
+        oled.markAllDirty();
+        oled.display();
+    }
+    const uint64_t softBlink = oled.totalBytesSent() - b0;
+    b0 = oled.totalBytesSent();
+    for (int i = 0; i < 2 * kSteps; ++i) oled.setInverted(i % 2 == 0);
+    const uint64_t hwBlink = oled.totalBytesSent() - b0;
+    ok = !panel->inverted() && ok;
+
+    // One fade period through the animator
+    FxAnimator fade;
+    fade.start(PanelFx::Fade, 0);
+    const int fadeSteps = static_cast<int>(FxAnimator::kFadePeriodMs / FxAnimator::kFadeStepMs);
+    uint8_t dimmest = kDefaultContrast;
+    b0 = oled.totalBytesSent();
+    for (int i = 0; i < fadeSteps; ++i) {
+        uint8_t c = fade.state(static_cast<uint64_t>(i) * FxAnimator::kFadeStepMs * 1000000ull).contrast;
+        if (c < dimmest) dimmest = c;
+        oled.setContrast(c);
+    }
+    const uint64_t hwFade = oled.totalBytesSent() - b0;
+    ok = panel->contrast() != kDefaultContrast && dimmest < kDefaultContrast && ok;
+
+    printf("ticker: steps=%d band_bytes=%llu redraw_bytes=%llu scroll_bytes=%llu resume_bytes=%llu\n", kSteps,
+           static_cast<unsigned long long>(tickerSetup), static_cast<unsigned long long>(softMarquee),
+           static_cast<unsigned long long>(hwMarquee), static_cast<unsigned long long>(resume));
+    printf("blink: phases=%d redraw_bytes=%llu invert_bytes=%llu\n", 2 * kSteps,
+           static_cast<unsigned long long>(softBlink), static_cast<unsigned long long>(hwBlink));
+    printf("fade: steps=%d contrast_bytes=%llu dimmest=%u\n", fadeSteps, static_cast<unsigned long long>(hwFade),
+           dimmest);
+    printf("state=%s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-collectors") == 0) {
+        return benchCollectors(argc >= 3 ? std::atoi(argv[2]) : 0);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-effects") == 0) return benchEffects();
+    if (argc >= 3 && std::strcmp(argv[1], "--render-fixtures") == 0) {
+        bool update = false;
+        const char* layoutPath = nullptr;
+        for (int i = 3; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--update") == 0) update = true;
+            else if (std::strcmp(argv[i], "--layout") == 0 && i + 1 < argc) layoutPath = argv[++i];
+        }
+        LayoutFile layout;
+        std::string err;
+        if (layoutPath && !loadLayoutFile(layoutPath, layout, err)) {
+            fprintf(stderr, "layout: %s\n", err.c_str());
+            return 1;
+        }
+        return benchRender(argv[2], update, layoutPath ? layout.find(32, 128) : nullptr);
+    }
+    fprintf(stderr, "usage: %s --bench-collectors [N] | --bench-effects | "
+                    "--render-fixtures DIR [--update] [--layout FILE]\n", argv[0]);
+    return 2;
+}
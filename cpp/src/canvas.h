@@ -0,0 +1,287 @@
+#pragma once
+#include "font5x7.h"
+#include "ssd1306.h"
+#include <cstdint>
+#include <cstring>
+
+// Orientation of the logical drawing surface relative to the panel.
+// Portrait is the 32x128 layout rotated CCW into the 128x32 panel:
+// (xp, yp) -> (xd = yp, yd = 31 - xp).
+enum class Rotation { Landscape, Portrait };
+
+// Glyphs pre-rotated (and pre-scaled) into device column words. A glyph
+// occupies LINES consecutive device columns; in each, BITS consecutive
+// device rows starting at the glyph's top device row, LSB first.
+template <Rotation R, int S>
+struct FontAtlas {
+    static_assert(S >= 1 && S <= 6, "scale out of range");
+    static constexpr int LINES = (R == Rotation::Portrait ? 7 : 5) * S;
+    static constexpr int BITS = (R == Rotation::Portrait ? 5 : 7) * S;
+
+    uint64_t lines[kFontGlyphs][LINES] = {};
+
+    constexpr FontAtlas() {
+        for (int g = 0; g < kFontGlyphs; ++g) {
+            for (int j = 0; j < LINES; ++j) {
+                uint64_t word = 0;
+                for (int k = 0; k < BITS; ++k) {
+                    // Portrait: device column = glyph row, device row runs
+                    // against glyph columns. Landscape: the font's own layout.
+                    int col = (R == Rotation::Portrait) ? 4 - k / S : j / S;
+                    int row = (R == Rotation::Portrait) ? j / S : k / S;
+                    if ((kFont5x7[g * 5 + col] >> row) & 1u) word |= uint64_t{1} << k;
+                }
+                lines[g][j] = word;
+            }
+        }
+    }
+};
+
+template <Rotation R, int S>
+inline constexpr FontAtlas<R, S> kFontAtlas{};
+
+// Drawing surface over an OLED framebuffer with the panel and rotation fixed
+// at compile time. Every primitive reduces to runs of bits inside one device
+// column, written into page bytes with shifts and masks.
+template <typename P, Rotation R>
+class Canvas {
+public:
+    using PanelType = P;
+    static constexpr int DEV_W = P::WIDTH;
+    static constexpr int DEV_H = P::HEIGHT;
+    static constexpr int PAGES = P::PAGES;
+    static constexpr int W = (R == Rotation::Portrait) ? DEV_H : DEV_W;
+    static constexpr int H = (R == Rotation::Portrait) ? DEV_W : DEV_H;
+
+    explicit Canvas(OledDisplay<P>& dev) : dev_(dev), buf_(dev.buffer()) {}
+
+    void clear() {
+        std::memset(buf_, 0, DEV_W * PAGES);
+        dev_.markAllDirty();
+    }
+
+    void setPixel(int x, int y, bool on = true) {
+        if (x < 0 || x >= W || y < 0 || y >= H) return;
+        int xd = x, yd = y;
+        if constexpr (R == Rotation::Portrait) { xd = y; yd = DEV_H - 1 - x; }
+        uint8_t& byte = buf_[(yd >> 3) * DEV_W + xd];
+        uint8_t bit = static_cast<uint8_t>(1u << (yd & 7));
+        byte = on ? static_cast<uint8_t>(byte | bit) : static_cast<uint8_t>(byte & ~bit);
+    }
+
+    void fillRect(int x, int y, int w, int h, bool on = true) {
+        if (w <= 0 || h <= 0) return;
+        if constexpr (R == Rotation::Portrait) {
+            for (int yy = y; yy < y + h; ++yy) column(yy, DEV_H - x - w, on ? mask(w) : 0, w, true);
+        } else {
+            for (int xx = x; xx < x + w; ++xx) column(xx, y, on ? mask(h) : 0, h, true);
+        }
+    }
+
+    void hline(int x, int y, int w, bool on = true) { fillRect(x, y, w, 1, on); }
+
+    // Primitives don't track what they touch (that would cost a store per
+    // column); clear() marks the whole panel, and code that redraws in
+    // place reports its rectangles here so display() can skip the rest.
+    void markDirty(int x, int y, int w, int h) {
+        if (x < 0) { w += x; x = 0; }
+        if (y < 0) { h += y; y = 0; }
+        if (x + w > W) w = W - x;
+        if (y + h > H) h = H - y;
+        if (w <= 0 || h <= 0) return;
+        int xd0 = x, xd1 = x + w - 1, yd0 = y, yd1 = y + h - 1;
+        if constexpr (R == Rotation::Portrait) {
+            xd0 = y;
+            xd1 = y + h - 1;
+            yd0 = DEV_H - x - w;
+            yd1 = DEV_H - 1 - x;
+        }
+        for (int page = yd0 >> 3; page <= yd1 >> 3; ++page) dev_.markDirty(xd0, xd1, page);
+    }
+
+    // 5x7 text, opaque glyph cells (the 1px gap between glyphs is untouched)
+    void text(int x, int y, const char* s) { blitText<1>(x, y, s, true); }
+
+    void textCentered(int y, const char* s) {
+        int w = static_cast<int>(std::strlen(s)) * 6; // approx, as before
+        int x = (W - w) / 2;
+        if (x < 0) x = 0;
+        text(x, y, s);
+    }
+
+    // Integer-scaled text, transparent (only set pixels are drawn)
+    void scaledText(int x, int y, const char* s, int scale) {
+        switch (scale < 1 ? 1 : (scale > 6 ? 6 : scale)) {
+            case 1: blitText<1>(x, y, s, false); break;
+            case 2: blitText<2>(x, y, s, false); break;
+            case 3: blitText<3>(x, y, s, false); break;
+            case 4: blitText<4>(x, y, s, false); break;
+            case 5: blitText<5>(x, y, s, false); break;
+            default: blitText<6>(x, y, s, false); break;
+        }
+    }
+
+    // Largest integer scale that fits the canvas width, centered
+    void scaledTextCentered(int y, const char* s) {
+        int n = static_cast<int>(std::strlen(s));
+        if (n == 0) return;
+        int baseW = n * 6 - 1;
+        int scale = 1;
+        for (int k = 6; k >= 1; --k) {
+            if (baseW * k <= W) { scale = k; break; }
+        }
+        int x = (W - baseW * scale) / 2;
+        scaledText(x < 0 ? 0 : x, y, s, scale);
+    }
+
+    // Proportional (non-integer) scaling: fill the canvas width, limited by
+    // heightAvail, centered in [topY, topY + heightAvail). The scaled device
+    // column words are cached per (string, area), so an unchanged string
+    // costs one masked write per output line.
+    void textFit(const char* s, int topY, int heightAvail);
+
+private:
+    OledDisplay<P>& dev_;
+    uint8_t* buf_;
+
+    struct FitCache {
+        char text[16] = "";
+        int topY = -1, heightAvail = -1;
+        int lines = 0;       // device columns written
+        int line0 = 0;       // first device column
+        int yd0 = 0, bits = 0;
+        uint64_t words[DEV_W] = {};
+    } fit_;
+
+    static constexpr uint64_t mask(int n) { return n >= 64 ? ~uint64_t{0} : (uint64_t{1} << n) - 1; }
+
+    // Write n bits (bit k -> device row yd0 + k) into device column xd.
+    // Opaque clears the zero bits inside the run, otherwise they're skipped.
+    void column(int xd, int yd0, uint64_t bits, int n, bool opaque) {
+        if (xd < 0 || xd >= DEV_W || n <= 0) return;
+        if (n > 56) {
+            // Keep run + in-page shift within 64 bits (only 64-row panels)
+            column(xd, yd0, bits, 56, opaque);
+            column(xd, yd0 + 56, bits >> 56, n - 56, opaque);
+            return;
+        }
+        if (yd0 < 0) {
+            if (-yd0 >= n) return;
+            bits >>= -yd0;
+            n += yd0;
+            yd0 = 0;
+        }
+        if (yd0 >= DEV_H) return;
+        if (yd0 + n > DEV_H) n = DEV_H - yd0;
+        uint64_t m = mask(n) << (yd0 & 7);
+        uint64_t b = (bits & mask(n)) << (yd0 & 7);
+        uint8_t* p = buf_ + (yd0 >> 3) * DEV_W + xd;
+        for (int page = yd0 >> 3; page < PAGES && m; ++page, m >>= 8, b >>= 8, p += DEV_W) {
+            uint8_t mm = static_cast<uint8_t>(m), bb = static_cast<uint8_t>(b);
+            *p = opaque ? static_cast<uint8_t>((*p & ~mm) | (bb & mm)) : static_cast<uint8_t>(*p | (bb & mm));
+        }
+    }
+
+    template <int S>
+    void blitText(int x, int y, const char* s, bool opaque) {
+        using Atlas = FontAtlas<R, S>;
+        const Atlas& atlas = kFontAtlas<R, S>;
+        for (; *s; ++s) {
+            const uint64_t* lines = atlas.lines[fontGlyphIndex(*s)];
+            if constexpr (R == Rotation::Portrait) {
+                int yd0 = DEV_H - x - Atlas::BITS;
+                for (int j = 0; j < Atlas::LINES; ++j) column(y + j, yd0, lines[j], Atlas::BITS, opaque);
+            } else {
+                for (int j = 0; j < Atlas::LINES; ++j) column(x + j, y, lines[j], Atlas::BITS, opaque);
+            }
+            x += 6 * S; // glyph width + spacing
+        }
+    }
+};
+
+template <typename P, Rotation R>
+void Canvas<P, R>::textFit(const char* s, int topY, int heightAvail) {
+    if (!*s) return;
+    if (heightAvail < 7) heightAvail = 7;
+
+    if (std::strncmp(fit_.text, s, sizeof(fit_.text)) != 0 || fit_.topY != topY ||
+        fit_.heightAvail != heightAvail) {
+        std::strncpy(fit_.text, s, sizeof(fit_.text) - 1);
+        fit_.topY = topY;
+        fit_.heightAvail = heightAvail;
+        fit_.lines = 0;
+
+        // Glyph columns with 1px gaps
+        int n = static_cast<int>(std::strlen(fit_.text));
+        uint8_t cols[sizeof(fit_.text) * 6];
+        int srcCols = 0;
+        for (int i = 0; i < n; ++i) {
+            const uint8_t* glyph = &kFont5x7[fontGlyphIndex(fit_.text[i]) * 5];
+            for (int gc = 0; gc < 5; ++gc) cols[srcCols++] = glyph[gc];
+            if (i != n - 1) cols[srcCols++] = 0x00;
+        }
+
+        // Desired scale to fill width, constrained by height
+        float scale = static_cast<float>(W) / static_cast<float>(srcCols);
+        float maxScaleHeight = static_cast<float>(heightAvail) / 7.0f;
+        if (scale > maxScaleHeight) scale = maxScaleHeight;
+
+        int outW = static_cast<int>(static_cast<float>(srcCols) * scale + 0.5f);
+        if (outW <= 0) return;
+        int outH = static_cast<int>(7.0f * scale + 0.5f);
+        if (outH < 1) outH = 1;
+        if (outW > W) outW = W;
+        if (outH > heightAvail) outH = heightAvail;
+        if (outH > H) outH = H;
+
+        int startX = (W - outW) / 2;
+        if (startX < 0) startX = 0;
+        int startY = topY + (heightAvail - outH) / 2;
+        if (startY < topY) startY = topY;
+
+        // Nearest-neighbour source column/row for every output column/row
+        uint8_t colBits[W];
+        for (int dx = 0; dx < outW; ++dx) {
+            int sx = static_cast<int>((static_cast<float>(dx) + 0.5f) / scale);
+            colBits[dx] = cols[sx < srcCols ? sx : srcCols - 1];
+        }
+        uint8_t srcRow[H];
+        for (int dy = 0; dy < outH; ++dy) {
+            int sy = static_cast<int>((static_cast<float>(dy) + 0.5f) / scale);
+            srcRow[dy] = static_cast<uint8_t>(sy > 6 ? 6 : sy);
+        }
+
+        if constexpr (R == Rotation::Portrait) {
+            // One output row is one device column; output column dx lands on
+            // device row DEV_H - 1 - (startX + dx)
+            fit_.lines = outH;
+            fit_.line0 = startY;
+            fit_.yd0 = DEV_H - startX - outW;
+            fit_.bits = outW;
+            for (int dy = 0; dy < outH; ++dy) {
+                uint64_t word = 0;
+                for (int dx = 0; dx < outW; ++dx) {
+                    if ((colBits[dx] >> srcRow[dy]) & 1u) word |= uint64_t{1} << (outW - 1 - dx);
+                }
+                fit_.words[dy] = word;
+            }
+        } else {
+            fit_.lines = outW;
+            fit_.line0 = startX;
+            fit_.yd0 = startY;
+            fit_.bits = outH;
+            for (int dx = 0; dx < outW; ++dx) {
+                uint64_t word = 0;
+                for (int dy = 0; dy < outH; ++dy) {
+                    if ((colBits[dx] >> srcRow[dy]) & 1u) word |= uint64_t{1} << dy;
+                }
+                fit_.words[dx] = word;
+            }
+        }
+    }
+
+    for (int i = 0; i < fit_.lines; ++i) column(fit_.line0 + i, fit_.yd0, fit_.words[i], fit_.bits, false);
+}
+
+using PortraitCanvas = Canvas<Ssd1306_128x32, Rotation::Portrait>;
+using LandscapeCanvas = Canvas<Ssd1306_128x32, Rotation::Landscape>;
@@ -0,0 +1,215 @@
+#include "cgroup_units.h"
+#include "metrics.h"
+#include "psi.h"
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CgroupSampler::CgroupSampler(std::string sliceRoot) : root_(std::move(sliceRoot)) {}
+
+CgroupSampler::~CgroupSampler() {
+    if (inotifyFd_ >= 0) close(inotifyFd_);
+}
+
+void CgroupSampler::configure(const char* units, const std::string& sliceRoot) {
+    if (!sliceRoot.empty()) root_ = sliceRoot;
+    all_ = false;
+    wantedCount_ = 0;
+    if (!units) return;
+    for (const char* p = units; *p && wantedCount_ < kMaxUnits;) {
+        while (*p == ',' || *p == ' ') ++p;
+        size_t len = std::strcspn(p, ", ");
+        if (len == 1 && *p == '*') {
+            all_ = true;
+        } else if (len > 0) {
+            char* w = wanted_[wantedCount_];
+            const size_t keep = len < sizeof(wanted_[0]) - 9 ? len : sizeof(wanted_[0]) - 9;
+            std::memcpy(w, p, keep);
+            w[keep] = '\0';
+            if (!std::memchr(w, '.', keep)) std::strcat(w, ".service");
+            ++wantedCount_;
+        }
+        p += len;
+    }
+}
+
+bool CgroupSampler::wanted(const char* name) const {
+    if (all_) {
+        size_t n = std::strlen(name);
+        return n > 8 && std::strcmp(name + n - 8, ".service") == 0;
+    }
+    for (int i = 0; i < wantedCount_; ++i) {
+        if (std::strcmp(wanted_[i], name) == 0) return true;
+    }
+    return false;
+}
+
+void CgroupSampler::attach(const char* name) {
+    if (!wanted(name) || std::strlen(name) >= sizeof(units_[0].name)) return;
+    Unit* slot = nullptr;
+    for (Unit& u : units_) {
+        if (u.present && std::strcmp(u.name, name) == 0) return;
+        if (!u.present && !slot) slot = &u;
+    }
+    if (!slot) return;
+    std::strcpy(slot->name, name);
+    const std::string dir = root_ + "/" + name + "/";
+    slot->cpu.reset(dir + "cpu.stat");
+    slot->mem.reset(dir + "memory.current");
+    slot->io.reset(dir + "io.stat");
+    slot->pressure.reset(dir + "memory.pressure");
+    slot->present = true;
+    slot->primed = false;
+}
+
+void CgroupSampler::detach(const char* name) {
+    for (Unit& u : units_) {
+        if (!u.present || std::strcmp(u.name, name) != 0) continue;
+        u.present = false;
+        u.cpu.reset(std::string());
+        u.mem.reset(std::string());
+        u.io.reset(std::string());
+        u.pressure.reset(std::string());
+    }
+}
+
+// Watch the slice for unit directories coming and going; false while it
+// doesn't exist (or inotify is unavailable)
+bool CgroupSampler::watch() {
+    if (inotifyFd_ < 0) inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) return false;
+    return inotify_add_watch(inotifyFd_, root_.c_str(),
+                             IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR) >= 0;
+}
+
+void CgroupSampler::rescan() {
+    ++rescans_;
+    bool seen[kMaxUnits] = {};
+    if (DIR* d = opendir(root_.c_str())) {
+        while (const dirent* e = readdir(d)) {
+            if (e->d_name[0] == '.' || !wanted(e->d_name)) continue;
+            if (e->d_type != DT_DIR) {
+                struct stat st{};
+                if (e->d_type != DT_UNKNOWN || fstatat(dirfd(d), e->d_name, &st, 0) != 0 || !S_ISDIR(st.st_mode)) continue;
+            }
+            attach(e->d_name);
+            for (int i = 0; i < kMaxUnits; ++i) {
+                if (units_[i].present && std::strcmp(units_[i].name, e->d_name) == 0) seen[i] = true;
+            }
+        }
+        closedir(d);
+    }
+    for (int i = 0; i < kMaxUnits; ++i) {
+        if (units_[i].present && !seen[i]) detach(units_[i].name);
+    }
+}
+
+void CgroupSampler::drainEvents() {
+    alignas(inotify_event) char buf[4096];
+    bool overflow = false;
+    for (;;) {
+        ssize_t n = ::read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0) break; // EAGAIN: drained
+        for (ssize_t off = 0; off < n;) {
+            const inotify_event* ev = reinterpret_cast<const inotify_event*>(buf + off);
+            off += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+            if (ev->mask & IN_Q_OVERFLOW) overflow = true;
+            if (ev->mask & IN_IGNORED) {
+                // The slice itself went away; sample() watches it again
+                // once it's back
+                watching_ = false;
+                return;
+            }
+            if (!(ev->mask & IN_ISDIR) || ev->len == 0) continue;
+            if (ev->mask & (IN_CREATE | IN_MOVED_TO)) attach(ev->name);
+            else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) detach(ev->name);
+            else continue;
+            ++events_;
+        }
+    }
+    if (overflow) rescan();
+}
+
+bool CgroupSampler::read(Unit& u, uint64_t nowNs, UnitUsage& out) {
+    using namespace procparse;
+    char buf[2048];
+    uint64_t usage = 0;
+    // cpu.stat starts with usage_usec; without it the cgroup is gone
+    if (u.cpu.read(buf, sizeof(buf)) <= 0 || !startsWith(buf, "usage_usec") || !parseU64(buf + 10, usage)) return false;
+
+    uint64_t memBytes = 0;
+    if (u.mem.read(buf, sizeof(buf)) > 0) parseU64(buf, memBytes);
+
+    // "8:0 rbytes=.. wbytes=.. rios=.. ..." per device
+    uint64_t rbytes = 0, wbytes = 0;
+    if (u.io.read(buf, sizeof(buf)) > 0) {
+        for (const char* line = buf; line; line = nextLine(line)) {
+            const char* p = skipToken(line); // major:minor
+            while (*(p = skipSpaces(p)) && *p != '\n') {
+                uint64_t v = 0;
+                if (startsWith(p, "rbytes=") && parseU64(p + 7, v)) rbytes += v;
+                else if (startsWith(p, "wbytes=") && parseU64(p + 7, v)) wbytes += v;
+                p = skipToken(p);
+            }
+        }
+    }
+    PsiAverages psi;
+    readPsi(u.pressure, psi);
+
+    out = UnitUsage{};
+    size_t len = std::strlen(u.name);
+    if (len > 8 && std::strcmp(u.name + len - 8, ".service") == 0) len -= 8;
+    if (len >= sizeof(out.name)) len = sizeof(out.name) - 1;
+    std::memcpy(out.name, u.name, len);
+    out.name[len] = '\0';
+    out.mem_kb = memBytes / 1024;
+    out.mem_some_avg10 = psi.some_avg10;
+    if (u.primed && nowNs > u.lastNs) {
+        const double dtNs = static_cast<double>(nowNs - u.lastNs);
+        auto rate = [&](uint64_t cur, uint64_t prev) { return cur >= prev ? static_cast<double>(cur - prev) * 1e9 / dtNs : 0.0; };
+        out.cpu_percent = static_cast<float>(rate(usage, u.usageUsec) / 1e4); // us/s -> % of a core
+        out.read_bps = static_cast<uint64_t>(rate(rbytes, u.readBytes));
+        out.write_bps = static_cast<uint64_t>(rate(wbytes, u.writeBytes));
+    }
+    u.usageUsec = usage;
+    u.readBytes = rbytes;
+    u.writeBytes = wbytes;
+    u.lastNs = nowNs;
+    u.primed = true;
+    return true;
+}
+
+bool CgroupSampler::sample() {
+    if (!enabled()) return false;
+    if (watching_) drainEvents();
+    if (!watching_) {
+        // Watch first, then list, so a unit created in between is seen by
+        // one or the other (or both; attach() ignores repeats)
+        watching_ = watch();
+        rescan();
+    }
+
+    const uint64_t now = monotonicNs();
+    present_ = 0;
+    topCount_ = 0;
+    for (Unit& u : units_) {
+        UnitUsage usage;
+        if (!u.present || !read(u, now, usage)) continue;
+        ++present_;
+        // Busiest first, larger memory breaking ties
+        auto above = [](const UnitUsage& a, const UnitUsage& b) {
+            return a.cpu_percent > b.cpu_percent || (a.cpu_percent == b.cpu_percent && a.mem_kb > b.mem_kb);
+        };
+        int i = topCount_ < kTopN ? topCount_++ : kTopN;
+        if (i == kTopN) {
+            if (!above(usage, top_[i - 1])) continue;
+            --i;
+        }
+        for (; i > 0 && above(usage, top_[i - 1]); --i) top_[i] = top_[i - 1];
+        top_[i] = usage;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "proc_reader.h"
+#include <cstdint>
+#include <string>
+
+// One systemd unit in a ranking
+struct UnitUsage {
+    char name[24] = "";         // unit name without ".service"
+    float cpu_percent = 0.f;    // of one core since the previous sample
+    uint64_t mem_kb = 0;        // memory.current
+    uint64_t read_bps = 0;      // io.stat rbytes/wbytes, all devices
+    uint64_t write_bps = 0;
+    float mem_some_avg10 = 0.f; // memory.pressure, % of time stalled
+};
+
+// Per-unit accounting from cgroup v2: cpu.stat, memory.current, io.stat and
+// memory.pressure of selected units under a slice directory
+// (/sys/fs/cgroup/system.slice), read through files kept open between
+// samples, with CPU time and I/O bytes turned into rates against the
+// previous sample. Units come and go as systemd creates and removes their
+// cgroups; an inotify watch on the slice reports that, drained at the start
+// of each sample, so the tree is listed only once (again only if the
+// kernel's event queue overflowed). The slice path is injectable, so a
+// plain directory tree can stand in for cgroupfs.
+class CgroupSampler {
+public:
+    static constexpr int kMaxUnits = 32; // tracked at once, 4 fds each
+    static constexpr int kTopN = 5;      // reported, busiest first
+
+    explicit CgroupSampler(std::string sliceRoot = "/sys/fs/cgroup/system.slice");
+    ~CgroupSampler();
+    CgroupSampler(const CgroupSampler&) = delete;
+    CgroupSampler& operator=(const CgroupSampler&) = delete;
+
+    // Comma-separated unit names ("nginx.service,redis"; a name without a
+    // dot gets ".service"), or "*" for every service in the slice. Null or
+    // empty turns the sampler off. Call before the first sample().
+    void configure(const char* units, const std::string& sliceRoot = std::string());
+    bool enabled() const { return all_ || wantedCount_ > 0; }
+
+    // Apply pending unit events, then read every present unit; false only
+    // when the sampler is off. While the slice doesn't exist there is no
+    // watch: each sample tries to set it up again and lists the slice.
+    bool sample();
+
+    int unitCount() const { return present_; }
+    int topCount() const { return topCount_; }
+    const UnitUsage& top(int i) const { return top_[i]; }
+    // Units added/removed through inotify events, and full listings
+    uint64_t events() const { return events_; }
+    uint64_t rescans() const { return rescans_; }
+
+private:
+    struct Unit {
+        char name[64] = "";  // directory name
+        bool present = false;
+        bool primed = false; // has a previous sample to diff against
+        ProcFile cpu, mem, io, pressure;
+        uint64_t usageUsec = 0, readBytes = 0, writeBytes = 0;
+        uint64_t lastNs = 0;
+    };
+
+    std::string root_;
+    bool all_ = false;
+    char wanted_[kMaxUnits][64] = {};
+    int wantedCount_ = 0;
+    Unit units_[kMaxUnits];
+    int inotifyFd_ = -1;
+    bool watching_ = false; // the slice has a live watch on inotifyFd_
+    int present_ = 0;
+    int topCount_ = 0;
+    UnitUsage top_[kTopN];
+    uint64_t events_ = 0, rescans_ = 0;
+
+    bool wanted(const char* name) const;
+    void attach(const char* name);
+    void detach(const char* name);
+    bool watch();
+    void rescan();
+    void drainEvents();
+    bool read(Unit& u, uint64_t nowNs, UnitUsage& out);
+};
@@ -0,0 +1,233 @@
+#include "cluster.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <arpa/inet.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+void put16(uint8_t* p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+void put32(uint8_t* p, uint32_t v) {
+    put16(p, static_cast<uint16_t>(v));
+    put16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+uint16_t get16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+uint32_t get32(const uint8_t* p) { return get16(p) | static_cast<uint32_t>(get16(p + 2)) << 16; }
+
+uint8_t percent(int v) { return static_cast<uint8_t>(v < 0 ? 0 : (v > 100 ? 100 : v)); }
+
+template <typename T>
+T clampRound(double v, double lo, double hi) {
+    return static_cast<T>(std::lround(v < lo ? lo : (v > hi ? hi : v)));
+}
+
+} // namespace
+
+void cluster::encode(const Stats& s, uint8_t node, uint16_t epoch, uint32_t seq, uint8_t (&out)[kDatagramSize]) {
+    std::memset(out, 0, sizeof(out));
+    out[0] = 'R';
+    out[1] = 'P';
+    out[2] = kVersion;
+    out[3] = node;
+    put32(out + 4, seq);
+    uint8_t flags = 0;
+    if (s.has(SRC_TEMP)) flags |= HAS_TEMP;
+    if (s.has(SRC_VOLTAGE)) flags |= HAS_VOLTAGE;
+    if (s.has(SRC_THROTTLE)) flags |= HAS_THROTTLE;
+    if (s.has(SRC_FREQ)) flags |= HAS_FREQ;
+    if (s.throttled) flags |= THROTTLED;
+    out[8] = flags;
+    out[9] = percent(s.cpu_percent);
+    out[10] = percent(s.mem_percent);
+    out[11] = percent(s.disk_percent);
+    put16(out + 12, static_cast<uint16_t>(clampRound<int16_t>(s.cpu_temp_c * 100.0, -32768, 32767)));
+    put16(out + 14, clampRound<uint16_t>(s.voltage_v * 10000.0, 0, 65535));
+    put32(out + 16, s.throttle_raw);
+    put16(out + 20, clampRound<uint16_t>(s.cpu_freq_ghz * 1000.0, 0, 65535));
+    put16(out + 22, epoch);
+}
+
+bool cluster::decode(const uint8_t* buf, size_t len, Node& out) {
+    if (len != kDatagramSize || buf[0] != 'R' || buf[1] != 'P' || buf[2] != kVersion) return false;
+    out.id = buf[3];
+    out.seq = get32(buf + 4);
+    out.flags = buf[8];
+    out.cpu = percent(buf[9]);
+    out.mem = percent(buf[10]);
+    out.disk = percent(buf[11]);
+    out.temp_c = static_cast<float>(static_cast<int16_t>(get16(buf + 12))) / 100.f;
+    out.voltage_v = static_cast<float>(get16(buf + 14)) / 10000.f;
+    out.throttle_raw = get32(buf + 16);
+    out.freq_mhz = get16(buf + 20);
+    out.epoch = get16(buf + 22);
+    return true;
+}
+
+bool cluster::parseAddress(const char* spec, bool allowPortOnly, sockaddr_in& out) {
+    if (!spec || !*spec) return false;
+    out = sockaddr_in{};
+    out.sin_family = AF_INET;
+    const char* colon = std::strrchr(spec, ':');
+    const char* portStr = colon ? colon + 1 : spec;
+    if (colon) {
+        char host[64];
+        size_t n = static_cast<size_t>(colon - spec);
+        if (n == 0 || n >= sizeof(host)) return false;
+        std::memcpy(host, spec, n);
+        host[n] = '\0';
+        if (inet_pton(AF_INET, host, &out.sin_addr) != 1) return false;
+    } else if (allowPortOnly) {
+        out.sin_addr.s_addr = htonl(INADDR_ANY);
+    } else {
+        return false;
+    }
+    char* end = nullptr;
+    long port = std::strtol(portStr, &end, 10);
+    if (*end || port <= 0 || port > 65535) return false;
+    out.sin_port = htons(static_cast<uint16_t>(port));
+    return true;
+}
+
+ClusterSender::~ClusterSender() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool ClusterSender::open(const sockaddr_in& to) {
+    if (fd_ >= 0) return false;
+    fd_ = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) return false;
+    int one = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+    to_ = to;
+    if (::getrandom(&epoch_, sizeof(epoch_), GRND_NONBLOCK) != static_cast<ssize_t>(sizeof(epoch_))) {
+        timespec ts{};
+        clock_gettime(CLOCK_REALTIME, &ts);
+        epoch_ = static_cast<uint16_t>(ts.tv_nsec ^ getpid());
+    }
+    seq_ = 0;
+    return true;
+}
+
+void ClusterSender::send(const Stats& s, int nodeId) {
+    if (fd_ < 0) return;
+    uint8_t buf[cluster::kDatagramSize];
+    uint8_t id = static_cast<uint8_t>(nodeId >= 0 ? nodeId : std::atoi(s.ip_last_octet));
+    cluster::encode(s, id, epoch_, seq_++, buf);
+    ssize_t n = ::sendto(fd_, buf, sizeof(buf), MSG_DONTWAIT, reinterpret_cast<const sockaddr*>(&to_), sizeof(to_));
+    if (n == static_cast<ssize_t>(sizeof(buf))) ++sent_;
+    else ++errors_;
+}
+
+ClusterReceiver::~ClusterReceiver() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool ClusterReceiver::open(const sockaddr_in& bindAddr) {
+    if (fd_ >= 0) return false;
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&bindAddr), sizeof(bindAddr)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    return true;
+}
+
+int ClusterReceiver::onReadable(uint64_t nowNs) {
+    // One spare byte per buffer, so an oversized datagram shows as too long
+    uint8_t bufs[kBatch][cluster::kDatagramSize + 1];
+    iovec iov[kBatch];
+    mmsghdr msgs[kBatch];
+    int updated = 0;
+    for (;;) {
+        for (int i = 0; i < kBatch; ++i) {
+            iov[i] = {bufs[i], sizeof(bufs[i])};
+            msgs[i] = mmsghdr{};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = ::recvmmsg(fd_, msgs, kBatch, MSG_DONTWAIT, nullptr);
+        if (n <= 0) break; // EAGAIN: drained
+        ++batches_;
+        for (int i = 0; i < n; ++i) {
+            cluster::Node node;
+            if (!(msgs[i].msg_hdr.msg_flags & MSG_TRUNC) && cluster::decode(bufs[i], msgs[i].msg_len, node) &&
+                update(node, nowNs)) {
+                ++received_;
+                ++updated;
+            } else {
+                ++rejected_;
+            }
+        }
+        if (n < kBatch) break;
+    }
+    return updated;
+}
+
+bool ClusterReceiver::update(const cluster::Node& n, uint64_t nowNs) {
+    const uint64_t forgetNs = kForgetMs * 1000000ull;
+    // Drop forgotten nodes, keeping the table compact
+    for (int i = 0; i < count_;) {
+        if (nowNs - nodes_[i].seen_ns > forgetNs) nodes_[i] = nodes_[--count_];
+        else ++i;
+    }
+    cluster::Node* slot = nullptr;
+    for (int i = 0; i < count_ && !slot; ++i) {
+        if (nodes_[i].id == n.id) slot = &nodes_[i];
+    }
+    if (slot) {
+        // Within one epoch a late duplicate is no newer than what the table
+        // holds; another epoch is the sender restarting at any sequence
+        if (n.epoch == slot->epoch && static_cast<int32_t>(n.seq - slot->seq) <= 0) return false;
+    } else {
+        if (count_ == kMaxNodes) return false;
+        slot = &nodes_[count_++];
+    }
+    *slot = n;
+    slot->seen_ns = nowNs;
+    return true;
+}
+
+ClusterSummary ClusterReceiver::summary(uint64_t nowNs) const {
+    ClusterSummary sum;
+    const uint64_t freshNs = kFreshMs * 1000000ull;
+    bool taken[kMaxNodes] = {};
+    for (int i = 0; i < count_; ++i) {
+        const cluster::Node& n = nodes_[i];
+        if (nowNs - n.seen_ns > freshNs) {
+            taken[i] = true;
+            continue;
+        }
+        ++sum.nodes;
+        if (n.flags & cluster::THROTTLED) ++sum.throttled;
+        if ((n.flags & cluster::HAS_TEMP) && (!sum.haveTemp || n.temp_c > sum.worstTemp)) {
+            sum.haveTemp = true;
+            sum.worstTemp = n.temp_c;
+            sum.worstNode = n.id;
+        }
+    }
+    // Bars in node id order: pick the smallest remaining id each time
+    while (sum.bars < ClusterSummary::kMaxBars) {
+        int best = -1;
+        for (int i = 0; i < count_; ++i) {
+            if (!taken[i] && (best < 0 || nodes_[i].id < nodes_[best].id)) best = i;
+        }
+        if (best < 0) break;
+        taken[best] = true;
+        sum.barId[sum.bars] = nodes_[best].id;
+        sum.barCpu[sum.bars] = nodes_[best].cpu;
+        ++sum.bars;
+    }
+    return sum;
+}
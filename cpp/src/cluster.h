@@ -0,0 +1,136 @@
+#pragma once
+#include "stats.h"
+#include <cstddef>
+#include <cstdint>
+#include <netinet/in.h>
+
+// Cluster mode: every node sends a fixed 24-byte datagram with its latest
+// sample to one address (a head node, or the subnet broadcast), and nodes
+// with a display aggregate what they receive into a per-node table.
+//
+// Datagram, little-endian:
+//   0  'R' 'P'            magic
+//   2  u8  version (1)
+//   3  u8  node id        ip_last_octet unless overridden
+//   4  u32 sequence
+//   8  u8  flags          cluster::Flags
+//   9  u8  cpu %   10 u8 mem %   11 u8 disk %
+//   12 i16 temperature, 0.01 'C
+//   14 u16 core voltage, 0.1 mV
+//   16 u32 raw GET_THROTTLED bits
+//   20 u16 CPU frequency, MHz
+//   22 u16 sender epoch   random per sender start; a new epoch restarts
+//                         the node's sequence
+namespace cluster {
+
+constexpr size_t kDatagramSize = 24;
+constexpr uint8_t kVersion = 1;
+
+enum Flags : uint8_t {
+    HAS_TEMP = 1u << 0,
+    HAS_VOLTAGE = 1u << 1,
+    HAS_THROTTLE = 1u << 2,
+    HAS_FREQ = 1u << 3,
+    THROTTLED = 1u << 4,
+};
+
+// One node as last reported
+struct Node {
+    uint8_t id = 0;
+    uint8_t flags = 0;
+    uint8_t cpu = 0, mem = 0, disk = 0;
+    float temp_c = 0.f;
+    float voltage_v = 0.f;
+    uint32_t throttle_raw = 0;
+    uint16_t freq_mhz = 0;
+    uint32_t seq = 0;
+    uint16_t epoch = 0;
+    uint64_t seen_ns = 0; // CLOCK_MONOTONIC of the last datagram
+};
+
+void encode(const Stats& s, uint8_t node, uint16_t epoch, uint32_t seq, uint8_t (&out)[kDatagramSize]);
+// False for anything but a well-formed datagram of this version
+bool decode(const uint8_t* buf, size_t len, Node& out);
+
+// "host:port" (IPv4 address) or, with allowPortOnly, just "port" on any
+// address
+bool parseAddress(const char* spec, bool allowPortOnly, sockaddr_in& out);
+
+} // namespace cluster
+
+// What the cluster page shows: nodes heard from in the last kFreshMs, the
+// hottest one, how many report throttling, and each one's CPU in node id
+// order (the first kMaxBars).
+struct ClusterSummary {
+    static constexpr int kMaxBars = 16;
+    int nodes = 0;
+    int throttled = 0;
+    bool haveTemp = false;
+    float worstTemp = 0.f;
+    uint8_t worstNode = 0;
+    int bars = 0;
+    uint8_t barId[kMaxBars] = {};
+    uint8_t barCpu[kMaxBars] = {};
+};
+
+// Sends this node's samples; non-blocking, a failed send is just counted
+class ClusterSender {
+public:
+    ClusterSender() = default;
+    ~ClusterSender();
+    ClusterSender(const ClusterSender&) = delete;
+    ClusterSender& operator=(const ClusterSender&) = delete;
+
+    // SO_BROADCAST is set, so a subnet broadcast address works as well.
+    // Picks a fresh random epoch, so receivers take the sequence restarting
+    // at 0 as a restart rather than as late duplicates.
+    bool open(const sockaddr_in& to);
+    bool isOpen() const { return fd_ >= 0; }
+    // nodeId < 0: the sample's ip_last_octet
+    void send(const Stats& s, int nodeId);
+    uint64_t sent() const { return sent_; }
+    uint64_t errors() const { return errors_; }
+    uint16_t epoch() const { return epoch_; }
+
+private:
+    int fd_ = -1;
+    sockaddr_in to_{};
+    uint16_t epoch_ = 0;
+    uint32_t seq_ = 0;
+    uint64_t sent_ = 0, errors_ = 0;
+};
+
+// Non-blocking UDP socket for the main EventLoop: each readiness drains
+// the queue with recvmmsg() in batches of kBatch into fixed buffers, and
+// updates a fixed node table (no allocation per datagram).
+class ClusterReceiver {
+public:
+    static constexpr int kMaxNodes = 32;
+    static constexpr int kBatch = 16;
+    static constexpr uint64_t kFreshMs = 10000; // shown while heard from this recently
+    static constexpr uint64_t kForgetMs = 60000; // dropped from the table after this
+
+    ClusterReceiver() = default;
+    ~ClusterReceiver();
+    ClusterReceiver(const ClusterReceiver&) = delete;
+    ClusterReceiver& operator=(const ClusterReceiver&) = delete;
+
+    bool open(const sockaddr_in& bindAddr);
+    int fd() const { return fd_; }
+    // Drain the socket; returns how many datagrams updated the table
+    int onReadable(uint64_t nowNs);
+
+    ClusterSummary summary(uint64_t nowNs) const;
+
+    uint64_t received() const { return received_; }
+    uint64_t rejected() const { return rejected_; } // malformed or out of order
+    uint64_t batches() const { return batches_; }
+
+private:
+    int fd_ = -1;
+    cluster::Node nodes_[kMaxNodes];
+    int count_ = 0;
+    uint64_t received_ = 0, rejected_ = 0, batches_ = 0;
+
+    bool update(const cluster::Node& n, uint64_t nowNs);
+};
@@ -0,0 +1,182 @@
+#include "collector.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// Fast-moving values refresh often; statvfs, the IP and the mailbox reads
+// barely change and are the ones that can stall.
+static constexpr uint32_t kDefaultPeriodMs[METRIC_COUNT] = {
+    500,   // cpu
+    1000,  // mem
+    30000, // disk
+    1000,  // freq
+    1000,  // temp
+    30000, // ip
+    5000,  // volt
+    2000,  // thr
+    1000,  // dio
+    1000,  // net
+    2000,  // psi (the kernel updates the averages every 2 s)
+    5000,  // procs (opens every /proc/[pid]/stat)
+    2000,  // units (four open cgroup files per unit)
+};
+
+static int64_t unixMs() {
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint32_t StatsSnapshot::ageMs(Metric m, uint64_t nowNs) const {
+    uint64_t t = sampled_ns[m];
+    if (t == 0) return UINT32_MAX;
+    if (nowNs <= t) return 0;
+    uint64_t ms = (nowNs - t) / 1000000;
+    return ms > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(ms);
+}
+
+BackgroundCollector::BackgroundCollector() {
+    std::memcpy(periodMs_, kDefaultPeriodMs, sizeof(periodMs_));
+}
+
+BackgroundCollector::~BackgroundCollector() { stop(); }
+
+void BackgroundCollector::configurePeriods(const char* spec) {
+    if (!spec) return;
+    const char* p = spec;
+    while (*p) {
+        const char* eq = std::strchr(p, '=');
+        if (!eq) break;
+        size_t keyLen = static_cast<size_t>(eq - p);
+        long ms = std::strtol(eq + 1, nullptr, 10);
+        for (int m = 0; m < METRIC_COUNT; ++m) {
+            const char* name = metricName(static_cast<Metric>(m));
+            if (std::strlen(name) == keyLen && std::strncmp(name, p, keyLen) == 0 &&
+                ms >= 50 && ms <= 3600 * 1000) {
+                periodMs_[m] = static_cast<uint32_t>(ms);
+            }
+        }
+        const char* comma = std::strchr(eq, ',');
+        if (!comma) break;
+        p = comma + 1;
+    }
+}
+
+void BackgroundCollector::start() {
+    if (thread_.joinable()) return;
+    uint64_t now = nowNs();
+    for (int m = 0; m < METRIC_COUNT; ++m) {
+        collector_.sample(static_cast<Metric>(m), working_.stats);
+        working_.sampled_ns[m] = now;
+    }
+    working_.published_ns = now;
+    working_.unix_ms = unixMs();
+    published_.store(working_);
+    if (recorder_) recorder_->append(working_.unix_ms, working_.stats);
+    stopping_ = false;
+    thread_ = std::thread(&BackgroundCollector::run, this);
+}
+
+void BackgroundCollector::startReplay(TraceReader& trace, bool paced) {
+    if (thread_.joinable()) return;
+    replay_ = &trace;
+    replayDone_.store(false, std::memory_order_release);
+    if (!paced) return;
+    stopping_ = false;
+    thread_ = std::thread(&BackgroundCollector::runReplay, this);
+}
+
+// A recorded sample stands in for every metric group at once
+void BackgroundCollector::publishRecorded(const Stats& s, int64_t unixMs) {
+    uint64_t now = nowNs();
+    working_.stats = s;
+    for (int m = 0; m < METRIC_COUNT; ++m) working_.sampled_ns[m] = now;
+    working_.published_ns = now;
+    working_.unix_ms = unixMs;
+    published_.store(working_);
+}
+
+bool BackgroundCollector::replayStep() {
+    Stats s;
+    int64_t ms = 0;
+    if (!replay_ || !replay_->next(s, ms)) {
+        replayDone_.store(true, std::memory_order_release);
+        return false;
+    }
+    publishRecorded(s, ms);
+    return true;
+}
+
+void BackgroundCollector::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void BackgroundCollector::run() {
+    uint64_t due[METRIC_COUNT];
+    uint64_t now = nowNs();
+    for (int m = 0; m < METRIC_COUNT; ++m) due[m] = now + periodMs_[m] * 1000000ull;
+
+    std::unique_lock<std::mutex> lk(mu_);
+    while (!stopping_) {
+        uint64_t next = UINT64_MAX;
+        for (int m = 0; m < METRIC_COUNT; ++m) next = std::min(next, due[m]);
+        now = nowNs();
+        if (next > now) {
+            cv_.wait_for(lk, std::chrono::nanoseconds(next - now));
+            continue; // re-check stop and the clock
+        }
+        lk.unlock();
+        bool changed = false;
+        StageTimer pass;
+        for (int m = 0; m < METRIC_COUNT; ++m) {
+            if (due[m] > now) continue;
+            StageTimer one;
+            collector_.sample(static_cast<Metric>(m), working_.stats);
+            uint64_t t = nowNs();
+            sampleLatency_[m].record((t - one.startNs()) / 1000);
+            working_.sampled_ns[m] = t;
+            // Schedule from the previous deadline so periods don't drift,
+            // but skip missed slots after a long stall
+            due[m] += periodMs_[m] * 1000000ull;
+            if (due[m] <= t) due[m] = t + periodMs_[m] * 1000000ull;
+            changed = true;
+        }
+        if (changed) {
+            passLatency_.record(pass.elapsedUs());
+            working_.published_ns = nowNs();
+            working_.unix_ms = unixMs();
+            published_.store(working_);
+            if (recorder_) recorder_->append(working_.unix_ms, working_.stats);
+        }
+        lk.lock();
+    }
+}
+
+void BackgroundCollector::runReplay() {
+    const uint64_t t0 = nowNs();
+    int64_t firstMs = 0;
+    bool first = true;
+    Stats s;
+    int64_t ms = 0;
+    std::unique_lock<std::mutex> lk(mu_);
+    while (!stopping_ && replay_->next(s, ms)) {
+        if (first) firstMs = ms;
+        first = false;
+        uint64_t due = t0 + static_cast<uint64_t>(ms - firstMs) * 1000000ull;
+        for (uint64_t now = nowNs(); !stopping_ && now < due; now = nowNs()) {
+            cv_.wait_for(lk, std::chrono::nanoseconds(due - now));
+        }
+        if (stopping_) break;
+        lk.unlock();
+        publishRecorded(s, ms);
+        lk.lock();
+    }
+    replayDone_.store(true, std::memory_order_release);
+}
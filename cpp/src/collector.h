@@ -0,0 +1,91 @@
+#pragma once
+#include "metrics.h"
+#include "seqlock.h"
+#include "stats.h"
+#include "trace.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// What the render loop sees: the latest Stats plus when each metric group
+// was last refreshed (CLOCK_MONOTONIC ns, 0 = never).
+struct StatsSnapshot {
+    Stats stats;
+    uint64_t sampled_ns[METRIC_COUNT] = {};
+    uint64_t published_ns = 0;
+    int64_t unix_ms = 0; // wall clock at publication; the recorded time on replay
+
+    // Age of a metric group at `nowNs`, in ms (UINT32_MAX if never sampled)
+    uint32_t ageMs(Metric m, uint64_t nowNs) const;
+};
+
+// Samples every metric group on its own period from a background thread and
+// publishes snapshots through a seqlock, so the renderer never blocks on a
+// slow statvfs() or mailbox call.
+class BackgroundCollector {
+public:
+    BackgroundCollector();
+    ~BackgroundCollector();
+    BackgroundCollector(const BackgroundCollector&) = delete;
+    BackgroundCollector& operator=(const BackgroundCollector&) = delete;
+
+    // Parse "cpu=250,disk=60000" style overrides (ms); unknown keys are ignored
+    void configurePeriods(const char* spec);
+    uint32_t periodMs(Metric m) const { return periodMs_[m]; }
+    // Per-scan cost budget of the process ranking (us, 0 = none); call
+    // before start()
+    void setProcScanBudgetUs(uint32_t us) { collector_.setProcScanBudgetUs(us); }
+    // systemd units to account from cgroup v2 (StatsCollector::setUnits);
+    // call before start()
+    void setUnits(const char* units, const std::string& sliceRoot = std::string()) {
+        collector_.setUnits(units, sliceRoot);
+    }
+
+    // Append every published snapshot to `trace` from the collector thread;
+    // call before start()
+    void record(TraceWriter* trace) { recorder_ = trace; }
+
+    // Takes one full sample on the calling thread, then starts the worker
+    void start();
+    void stop();
+
+    // Publish the samples of `trace` instead of sampling. Paced, a worker
+    // publishes each at its recorded offset from now; otherwise nothing runs
+    // in the background and each replayStep() publishes the next sample on
+    // the calling thread. replayDone() turns true after the last one.
+    void startReplay(TraceReader& trace, bool paced);
+    bool replayStep();
+    bool replayDone() const { return replayDone_.load(std::memory_order_acquire); }
+
+    StatsSnapshot latest() const { return published_.load(); }
+    uint32_t version() const { return published_.version(); }
+
+    static uint64_t nowNs() { return monotonicNs(); }
+
+    // Time spent per collection pass and per metric group (collector thread)
+    LatencyHistogram& passLatency() { return passLatency_; }
+    LatencyHistogram& sampleLatency(Metric m) { return sampleLatency_[m]; }
+
+private:
+    StatsCollector collector_;
+    uint32_t periodMs_[METRIC_COUNT];
+    StatsSnapshot working_;
+    Seqlock<StatsSnapshot> published_;
+    LatencyHistogram passLatency_;
+    LatencyHistogram sampleLatency_[METRIC_COUNT];
+
+    std::thread thread_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+
+    TraceWriter* recorder_ = nullptr;
+    TraceReader* replay_ = nullptr;
+    std::atomic<bool> replayDone_{false};
+
+    void run();
+    void runReplay();
+    void publishRecorded(const Stats& s, int64_t unixMs);
+};
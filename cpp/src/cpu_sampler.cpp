@@ -0,0 +1,69 @@
+#include "cpu_sampler.h"
+
+CpuSampler::CpuSampler(std::string statPath) : file_(std::move(statPath)) {}
+
+static int pct(uint64_t part, uint64_t total) {
+    if (total == 0) return 0;
+    int v = static_cast<int>(100.0 * static_cast<double>(part) / static_cast<double>(total) + 0.5);
+    if (v < 0) v = 0;
+    if (v > 100) v = 100;
+    return v;
+}
+
+// Counters only grow, except across a CPU hotplug where they restart
+static uint64_t delta(uint64_t cur, uint64_t prev) { return cur >= prev ? cur - prev : cur; }
+
+bool CpuSampler::sample() {
+    using namespace procparse;
+    // The cpu lines lead /proc/stat; the long intr line after them may be
+    // cut off by the buffer, which is fine
+    char buf[4096];
+    if (file_.read(buf, sizeof(buf)) <= 0) return false;
+    int cores = 0;
+    bool sawTotal = false;
+    for (const char* line = buf; line && startsWith(line, "cpu"); line = nextLine(line)) {
+        const char* p = line + 3;
+        int slot;
+        if (*p == ' ') {
+            slot = 0;
+            sawTotal = true;
+        } else {
+            uint64_t n = 0;
+            p = parseU64(p, n);
+            if (!p || n >= static_cast<uint64_t>(kMaxCores)) continue;
+            slot = static_cast<int>(n) + 1;
+            if (slot > cores) cores = slot;
+        }
+        // user nice system idle iowait irq softirq steal; older kernels stop early
+        uint64_t v[8] = {};
+        int got = 0;
+        for (; got < 8; ++got) {
+            const char* q = parseU64(p, v[got]);
+            if (!q) break;
+            p = q;
+        }
+        if (got < 4 || *p == '\0') continue; // no newline: truncated line
+        Times t;
+        t.user = v[0]; t.nice = v[1]; t.system = v[2]; t.idle = v[3];
+        t.iowait = v[4]; t.irq = v[5]; t.softirq = v[6]; t.steal = v[7];
+
+        const Times& prev = prev_[slot];
+        uint64_t idle = delta(t.idle, prev.idle) + delta(t.iowait, prev.iowait);
+        uint64_t irq = delta(t.irq, prev.irq) + delta(t.softirq, prev.softirq);
+        uint64_t steal = delta(t.steal, prev.steal);
+        uint64_t busy = delta(t.user, prev.user) + delta(t.nice, prev.nice) +
+                        delta(t.system, prev.system) + irq + steal;
+        uint64_t total = idle + busy;
+        // Counters tick at USER_HZ; a zero delta means "no news", keep the last value
+        if (total > 0) {
+            CpuUsage& u = usage_[slot];
+            u.percent = pct(busy, total);
+            u.iowait = pct(delta(t.iowait, prev.iowait), total);
+            u.steal = pct(steal, total);
+            u.irq = pct(irq, total);
+        }
+        prev_[slot] = t;
+    }
+    cores_ = cores;
+    return sawTotal;
+}
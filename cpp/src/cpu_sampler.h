@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "proc_reader.h"
+
+// Utilisation of one /proc/stat "cpu" line over the last sampling interval
+struct CpuUsage {
+    int percent = 0; // busy (everything but idle+iowait), 0..100
+    int iowait = 0;
+    int steal = 0;
+    int irq = 0;     // irq + softirq
+};
+
+// Stateful /proc/stat reader: keeps the previous counters and reports the
+// utilisation over the real interval between two sample() calls, for the
+// aggregate line and every cpuN line. The first sample reports the average
+// since boot. Never sleeps.
+class CpuSampler {
+public:
+    static constexpr int kMaxCores = 8;
+
+    explicit CpuSampler(std::string statPath = "/proc/stat");
+
+    bool sample();
+
+    const CpuUsage& total() const { return usage_[0]; }
+    const CpuUsage& core(int i) const { return usage_[i + 1]; }
+    int coreCount() const { return cores_; }
+
+    struct Times {
+        uint64_t user = 0, nice = 0, system = 0, idle = 0;
+        uint64_t iowait = 0, irq = 0, softirq = 0, steal = 0;
+    };
+
+private:
+    ProcFile file_;
+    int cores_ = 0;
+    Times prev_[kMaxCores + 1];
+    CpuUsage usage_[kMaxCores + 1];
+};
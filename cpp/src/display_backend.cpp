@@ -0,0 +1,71 @@
+#include "display_backend.h"
+#include <cstdio>
+#include <cstring>
+
+int NullI2CBus::rdwr(i2c_msg* msgs, size_t count) {
+    for (size_t i = 0; i < count; ++i) bytes_ += msgs[i].len;
+    return 0;
+}
+
+int NullI2CBus::write(const uint8_t*, size_t len) {
+    bytes_ += len;
+    return 0;
+}
+
+PbmDumpBus::PbmDumpBus(std::string path, int width, int height, int columnOffset)
+    : MockI2CBus(0, true, columnOffset), path_(std::move(path)), width_(width), height_(height) {
+    single_ = path_.size() > 4 && path_.compare(path_.size() - 4, 4, ".pbm") == 0;
+}
+
+void PbmDumpBus::endFrame() {
+    std::string img = encodePbm(gddram(), width_, height_);
+    if (single_) {
+        writeFileAtomic(path_, img);
+        return;
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "/frame_%06llu.pbm", static_cast<unsigned long long>(frame_++));
+    writeFileAtomic(path_ + name, img);
+}
+
+std::string encodePbm(const uint8_t* pages, int width, int height) {
+    char header[32];
+    int n = std::snprintf(header, sizeof(header), "P4\n%d %d\n", width, height);
+    std::string out(header, static_cast<size_t>(n));
+    int rowBytes = (width + 7) / 8;
+    for (int y = 0; y < height; ++y) {
+        for (int xb = 0; xb < rowBytes; ++xb) {
+            uint8_t byte = 0;
+            for (int bit = 0; bit < 8; ++bit) {
+                int x = xb * 8 + bit;
+                // PBM: 1 = black; render lit pixels black on white
+                if (x < width && (pages[(y / 8) * width + x] >> (y % 8)) & 1u)
+                    byte = static_cast<uint8_t>(byte | (0x80u >> bit));
+            }
+            out.push_back(static_cast<char>(byte));
+        }
+    }
+    return out;
+}
+
+bool writeFileAtomic(const std::string& path, const std::string& data) {
+    std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<I2CBus> makeDisplayBus(const char* spec, uint8_t addr, int width, int height,
+                                       int columnOffset) {
+    if (!spec || !*spec) spec = "i2c:/dev/i2c-1";
+    if (std::strcmp(spec, "null") == 0) return std::make_unique<NullI2CBus>();
+    if (std::strncmp(spec, "pbm:", 4) == 0) return std::make_unique<PbmDumpBus>(spec + 4, width, height, columnOffset);
+    if (std::strncmp(spec, "i2c:", 4) == 0) spec += 4;
+    return std::make_unique<LinuxI2CBus>(spec, addr);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "i2c_transport.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Accepts every transfer and drops it; for running the daemon (or timing
+// the render path) with no panel attached.
+class NullI2CBus : public I2CBus {
+public:
+    bool isOpen() const override { return true; }
+    int rdwr(i2c_msg* msgs, size_t count) override;
+    int write(const uint8_t* data, size_t len) override;
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    uint64_t bytes_ = 0;
+};
+
+// Emulated panel that dumps its GDDRAM as a PBM after every frame. A path
+// ending in ".pbm" is overwritten in place (atomically); otherwise it is a
+// directory receiving frame_000000.pbm, frame_000001.pbm, ...
+class PbmDumpBus : public MockI2CBus {
+public:
+    PbmDumpBus(std::string path, int width, int height, int columnOffset = 0);
+    void endFrame() override;
+
+private:
+    std::string path_;
+    int width_, height_;
+    bool single_;
+    uint64_t frame_ = 0;
+};
+
+// P4 (binary PBM) image of a page-major SSD1306 buffer, as shown on the panel
+std::string encodePbm(const uint8_t* pages, int width, int height);
+bool writeFileAtomic(const std::string& path, const std::string& data);
+
+// Bus for a RPI_STATS_DISPLAY style spec:
+//   "i2c:/dev/i2c-1" (default when spec is null/empty), "pbm:<path>", "null"
+// columnOffset is the controller's RAM column of the first visible one
+// (2 on SH1106), for the emulated panel.
+std::unique_ptr<I2CBus> makeDisplayBus(const char* spec, uint8_t addr, int width, int height,
+                                       int columnOffset = 0);
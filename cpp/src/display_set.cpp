@@ -0,0 +1,371 @@
+#include "display_set.h"
+#include "display_backend.h"
+#include <cstdlib>
+#include <cstring>
+
+std::string DisplayConfig::busKey() const {
+    const char* s = spec.c_str();
+    if (std::strncmp(s, "i2c:", 4) == 0) return s + 4;
+    if (std::strncmp(s, "pbm:", 4) == 0 || spec == "null") {
+        // Emulated panels don't share anything; each gets its own "bus"
+        char suffix[8];
+        std::snprintf(suffix, sizeof(suffix), "@%02X", addr);
+        return spec + suffix;
+    }
+    return spec;
+}
+
+static bool endsWith(const std::string& s, const char* tail) {
+    size_t n = std::strlen(tail);
+    return s.size() >= n && s.compare(s.size() - n, n, tail) == 0;
+}
+
+std::vector<DisplayConfig> parseDisplayList(const char* list) {
+    std::vector<DisplayConfig> out;
+    if (!list || !*list) {
+        out.emplace_back();
+        return out;
+    }
+    const char* p = list;
+    while (*p) {
+        const char* end = std::strchr(p, ',');
+        std::string entry(p, end ? static_cast<size_t>(end - p) : std::strlen(p));
+        p = end ? end + 1 : p + entry.size();
+
+        DisplayConfig cfg;
+        // Trailing ":token" options, in any order
+        for (bool more = true; more;) {
+            more = false;
+            const struct { const char* tail; void (*apply)(DisplayConfig&); } opts[] = {
+                {":portrait", [](DisplayConfig& c) { c.layout = LayoutKind::Portrait; }},
+                {":landscape", [](DisplayConfig& c) { c.layout = LayoutKind::Landscape; }},
+                {":128x32", [](DisplayConfig& c) { c.panel = PanelKind::Ssd1306_128x32; }},
+                {":128x64", [](DisplayConfig& c) { c.panel = PanelKind::Ssd1306_128x64; }},
+                {":sh1106", [](DisplayConfig& c) { c.panel = PanelKind::Sh1106_128x64; }},
+            };
+            for (const auto& o : opts) {
+                if (!endsWith(entry, o.tail)) continue;
+                o.apply(cfg);
+                entry.resize(entry.size() - std::strlen(o.tail));
+                more = true;
+            }
+        }
+        size_t at = entry.rfind('@');
+        if (at != std::string::npos) {
+            char* stop = nullptr;
+            unsigned long addr = std::strtoul(entry.c_str() + at + 1, &stop, 0);
+            if (*stop || addr < 0x03 || addr > 0x77) continue;
+            cfg.addr = static_cast<uint8_t>(addr);
+            entry.resize(at);
+        }
+        if (entry.empty()) continue;
+        cfg.spec = entry;
+        out.push_back(cfg);
+    }
+    return out;
+}
+
+template <typename P>
+class PanelUnit final : public DisplayUnit {
+public:
+    PanelUnit(const DisplayConfig& cfg, size_t maxTransfer, const LayoutFile* layouts)
+        : DisplayUnit(cfg),
+          oled_(makeDisplayBus(cfg.spec.c_str(), cfg.addr, P::WIDTH, P::HEIGHT, P::COLUMN_OFFSET), cfg.addr,
+                maxTransfer),
+          portrait_(oled_), landscape_(oled_) {
+        using Land = Canvas<P, Rotation::Landscape>;
+        using Port = Canvas<P, Rotation::Portrait>;
+        const WidgetTree* tree = nullptr;
+        if (layouts && cfg.layout == LayoutKind::Landscape) tree = layouts->find(Land::W, Land::H);
+        else if (layouts) tree = layouts->find(Port::W, Port::H);
+        if (tree) tree_ = std::make_unique<WidgetTree>(*tree);
+    }
+
+    bool init() override { return oled_.init(); }
+    void display() override {
+        if (applied_.scroll) showTicker();
+        else oled_.display();
+        drawn_ = false;
+    }
+    void applyFx(const PanelFxState& fx) override {
+        if (fx.contrast != applied_.contrast) oled_.setContrast(fx.contrast);
+        if (fx.inverted != applied_.inverted) oled_.setInverted(fx.inverted);
+        applied_ = fx;
+        if (fx.scroll) showTicker();
+        else if (banded_ || oled_.scrolling()) stopTicker();
+    }
+    const I2CTransport::Counters& transportCounters() const override { return oled_.transportCounters(); }
+
+protected:
+    void draw(const ScreenView& v) override {
+        // Widgets redraw only what changed, so they must find the frame
+        // they drew, not the ticker
+        if (banded_) unband();
+        bool land = config().layout == LayoutKind::Landscape;
+        if (tree_ && land) tree_->render(landscape_, v);
+        else if (tree_) tree_->render(portrait_, v);
+        else if (land) renderLandscape(landscape_, v);
+        else renderPortrait(portrait_, v);
+        drawn_ = true;
+    }
+
+private:
+    static constexpr int kTickerFrames = 64; // panel frames per column
+    static constexpr int kBand = P::PAGES - 1; // the ticker's page
+
+    OledDisplay<P> oled_;
+    PanelFxState applied_;
+    Canvas<P, Rotation::Portrait> portrait_;
+    Canvas<P, Rotation::Landscape> landscape_;
+    bool banded_ = false; // the framebuffer's last page holds the ticker
+    bool drawn_ = false;  // a frame was drawn since one last went out
+    uint8_t band_[P::WIDTH] = {}; // what the ticker covers
+
+    uint8_t* bandBytes() { return oled_.buffer() + kBand * P::WIDTH; }
+
+    // The frame goes out with the ticker text over its last page, in one
+    // transfer, then the controller scrolls just that page. A new frame
+    // stops the scroll; the band is only resent when its text changed,
+    // otherwise the scroll carries on from where it stopped.
+    void showTicker() {
+        if constexpr (P::CONTROLLER == Controller::SH1106) {
+            oled_.display(); // no scroll engine
+        } else {
+            if (oled_.scrolling() && !drawn_) return; // nothing new since it started
+            if (!banded_) {
+                char line[48];
+                formatTicker(shown(), line, sizeof(line));
+                std::memcpy(band_, bandBytes(), sizeof(band_));
+                if (config().layout == LayoutKind::Landscape) drawTickerBand(landscape_, line);
+                else drawTickerBand(portrait_, line);
+                oled_.markDirty(0, P::WIDTH - 1, kBand);
+                banded_ = true;
+            }
+            oled_.display();
+            oled_.startScroll(ScrollDir::Left, kBand, kBand, kTickerFrames);
+            drawn_ = false;
+        }
+    }
+    void unband() {
+        std::memcpy(bandBytes(), band_, sizeof(band_));
+        oled_.markDirty(0, P::WIDTH - 1, kBand);
+        banded_ = false;
+    }
+    void stopTicker() {
+        // stopScroll() has display() resend the band the scroll rotated,
+        // now with the frame's own content
+        if (banded_) unband();
+        oled_.stopScroll();
+        oled_.display();
+        drawn_ = false;
+    }
+    std::unique_ptr<WidgetTree> tree_;
+};
+
+std::unique_ptr<DisplayUnit> DisplayUnit::create(const DisplayConfig& cfg, size_t maxTransfer,
+                                                 const LayoutFile* layouts) {
+    switch (cfg.panel) {
+        case PanelKind::Ssd1306_128x64: return std::make_unique<PanelUnit<Ssd1306_128x64>>(cfg, maxTransfer, layouts);
+        case PanelKind::Sh1106_128x64: return std::make_unique<PanelUnit<Sh1106_128x64>>(cfg, maxTransfer, layouts);
+        case PanelKind::Ssd1306_128x32: break;
+    }
+    return std::make_unique<PanelUnit<Ssd1306_128x32>>(cfg, maxTransfer, layouts);
+}
+
+bool DisplayUnit::render(const ScreenView& v) {
+    if (haveShown_ && v == shown_) return false;
+    draw(v);
+    shown_ = v;
+    haveShown_ = true;
+    return true;
+}
+
+// --- BusFlusher -------------------------------------------------------------
+
+BusFlusher::BusFlusher(std::string key, LatencyHistogram& flushLatency)
+    : key_(std::move(key)), flushLatency_(flushLatency) {}
+
+BusFlusher::~BusFlusher() { stop(); }
+
+int BusFlusher::add(DisplayUnit* unit) {
+    if (units_.size() >= kMaxUnits) return -1;
+    units_.push_back(unit);
+    counters_.push_back(unit->transportCounters());
+    fx_.emplace_back();
+    return static_cast<int>(units_.size()) - 1;
+}
+
+void BusFlusher::start() {
+    if (thread_.joinable()) return;
+    stopping_ = false;
+    thread_ = std::thread(&BusFlusher::run, this);
+}
+
+void BusFlusher::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+bool BusFlusher::idle(int idx) const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return !((pending_ | pendingFx_ | inFlight_) & (1u << idx));
+}
+
+void BusFlusher::submit(int idx, const PanelFxState* fx) {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        pending_ |= 1u << idx;
+        if (fx) {
+            fx_[static_cast<size_t>(idx)] = *fx;
+            pendingFx_ |= 1u << idx;
+        }
+    }
+    cv_.notify_one();
+}
+
+void BusFlusher::submitFx(int idx, const PanelFxState& fx) {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        fx_[static_cast<size_t>(idx)] = fx;
+        pendingFx_ |= 1u << idx;
+    }
+    cv_.notify_one();
+}
+
+I2CTransport::Counters BusFlusher::counters(int idx) const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return counters_[static_cast<size_t>(idx)];
+}
+
+void BusFlusher::run() {
+    const int n = static_cast<int>(units_.size());
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        cv_.wait(lk, [&] { return stopping_ || (pending_ | pendingFx_) != 0; });
+        // Once stopping, frames are dropped but controller states still go
+        // out, so a panel isn't left inverted, dimmed or scrolling
+        if (stopping_ && !pendingFx_) return;
+        const uint32_t queued = stopping_ ? pendingFx_ : pending_ | pendingFx_;
+        // First queued unit at or after the cursor
+        int idx = next_;
+        while (!(queued & (1u << idx))) idx = (idx + 1) % n;
+        const uint32_t bit = 1u << idx;
+        const bool frame = !stopping_ && (pending_ & bit);
+        const bool fx = pendingFx_ & bit;
+        const PanelFxState fxState = fx_[static_cast<size_t>(idx)];
+        pending_ &= ~bit;
+        pendingFx_ &= ~bit;
+        inFlight_ |= bit;
+        next_ = (idx + 1) % n;
+        lk.unlock();
+
+        // The controller state first, so a frame queued with it (say, the
+        // one that ends the idle ticker) goes out under the new state
+        DisplayUnit* unit = units_[static_cast<size_t>(idx)];
+        if (fx) unit->applyFx(fxState);
+        if (frame) {
+            StageTimer flush;
+            unit->display();
+            flushLatency_.record(flush.elapsedUs());
+        }
+
+        lk.lock();
+        counters_[static_cast<size_t>(idx)] = unit->transportCounters();
+        inFlight_ &= ~bit;
+    }
+}
+
+// --- DisplaySet -------------------------------------------------------------
+
+bool DisplaySet::open(const char* list, size_t maxTransfer, LatencyHistogram& flushLatency,
+                      const LayoutFile* layouts) {
+    for (const DisplayConfig& cfg : parseDisplayList(list)) {
+        std::unique_ptr<DisplayUnit> unit = DisplayUnit::create(cfg, maxTransfer, layouts);
+        if (!unit->init()) {
+            fprintf(stderr, "display %s@0x%02X: init failed, skipping\n", cfg.spec.c_str(), cfg.addr);
+            continue;
+        }
+        std::string key = cfg.busKey();
+        BusFlusher* bus = nullptr;
+        for (auto& f : flushers_) {
+            if (f->key() == key) bus = f.get();
+        }
+        if (!bus) {
+            flushers_.push_back(std::make_unique<BusFlusher>(key, flushLatency));
+            bus = flushers_.back().get();
+        }
+        int idx = bus->add(unit.get());
+        if (idx < 0) continue;
+        slots_.push_back({unit.get(), bus, idx, PanelFxState{}});
+        units_.push_back(std::move(unit));
+    }
+    return !units_.empty();
+}
+
+void DisplaySet::start() {
+    for (auto& f : flushers_) f->start();
+}
+
+void DisplaySet::stop() {
+    for (auto& f : flushers_) f->stop();
+}
+
+DisplaySet::Update DisplaySet::update(const ScreenView& v, const PanelFxState& fx, LatencyHistogram& renderLatency) {
+    Update u;
+    for (Slot& s : slots_) {
+        if (!s.bus->idle(s.idx)) {
+            ++u.deferred;
+            continue;
+        }
+        StageTimer render;
+        if (!s.unit->render(v)) continue;
+        renderLatency.record(render.elapsedUs());
+        if (fx == s.fx) {
+            s.bus->submit(s.idx);
+        } else {
+            s.bus->submit(s.idx, &fx);
+            s.fx = fx;
+        }
+        ++u.changed;
+    }
+    return u;
+}
+
+void DisplaySet::setFx(const PanelFxState& fx) {
+    for (Slot& s : slots_) {
+        if (fx == s.fx) continue;
+        s.bus->submitFx(s.idx, fx);
+        s.fx = fx;
+    }
+}
+
+I2CTransport::Counters DisplaySet::totals() const {
+    I2CTransport::Counters t;
+    for (const Slot& s : slots_) {
+        I2CTransport::Counters c = s.bus->counters(s.idx);
+        t.flushes += c.flushes;
+        t.syscalls += c.syscalls;
+        t.bytes += c.bytes;
+        t.errors += c.errors;
+        t.retries += c.retries;
+        t.fallbacks += c.fallbacks;
+        if (c.maxFlushUs > t.maxFlushUs) t.maxFlushUs = c.maxFlushUs;
+    }
+    return t;
+}
+
+void DisplaySet::dump(FILE* out) const {
+    for (const Slot& s : slots_) {
+        I2CTransport::Counters tc = s.bus->counters(s.idx);
+        fprintf(out, "i2c display=%s@0x%02X bus=%s flushes=%llu syscalls=%llu bytes=%llu errors=%llu retries=%llu fallbacks=%llu max_flush_us=%u\n",
+                s.unit->config().spec.c_str(), s.unit->config().addr, s.bus->key().c_str(),
+                static_cast<unsigned long long>(tc.flushes), static_cast<unsigned long long>(tc.syscalls),
+                static_cast<unsigned long long>(tc.bytes), static_cast<unsigned long long>(tc.errors),
+                static_cast<unsigned long long>(tc.retries), static_cast<unsigned long long>(tc.fallbacks),
+                tc.maxFlushUs);
+    }
+}
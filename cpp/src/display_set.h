@@ -0,0 +1,155 @@
+#pragma once
+#include "canvas.h"
+#include "layout.h"
+#include "metrics.h"
+#include "panel.h"
+#include "panel_fx.h"
+#include "ssd1306.h"
+#include "widgets.h"
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One entry of RPI_STATS_DISPLAY
+struct DisplayConfig {
+    std::string spec = "i2c:/dev/i2c-1"; // backend, as for makeDisplayBus()
+    uint8_t addr = 0x3C;
+    LayoutKind layout = LayoutKind::Portrait;
+    PanelKind panel = PanelKind::Ssd1306_128x32;
+
+    // Displays with the same key share a bus and are flushed one at a time
+    std::string busKey() const;
+};
+
+// Comma-separated "spec[@addr][:layout][:panel]" entries, where layout is
+// portrait|landscape and panel is 128x32|128x64|sh1106, e.g.
+// "i2c:/dev/i2c-1@0x3C,i2c:/dev/i2c-1@0x3D:landscape:128x64,i2c:/dev/i2c-3:sh1106".
+// Null/empty gives the single default panel; malformed entries are skipped.
+std::vector<DisplayConfig> parseDisplayList(const char* list);
+
+// A panel, its canvases, and the view currently in its framebuffer. The
+// panel type is a template parameter of the implementation (see
+// display_set.cpp), so drawing is resolved at compile time per panel and
+// only render()/display() dispatch at runtime. A unit draws with its own
+// copy of the layout file's tree for its canvas size when there is one,
+// else with the built-in screen.
+class DisplayUnit {
+public:
+    static std::unique_ptr<DisplayUnit> create(const DisplayConfig& cfg, size_t maxTransfer,
+                                               const LayoutFile* layouts = nullptr);
+    virtual ~DisplayUnit() = default;
+
+    virtual bool init() = 0;
+    // Render `v` unless the framebuffer already holds it; true if it did
+    bool render(const ScreenView& v);
+    // Push the framebuffer to the panel (bus thread)
+    virtual void display() = 0;
+    // Bring the controller to `fx`, sending only what changed (bus thread)
+    virtual void applyFx(const PanelFxState& fx) = 0;
+    virtual const I2CTransport::Counters& transportCounters() const = 0;
+
+    const DisplayConfig& config() const { return cfg_; }
+
+protected:
+    explicit DisplayUnit(const DisplayConfig& cfg) : cfg_(cfg) {}
+    virtual void draw(const ScreenView& v) = 0;
+    // What the framebuffer holds, for effects drawn from it (the ticker)
+    const ScreenView& shown() const { return shown_; }
+
+private:
+    DisplayConfig cfg_;
+    ScreenView shown_;
+    bool haveShown_ = false;
+};
+
+// Flushes the displays on one bus from its own thread. Queued displays are
+// served round-robin, one at a time, so a panel that's always dirty can't
+// starve its neighbour; different buses flush in parallel.
+class BusFlusher {
+public:
+    static constexpr int kMaxUnits = 32;
+
+    BusFlusher(std::string key, LatencyHistogram& flushLatency);
+    ~BusFlusher();
+    BusFlusher(const BusFlusher&) = delete;
+    BusFlusher& operator=(const BusFlusher&) = delete;
+
+    const std::string& key() const { return key_; }
+    // Before start(); returns the unit's index on this bus
+    int add(DisplayUnit* unit);
+    void start();
+    void stop();
+
+    // Neither queued nor being flushed, so its framebuffer may be written
+    bool idle(int idx) const;
+    // Queue a frame; with `fx`, that controller state is queued with it
+    // under the same lock, so the frame never goes out without it
+    void submit(int idx, const PanelFxState* fx = nullptr);
+    // Queue a controller state; it goes out before any queued frame, and
+    // still goes out once stop() has been called
+    void submitFx(int idx, const PanelFxState& fx);
+    // Transport counters as of the unit's last completed flush
+    I2CTransport::Counters counters(int idx) const;
+
+private:
+    std::string key_;
+    LatencyHistogram& flushLatency_;
+    std::vector<DisplayUnit*> units_;
+    std::vector<I2CTransport::Counters> counters_;
+    std::vector<PanelFxState> fx_;
+
+    std::thread thread_;
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    uint32_t pending_ = 0;  // bit per unit
+    uint32_t pendingFx_ = 0;
+    uint32_t inFlight_ = 0;
+    int next_ = 0;          // round-robin cursor
+    bool stopping_ = false;
+
+    void run();
+};
+
+// Every configured display, grouped by bus
+class DisplaySet {
+public:
+    struct Update {
+        int changed = 0;  // rendered and queued
+        int deferred = 0; // still flushing the previous frame; retry later
+    };
+
+    ~DisplaySet() { stop(); }
+
+    // Creates and initialises the panels; false if none came up
+    bool open(const char* list, size_t maxTransfer, LatencyHistogram& flushLatency,
+              const LayoutFile* layouts = nullptr);
+    void start();
+    void stop();
+
+    // A panel that renders `v` queues `fx` along with the frame, so the
+    // frame is drawn under the state it was rendered for
+    Update update(const ScreenView& v, const PanelFxState& fx, LatencyHistogram& renderLatency);
+    // Controller effect state for every panel; only changes are queued
+    void setFx(const PanelFxState& fx);
+
+    size_t size() const { return units_.size(); }
+    size_t buses() const { return flushers_.size(); }
+    I2CTransport::Counters totals() const;
+    // One counters line per display
+    void dump(FILE* out) const;
+
+private:
+    struct Slot {
+        DisplayUnit* unit;
+        BusFlusher* bus;
+        int idx;
+        PanelFxState fx; // last queued
+    };
+    std::vector<std::unique_ptr<DisplayUnit>> units_;
+    std::vector<std::unique_ptr<BusFlusher>> flushers_;
+    std::vector<Slot> slots_;
+};
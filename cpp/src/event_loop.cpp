@@ -0,0 +1,136 @@
+#include "event_loop.h"
+#include "metrics.h"
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+
+EventLoop::EventLoop() {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    entries_.reserve(16);
+}
+
+EventLoop::~EventLoop() {
+    if (epfd_ >= 0) ::close(epfd_);
+}
+
+EventLoop::Entry* EventLoop::find(int fd) {
+    for (auto& e : entries_) {
+        if (e->fd == fd && !e->removed) return e.get();
+    }
+    return nullptr;
+}
+
+bool EventLoop::add(int fd, uint32_t events, Handler handler) {
+    if (epfd_ < 0 || fd < 0 || find(fd)) return false;
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+    entries_.push_back(std::unique_ptr<Entry>(new Entry{fd, false, std::move(handler)}));
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::remove(int fd) {
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    Entry* e = find(fd);
+    if (!e) return;
+    // The handler may be the one running; keep it alive until the batch ends
+    e->removed = true;
+    pendingErase_ = true;
+    if (!dispatching_) eraseRemoved();
+}
+
+void EventLoop::eraseRemoved() {
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [](const std::unique_ptr<Entry>& e) { return e->removed; }),
+                   entries_.end());
+    pendingErase_ = false;
+}
+
+int EventLoop::runOnce(int timeoutMs) {
+    epoll_event evs[16];
+    int n = epoll_wait(epfd_, evs, 16, timeoutMs);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+    dispatching_ = true;
+    for (int i = 0; i < n; ++i) {
+        // Look up per event: a handler may have removed another fd
+        if (Entry* e = find(evs[i].data.fd)) e->handler(evs[i].events);
+    }
+    dispatching_ = false;
+    if (pendingErase_) eraseRemoved();
+    return n;
+}
+
+// --- FrameTimer -------------------------------------------------------------
+
+FrameTimer::FrameTimer() {
+    fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+FrameTimer::~FrameTimer() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool FrameTimer::arm(uint64_t atNs) {
+    itimerspec its{};
+    its.it_value.tv_sec = static_cast<time_t>(atNs / 1000000000ull);
+    its.it_value.tv_nsec = static_cast<long>(atNs % 1000000000ull);
+    next_ = atNs;
+    return timerfd_settime(fd_, TFD_TIMER_ABSTIME, &its, nullptr) == 0;
+}
+
+bool FrameTimer::start(uint32_t periodMs) {
+    if (fd_ < 0) return false;
+    return arm(monotonicNs() + periodMs * 1000000ull);
+}
+
+bool FrameTimer::fireNow() {
+    if (fd_ < 0) return false;
+    return arm(monotonicNs());
+}
+
+uint64_t FrameTimer::advance(uint32_t nextPeriodMs) {
+    uint64_t expirations = 0;
+    (void)!::read(fd_, &expirations, sizeof(expirations));
+    uint64_t period = nextPeriodMs * 1000000ull;
+    uint64_t target = next_ + period;
+    uint64_t now = monotonicNs();
+    uint64_t missed = 0;
+    if (target <= now) {
+        // Fell behind by whole periods: skip them instead of bursting
+        missed = (now - target) / period + 1;
+        target += missed * period;
+    }
+    arm(target);
+    return missed;
+}
+
+// --- SignalFd ---------------------------------------------------------------
+
+SignalFd::SignalFd(std::initializer_list<int> signals) {
+    sigset_t set;
+    sigemptyset(&set);
+    for (int s : signals) sigaddset(&set, s);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    fd_ = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+}
+
+SignalFd::~SignalFd() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+int SignalFd::read() {
+    signalfd_siginfo si{};
+    if (::read(fd_, &si, sizeof(si)) != static_cast<ssize_t>(sizeof(si))) return 0;
+    return static_cast<int>(si.ssi_signo);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+#include <signal.h>
+
+// Minimal epoll reactor: one handler per fd, dispatched from run_once().
+// Handlers are registered at startup; dispatch itself doesn't allocate.
+// Handlers run in place and may add() or remove() entries, their own
+// included: entries don't move, and removal during dispatch is deferred
+// until the batch is done.
+class EventLoop {
+public:
+    using Handler = std::function<void(uint32_t events)>;
+
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool add(int fd, uint32_t events, Handler handler);
+    bool modify(int fd, uint32_t events);
+    void remove(int fd);
+
+    // Wait up to timeoutMs (-1 = forever) and dispatch ready handlers.
+    // Returns the number of events handled, or -1 on error.
+    int runOnce(int timeoutMs);
+
+private:
+    struct Entry {
+        int fd;
+        bool removed;
+        Handler handler;
+    };
+    int epfd_ = -1;
+    std::vector<std::unique_ptr<Entry>> entries_;
+    bool dispatching_ = false;
+    bool pendingErase_ = false;
+    Entry* find(int fd);
+    void eraseRemoved();
+};
+
+// One-shot CLOCK_MONOTONIC timerfd armed at absolute deadlines. Each
+// deadline is the previous one plus the period, so the schedule doesn't
+// drift by however long the work took.
+class FrameTimer {
+public:
+    FrameTimer();
+    ~FrameTimer();
+    FrameTimer(const FrameTimer&) = delete;
+    FrameTimer& operator=(const FrameTimer&) = delete;
+
+    int fd() const { return fd_; }
+    // First deadline one period from now
+    bool start(uint32_t periodMs);
+    // Drain the expiry and arm the next deadline with `nextPeriodMs`.
+    // Returns how many deadlines were missed entirely (skipped).
+    uint64_t advance(uint32_t nextPeriodMs);
+    // Expire immediately; the following advance() counts from now
+    bool fireNow();
+    // Deadline currently armed (CLOCK_MONOTONIC ns); inside the fd's handler,
+    // before advance(), that's the one that just fired
+    uint64_t deadlineNs() const { return next_; }
+
+private:
+    int fd_ = -1;
+    uint64_t next_ = 0;
+    bool arm(uint64_t atNs);
+};
+
+// signalfd for the listed signals; they are blocked for the calling thread
+// and every thread created after it, so call this before spawning threads.
+class SignalFd {
+public:
+    explicit SignalFd(std::initializer_list<int> signals);
+    ~SignalFd();
+    SignalFd(const SignalFd&) = delete;
+    SignalFd& operator=(const SignalFd&) = delete;
+
+    int fd() const { return fd_; }
+    // Next pending signal number, or 0 when none is queued
+    int read();
+
+private:
+    int fd_ = -1;
+};
@@ -0,0 +1,317 @@
+#include "exporter.h"
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char kNotFound[] =
+    "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\nConnection: close\r\n\r\nnot found\n";
+
+// GET_THROTTLED bits: 0..3 are current state, 16..19 "has occurred since boot"
+static const struct { int bit; const char* name; } kThrottleBits[] = {
+    {0, "under_voltage"}, {1, "arm_freq_capped"}, {2, "throttled"}, {3, "soft_temp_limit"},
+    {16, "under_voltage_occurred"}, {17, "arm_freq_capped_occurred"},
+    {18, "throttled_occurred"}, {19, "soft_temp_limit_occurred"},
+};
+
+namespace {
+// snprintf appender over a fixed buffer; remembers overflow
+struct Out {
+    char* p;
+    size_t cap, len = 0;
+    bool overflow = false;
+
+    void add(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (overflow) return;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = std::vsnprintf(p + len, cap - len, fmt, ap);
+        va_end(ap);
+        if (n < 0 || static_cast<size_t>(n) >= cap - len) overflow = true;
+        else len += static_cast<size_t>(n);
+    }
+    void family(const char* name, const char* type, const char* help) {
+        add("# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+    }
+};
+}
+
+size_t MetricsExporter::renderBody(const StatsSnapshot& snap, uint64_t nowNs, char* out, size_t cap) {
+    const Stats& s = snap.stats;
+    Out o{out, cap};
+
+    o.family("rpi_cpu_usage_ratio", "gauge", "CPU busy time over the last sample period.");
+    o.add("rpi_cpu_usage_ratio{cpu=\"all\"} %.2f\n", s.cpu_percent / 100.0);
+    for (int i = 0; i < s.cpu_core_count; ++i) o.add("rpi_cpu_usage_ratio{cpu=\"%d\"} %.2f\n", i, s.cpu_core_percent[i] / 100.0);
+    o.family("rpi_cpu_mode_ratio", "gauge", "Share of CPU time in selected modes.");
+    o.add("rpi_cpu_mode_ratio{mode=\"iowait\"} %.2f\n", s.cpu_iowait_percent / 100.0);
+    o.add("rpi_cpu_mode_ratio{mode=\"steal\"} %.2f\n", s.cpu_steal_percent / 100.0);
+    o.add("rpi_cpu_mode_ratio{mode=\"irq\"} %.2f\n", s.cpu_irq_percent / 100.0);
+
+    o.family("rpi_memory_bytes", "gauge", "Selected /proc/meminfo fields.");
+    const struct { const char* field; uint64_t kb; } mem[] = {
+        {"total", s.mem_total_kb}, {"available", s.mem_available_kb}, {"cached", s.mem_cached_kb},
+        {"buffers", s.mem_buffers_kb}, {"dirty", s.mem_dirty_kb}, {"swap_used", s.swap_used_kb},
+    };
+    for (const auto& m : mem) {
+        o.add("rpi_memory_bytes{field=\"%s\"} %llu\n", m.field, static_cast<unsigned long long>(m.kb) * 1024ull);
+    }
+    o.family("rpi_memory_used_ratio", "gauge", "(MemTotal - MemAvailable) / MemTotal.");
+    o.add("rpi_memory_used_ratio %.2f\n", s.mem_percent / 100.0);
+    o.family("rpi_disk_used_ratio", "gauge", "Used share of the root filesystem.");
+    o.add("rpi_disk_used_ratio{mountpoint=\"/\"} %.2f\n", s.disk_percent / 100.0);
+
+    o.family("rpi_disk_io_bytes_per_second", "gauge", "Whole-disk throughput from /proc/diskstats.");
+    for (int i = 0; i < s.disk_io_count; ++i) {
+        const DiskRate& d = s.disk_io[i];
+        o.add("rpi_disk_io_bytes_per_second{device=\"%s\",direction=\"read\"} %llu\n", d.name,
+              static_cast<unsigned long long>(d.read_bps));
+        o.add("rpi_disk_io_bytes_per_second{device=\"%s\",direction=\"write\"} %llu\n", d.name,
+              static_cast<unsigned long long>(d.write_bps));
+    }
+    o.family("rpi_disk_iops", "gauge", "Completed disk requests per second.");
+    for (int i = 0; i < s.disk_io_count; ++i) {
+        const DiskRate& d = s.disk_io[i];
+        o.add("rpi_disk_iops{device=\"%s\",direction=\"read\"} %u\n", d.name, d.read_iops);
+        o.add("rpi_disk_iops{device=\"%s\",direction=\"write\"} %u\n", d.name, d.write_iops);
+    }
+    o.family("rpi_net_bytes_per_second", "gauge", "Interface throughput from /proc/net/dev.");
+    for (int i = 0; i < s.net_count; ++i) {
+        const NetRate& n = s.net[i];
+        o.add("rpi_net_bytes_per_second{interface=\"%s\",direction=\"rx\"} %llu\n", n.name,
+              static_cast<unsigned long long>(n.rx_bps));
+        o.add("rpi_net_bytes_per_second{interface=\"%s\",direction=\"tx\"} %llu\n", n.name,
+              static_cast<unsigned long long>(n.tx_bps));
+    }
+    o.family("rpi_net_drops_per_second", "gauge", "Dropped packets per second, rounded up.");
+    for (int i = 0; i < s.net_count; ++i) {
+        const NetRate& n = s.net[i];
+        o.add("rpi_net_drops_per_second{interface=\"%s\",direction=\"rx\"} %u\n", n.name, n.rx_drops);
+        o.add("rpi_net_drops_per_second{interface=\"%s\",direction=\"tx\"} %u\n", n.name, n.tx_drops);
+    }
+
+    // Sources that may be missing are omitted rather than reported as 0
+    if (s.has(SRC_FREQ)) {
+        o.family("rpi_cpu_frequency_hertz", "gauge", "Current frequency of cpu0.");
+        o.add("rpi_cpu_frequency_hertz %.0f\n", s.cpu_freq_ghz * 1e9);
+    }
+    if (s.has(SRC_TEMP)) {
+        o.family("rpi_soc_temperature_celsius", "gauge", "SoC temperature.");
+        o.add("rpi_soc_temperature_celsius %.3f\n", s.cpu_temp_c);
+    }
+    if (s.has(SRC_VOLTAGE)) {
+        o.family("rpi_core_voltage_volts", "gauge", "VideoCore core voltage.");
+        o.add("rpi_core_voltage_volts %.4f\n", s.voltage_v);
+    }
+    if (s.has(SRC_THROTTLE)) {
+        o.family("rpi_throttled_flags", "gauge", "Raw GET_THROTTLED firmware flags.");
+        o.add("rpi_throttled_flags %u\n", s.throttle_raw);
+        o.family("rpi_throttled", "gauge", "GET_THROTTLED flags decoded one per series.");
+        for (const auto& b : kThrottleBits) {
+            o.add("rpi_throttled{flag=\"%s\"} %u\n", b.name, (s.throttle_raw >> b.bit) & 1u);
+        }
+    }
+
+    if (s.has(SRC_PSI)) {
+        o.family("rpi_pressure_stall_ratio", "gauge", "PSI share of time tasks were stalled.");
+        for (int r = 0; r < PSI_COUNT; ++r) {
+            const PsiAverages& a = s.psi[r];
+            const char* res = psiResourceName(static_cast<PsiResource>(r));
+            o.add("rpi_pressure_stall_ratio{resource=\"%s\",kind=\"some\",window=\"10s\"} %.4f\n", res, a.some_avg10 / 100.0);
+            o.add("rpi_pressure_stall_ratio{resource=\"%s\",kind=\"some\",window=\"60s\"} %.4f\n", res, a.some_avg60 / 100.0);
+            o.add("rpi_pressure_stall_ratio{resource=\"%s\",kind=\"full\",window=\"10s\"} %.4f\n", res, a.full_avg10 / 100.0);
+            o.add("rpi_pressure_stall_ratio{resource=\"%s\",kind=\"full\",window=\"60s\"} %.4f\n", res, a.full_avg60 / 100.0);
+        }
+    }
+
+    o.family("rpi_source_up", "gauge", "Whether an optional source answered on its last sample.");
+    const struct { StatSource src; const char* name; } sources[] = {
+        {SRC_IP, "ip"}, {SRC_FREQ, "freq"}, {SRC_TEMP, "temp"}, {SRC_VOLTAGE, "volt"},
+        {SRC_THROTTLE, "thr"}, {SRC_PSI, "psi"},
+    };
+    for (const auto& src : sources) o.add("rpi_source_up{source=\"%s\"} %d\n", src.name, s.has(src.src) ? 1 : 0);
+
+    o.family("rpi_sample_age_seconds", "gauge", "Age of each metric group at scrape-cache time.");
+    for (int i = 0; i < METRIC_COUNT; ++i) {
+        Metric m = static_cast<Metric>(i);
+        if (!snap.sampled_ns[m]) continue;
+        o.add("rpi_sample_age_seconds{group=\"%s\"} %.3f\n", metricName(m), snap.ageMs(m, nowNs) / 1000.0);
+    }
+    o.add("# EOF\n");
+    return o.overflow ? 0 : o.len;
+}
+
+MetricsExporter::MetricsExporter(BackgroundCollector& collector, EventLoop& loop)
+    : collector_(collector), loop_(loop) {}
+
+MetricsExporter::~MetricsExporter() {
+    for (Client& c : clients_) closeClient(c);
+    for (int fd : {unixFd_, tcpFd_}) {
+        if (fd < 0) continue;
+        loop_.remove(fd);
+        ::close(fd);
+    }
+    if (!unixPath_.empty()) ::unlink(unixPath_.c_str());
+}
+
+bool MetricsExporter::addListener(int fd) {
+    if (::listen(fd, kMaxClients) != 0 ||
+        !loop_.add(fd, EPOLLIN, [this, fd](uint32_t) { onAccept(fd); })) {
+        ::close(fd);
+        return false;
+    }
+    return true;
+}
+
+bool MetricsExporter::listenUnix(const std::string& path) {
+    sockaddr_un sa{};
+    if (unixFd_ >= 0 || path.empty() || path.size() >= sizeof(sa.sun_path)) return false;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    sa.sun_family = AF_UNIX;
+    std::memcpy(sa.sun_path, path.c_str(), path.size());
+    ::unlink(path.c_str()); // stale socket from a previous run
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (!addListener(fd)) return false;
+    unixFd_ = fd;
+    unixPath_ = path;
+    return true;
+}
+
+bool MetricsExporter::listenTcp(uint16_t port) {
+    if (tcpFd_ >= 0) return false;
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in sa{};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (!addListener(fd)) return false;
+    tcpFd_ = fd;
+    return true;
+}
+
+void MetricsExporter::onAccept(int listenFd) {
+    for (;;) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return; // EAGAIN: drained
+        int slot = -1;
+        for (int i = 0; i < kMaxClients; ++i) {
+            if (clients_[i].fd < 0) { slot = i; break; }
+        }
+        if (slot < 0 || !loop_.add(fd, EPOLLIN, [this, slot](uint32_t ev) { onClient(slot, ev); })) {
+            ::close(fd); // full: the scraper retries
+            continue;
+        }
+        Client& c = clients_[slot];
+        c.fd = fd;
+        c.got = c.sent = 0;
+        c.resp = nullptr;
+    }
+}
+
+void MetricsExporter::closeClient(Client& c) {
+    if (c.fd < 0) return;
+    loop_.remove(c.fd);
+    ::close(c.fd);
+    c.fd = -1;
+    c.resp = nullptr;
+}
+
+bool MetricsExporter::sending() const {
+    for (const Client& c : clients_) {
+        if (c.fd >= 0 && c.resp == response_) return true;
+    }
+    return false;
+}
+
+void MetricsExporter::refresh() {
+    uint32_t version = collector_.version();
+    if (responseValid_ && version == responseVersion_) return;
+    // A client still draining the old response keeps it; it's one
+    // publication stale at most
+    if (responseValid_ && sending()) return;
+
+    char body[kMaxResponse];
+    const StatsSnapshot snap = collector_.latest();
+    size_t bodyLen = renderBody(snap, BackgroundCollector::nowNs(), body, sizeof(body) - 256);
+    if (bodyLen == 0) return;
+    int h = std::snprintf(response_, sizeof(response_),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                          "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                          bodyLen);
+    std::memcpy(response_ + h, body, bodyLen);
+    responseLen_ = static_cast<size_t>(h) + bodyLen;
+    responseVersion_ = version;
+    responseValid_ = true;
+    ++renders_;
+}
+
+void MetricsExporter::onClient(int slot, uint32_t events) {
+    Client& c = clients_[slot];
+    if (c.fd < 0) return;
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        closeClient(c);
+        return;
+    }
+    if (c.resp) {
+        respond(c); // EPOLLOUT after a short write
+        return;
+    }
+    ssize_t n = ::read(c.fd, c.req + c.got, sizeof(c.req) - 1 - c.got);
+    if (n <= 0) {
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        closeClient(c);
+        return;
+    }
+    c.got += static_cast<size_t>(n);
+    c.req[c.got] = '\0';
+    // Only the request line matters; wait for the end of the headers unless
+    // the buffer is full
+    if (!std::strstr(c.req, "\r\n\r\n") && !std::strstr(c.req, "\n\n") && c.got < sizeof(c.req) - 1) return;
+
+    bool metrics = std::strncmp(c.req, "GET /metrics ", 13) == 0 || std::strncmp(c.req, "GET / ", 6) == 0;
+    if (metrics) {
+        refresh();
+        ++scrapes_;
+    }
+    if (metrics && responseValid_) {
+        c.resp = response_;
+        c.respLen = responseLen_;
+    } else {
+        c.resp = kNotFound;
+        c.respLen = sizeof(kNotFound) - 1;
+    }
+    respond(c);
+}
+
+void MetricsExporter::respond(Client& c) {
+    ssize_t n = ::send(c.fd, c.resp + c.sent, c.respLen - c.sent, MSG_NOSIGNAL);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) n = 0;
+    if (n < 0) {
+        closeClient(c);
+        return;
+    }
+    c.sent += static_cast<size_t>(n);
+    if (c.sent >= c.respLen) {
+        closeClient(c);
+        return;
+    }
+    loop_.modify(c.fd, EPOLLOUT);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "collector.h"
+#include "event_loop.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Serves the collector's latest snapshot in OpenMetrics text format over
+// HTTP, on a Unix socket and/or a loopback TCP port. Single-threaded and
+// non-blocking: runs on the main EventLoop. The response (headers + body)
+// is rendered into a fixed buffer only when the collector publishes a new
+// snapshot, so a scrape is one read() and one write(), with no sampling.
+class MetricsExporter {
+public:
+    static constexpr size_t kMaxResponse = 16384;
+    static constexpr int kMaxClients = 8;
+
+    MetricsExporter(BackgroundCollector& collector, EventLoop& loop);
+    ~MetricsExporter();
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    // Unix domain socket at `path` (an existing socket file is replaced)
+    bool listenUnix(const std::string& path);
+    // 127.0.0.1:port only; this is not meant to be reachable off-host
+    bool listenTcp(uint16_t port);
+
+    uint64_t scrapes() const { return scrapes_; }
+    uint64_t renders() const { return renders_; }
+
+    // Body for `snap` into out (no HTTP headers); returns its length, or 0
+    // if it didn't fit
+    static size_t renderBody(const StatsSnapshot& snap, uint64_t nowNs, char* out, size_t cap);
+
+private:
+    struct Client {
+        int fd = -1;
+        size_t got = 0;     // request bytes read
+        size_t sent = 0;    // response bytes written
+        const char* resp = nullptr;
+        size_t respLen = 0;
+        char req[512];
+    };
+
+    BackgroundCollector& collector_;
+    EventLoop& loop_;
+    int unixFd_ = -1, tcpFd_ = -1;
+    std::string unixPath_;
+    Client clients_[kMaxClients];
+
+    char response_[kMaxResponse];
+    size_t responseLen_ = 0;
+    uint32_t responseVersion_ = 0;
+    bool responseValid_ = false;
+    uint64_t scrapes_ = 0, renders_ = 0;
+
+    bool addListener(int fd);
+    void onAccept(int listenFd);
+    void onClient(int slot, uint32_t events);
+    void respond(Client& c);
+    void closeClient(Client& c);
+    bool sending() const;
+    void refresh();
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+
+// 5x7 ASCII font (32..126), adapted from public domain sources.
+// Shared by the driver's drawText() and the canvas glyph atlases.
+inline constexpr uint8_t kFont5x7[] = {
+#include "tiny5x7.inc"
+};
+
+inline constexpr int kFontFirstChar = 32;
+inline constexpr int kFontGlyphs = static_cast<int>(sizeof(kFont5x7) / 5);
+
+// Glyph index for a character; anything outside the table draws as '?'
+constexpr int fontGlyphIndex(char ch) {
+    int c = static_cast<unsigned char>(ch);
+    if (c < kFontFirstChar || c >= kFontFirstChar + kFontGlyphs) c = '?';
+    return c - kFontFirstChar;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+
+// Gauge geometry computed at compile time. A ring gauge is the set of
+// pixels between two radii, sorted by angle, plus for every percentage the
+// length of the sorted prefix to light. Drawing is then a walk over that
+// prefix: no trig, no per-pixel radius test.
+namespace gauge {
+
+namespace detail {
+
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr double sqrtNewton(double x) {
+    if (x <= 0.0) return 0.0;
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 64; ++i) r = 0.5 * (r + x / r);
+    return r;
+}
+
+// atan for |x| <= 1: halve the argument once so the series converges fast
+constexpr double atanSmall(double x) {
+    double h = x / (1.0 + sqrtNewton(1.0 + x * x));
+    double h2 = h * h, term = h, sum = 0.0;
+    for (int n = 0; n < 40; ++n) {
+        sum += term / (2 * n + 1);
+        term *= -h2;
+    }
+    return 2.0 * sum;
+}
+
+// Degrees in [0, 360), same convention as std::atan2(dy, dx)
+constexpr double angleDeg(int dx, int dy) {
+    if (dx == 0 && dy == 0) return 0.0;
+    double x = dx, y = dy, a = 0.0;
+    if ((x < 0 ? -x : x) >= (y < 0 ? -y : y)) {
+        a = atanSmall(y / x);
+        if (x < 0) a += (y < 0) ? -kPi : kPi;
+    } else {
+        a = (y > 0 ? kPi / 2 : -kPi / 2) - atanSmall(x / y);
+    }
+    double deg = a * 180.0 / kPi;
+    if (deg < 0) deg += 360.0;
+    return deg;
+}
+
+} // namespace detail
+
+struct RingPixel {
+    int8_t dx, dy;
+};
+
+// Pixels with rInner^2 <= dx^2+dy^2 <= rOuter^2 whose angle lies within
+// [startDeg, startDeg + sweepDeg], ordered by angle from startDeg.
+template <int ROuter, int RInner, int StartDeg = 0, int SweepDeg = 360>
+struct RingLut {
+    static_assert(ROuter > 0 && ROuter < 64 && RInner >= 0 && RInner <= ROuter, "bad radii");
+    static_assert(SweepDeg > 0 && SweepDeg <= 360, "bad sweep");
+    static constexpr int kMaxPixels = (2 * ROuter + 1) * (2 * ROuter + 1);
+
+    RingPixel px[kMaxPixels] = {};
+    int count = 0;
+    uint16_t upto[101] = {}; // pixels to light for 0..100 %
+
+    constexpr RingLut() {
+        double rel[kMaxPixels] = {};
+        for (int dy = -ROuter; dy <= ROuter; ++dy) {
+            for (int dx = -ROuter; dx <= ROuter; ++dx) {
+                int r2 = dx * dx + dy * dy;
+                if (r2 > ROuter * ROuter || r2 < RInner * RInner) continue;
+                double a = detail::angleDeg(dx, dy) - StartDeg;
+                while (a < 0) a += 360.0;
+                if (a > SweepDeg) continue;
+                // Insertion sort by relative angle (stable on ties: row order)
+                int i = count++;
+                while (i > 0 && rel[i - 1] > a) {
+                    rel[i] = rel[i - 1];
+                    px[i] = px[i - 1];
+                    --i;
+                }
+                rel[i] = a;
+                px[i] = RingPixel{static_cast<int8_t>(dx), static_cast<int8_t>(dy)};
+            }
+        }
+        int n = 0;
+        for (int p = 0; p <= 100; ++p) {
+            double limit = SweepDeg * (p / 100.0) + 1e-9;
+            while (n < count && rel[n] <= limit) ++n;
+            upto[p] = static_cast<uint16_t>(n);
+        }
+    }
+};
+
+inline int clampPercent(int percent) {
+    return percent < 0 ? 0 : (percent > 100 ? 100 : percent);
+}
+
+// Donut or arc: light the first upto[percent] pixels around (cx, cy).
+// `plot(x, y)` is the caller's pixel sink (e.g. a rotated canvas).
+template <typename Lut, typename Plot>
+void drawRing(const Lut& lut, int cx, int cy, int percent, Plot&& plot) {
+    int n = lut.upto[clampPercent(percent)];
+    for (int i = 0; i < n; ++i) plot(cx + lut.px[i].dx, cy + lut.px[i].dy);
+}
+
+// Horizontal bar: 1px outline of w x h with the inside filled left to right
+template <typename Plot>
+void drawBar(int x, int y, int w, int h, int percent, Plot&& plot) {
+    if (w < 3 || h < 3) return;
+    for (int i = 0; i < w; ++i) { plot(x + i, y); plot(x + i, y + h - 1); }
+    for (int j = 1; j < h - 1; ++j) { plot(x, y + j); plot(x + w - 1, y + j); }
+    int fill = (w - 2) * clampPercent(percent) / 100;
+    for (int j = 1; j < h - 1; ++j)
+        for (int i = 0; i < fill; ++i) plot(x + 1 + i, y + j);
+}
+
+} // namespace gauge
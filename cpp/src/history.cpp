@@ -0,0 +1,149 @@
+#include "history.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint32_t kMagic = 0x48535052; // "RPSH"
+static constexpr uint32_t kLayoutVersion = 1;
+
+struct MetricHistory::Data {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t reserved;
+    struct TierState {
+        int64_t period; // period number of the slot at head
+        uint32_t head;
+        uint32_t sum;   // running sum for the head slot's average
+    } state[SERIES_COUNT][TIER_COUNT];
+    Bucket seconds[SERIES_COUNT][kCapacity[TIER_1S]];
+    Bucket minutes[SERIES_COUNT][kCapacity[TIER_1M]];
+    Bucket hours[SERIES_COUNT][kCapacity[TIER_1H]];
+
+    Bucket* ring(Series s, Tier t) {
+        return t == TIER_1S ? seconds[s] : (t == TIER_1M ? minutes[s] : hours[s]);
+    }
+    const Bucket* ring(Series s, Tier t) const { return const_cast<Data*>(this)->ring(s, t); }
+};
+
+size_t MetricHistory::fileSize() { return sizeof(Data); }
+
+MetricHistory::~MetricHistory() {
+    if (data_) ::munmap(data_, sizeof(Data));
+}
+
+bool MetricHistory::open(const std::string& path) {
+    if (data_) return false;
+    void* p = MAP_FAILED;
+    if (!path.empty()) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            struct stat st{};
+            bool sized = ::fstat(fd, &st) == 0 &&
+                         (static_cast<size_t>(st.st_size) == sizeof(Data) || ::ftruncate(fd, sizeof(Data)) == 0);
+            if (sized) p = ::mmap(nullptr, sizeof(Data), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd); // the mapping keeps the file
+        }
+    }
+    persistent_ = p != MAP_FAILED;
+    if (!persistent_) {
+        p = ::mmap(nullptr, sizeof(Data), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return false;
+    }
+    data_ = static_cast<Data*>(p);
+    if (data_->magic != kMagic || data_->version != kLayoutVersion || data_->size != sizeof(Data)) {
+        std::memset(data_, 0, sizeof(Data));
+        data_->magic = kMagic;
+        data_->version = kLayoutVersion;
+        data_->size = sizeof(Data);
+    }
+    return true;
+}
+
+uint16_t MetricHistory::encode(Series series, double value) {
+    double scale = series == SERIES_VOLT ? 10000.0 : 100.0;
+    double q = value * scale + 0.5;
+    if (q < 0.0) return 0;
+    if (q > 65535.0) return 65535;
+    return static_cast<uint16_t>(q);
+}
+
+double MetricHistory::decode(Series series, uint16_t q) {
+    return series == SERIES_VOLT ? q / 10000.0 : q / 100.0;
+}
+
+const char* MetricHistory::seriesName(Series series) {
+    static const char* const names[SERIES_COUNT] = {"cpu", "mem", "temp", "volt"};
+    return (series >= 0 && series < SERIES_COUNT) ? names[series] : "?";
+}
+
+void MetricHistory::push(Series series, Tier tier, int64_t unixSec, uint16_t q) {
+    Data::TierState& st = data_->state[series][tier];
+    Bucket* ring = data_->ring(series, tier);
+    const uint32_t cap = kCapacity[tier];
+    int64_t period = unixSec / kPeriodSec[tier];
+    if (period < st.period) {
+        // A small step back (NTP slew) is ignored; a clock further behind
+        // than the ring spans (no RTC, booted offline or from a stale
+        // fake-hwclock) would freeze the tier until it caught up, so start
+        // the tier over from here instead
+        if (st.period - period < cap) return;
+        for (uint32_t i = 0; i < cap; ++i) ring[i] = Bucket{};
+        st.period = period;
+        st.sum = 0;
+    }
+    if (period > st.period) {
+        // Step over (and blank) the periods nothing was recorded in
+        int64_t steps = period - st.period;
+        if (steps > cap) steps = cap;
+        for (int64_t i = 0; i < steps; ++i) {
+            st.head = (st.head + 1) % cap;
+            ring[st.head] = Bucket{};
+        }
+        st.period = period;
+        st.sum = 0;
+    }
+    Bucket& b = ring[st.head];
+    if (b.count == 0 || q < b.min) b.min = q;
+    if (b.count == 0 || q > b.max) b.max = q;
+    if (b.count < UINT16_MAX) {
+        ++b.count;
+        st.sum += q;
+    }
+    b.avg = static_cast<uint16_t>(st.sum / b.count);
+}
+
+void MetricHistory::append(int64_t unixSec, const Stats& s) {
+    if (!data_ || unixSec <= 0) return;
+    struct Sample { Series series; bool ok; double value; };
+    const Sample samples[] = {
+        {SERIES_CPU, true, static_cast<double>(s.cpu_percent)},
+        {SERIES_MEM, s.mem_total_kb != 0, static_cast<double>(s.mem_percent)},
+        {SERIES_TEMP, s.has(SRC_TEMP), s.cpu_temp_c},
+        {SERIES_VOLT, s.has(SRC_VOLTAGE), s.voltage_v},
+    };
+    for (const Sample& smp : samples) {
+        if (!smp.ok) continue;
+        uint16_t q = encode(smp.series, smp.value);
+        for (int t = 0; t < TIER_COUNT; ++t) push(smp.series, static_cast<Tier>(t), unixSec, q);
+    }
+}
+
+int MetricHistory::recent(Series series, Tier tier, int64_t unixSec, Bucket* out, int n) const {
+    if (n <= 0) return 0;
+    if (!data_) {
+        for (int i = 0; i < n; ++i) out[i] = Bucket{};
+        return n;
+    }
+    const Data::TierState& st = data_->state[series][tier];
+    const Bucket* ring = data_->ring(series, tier);
+    const int64_t cap = kCapacity[tier];
+    int64_t period = unixSec / kPeriodSec[tier];
+    for (int i = 0; i < n; ++i) {
+        int64_t age = st.period - (period - (n - 1 - i)); // 0 = head slot
+        out[i] = (age < 0 || age >= cap) ? Bucket{} : ring[(st.head + cap - age) % cap];
+    }
+    return n;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "stats.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Per-metric history at three resolutions (1 s, 1 min, 1 h). Each tier is
+// a fixed ring of quantised min/max/avg buckets; the slot for the current
+// period is updated in place, so there's no separate accumulator to lose.
+// The whole store is one POD block mapped from a file: a restart picks it
+// up as-is (no parse step), and appends never allocate.
+class MetricHistory {
+public:
+    enum Series : int { SERIES_CPU, SERIES_MEM, SERIES_TEMP, SERIES_VOLT, SERIES_COUNT };
+    enum Tier : int { TIER_1S, TIER_1M, TIER_1H, TIER_COUNT };
+
+    // Ring capacities: 10 min of seconds, 24 h of minutes, 7 days of hours
+    static constexpr uint32_t kCapacity[TIER_COUNT] = {600, 1440, 168};
+    static constexpr int64_t kPeriodSec[TIER_COUNT] = {1, 60, 3600};
+
+    // Quantised values; count == 0 marks a period with no samples
+    struct Bucket {
+        uint16_t min, max, avg, count;
+    };
+
+    MetricHistory() = default;
+    ~MetricHistory();
+    MetricHistory(const MetricHistory&) = delete;
+    MetricHistory& operator=(const MetricHistory&) = delete;
+
+    // Map `path` (created/resized as needed; a file with a foreign layout is
+    // reset). Empty path, or a file that can't be mapped, falls back to an
+    // anonymous mapping: history works but doesn't survive restarts.
+    bool open(const std::string& path);
+    bool persistent() const { return persistent_; }
+
+    // One sample of every series at wall-clock second `unixSec`. Sources
+    // that aren't available are skipped. Older than the newest period:
+    // ignored (clock stepped back), unless it is more than the tier's span
+    // behind, which blanks the tier and restarts it at `unixSec`.
+    void append(int64_t unixSec, const Stats& s);
+
+    // Last n buckets of a tier ending at the period containing `unixSec`,
+    // oldest first; periods with no data come back with count 0.
+    int recent(Series series, Tier tier, int64_t unixSec, Bucket* out, int n) const;
+
+    // Quantisation: cpu/mem in 0.01 %, temp in 0.01 'C, voltage in 0.1 mV
+    static uint16_t encode(Series series, double value);
+    static double decode(Series series, uint16_t q);
+    static const char* seriesName(Series series);
+
+    static size_t fileSize();
+
+private:
+    struct Data;
+    Data* data_ = nullptr;
+    bool persistent_ = false;
+
+    void push(Series series, Tier tier, int64_t unixSec, uint16_t q);
+};
@@ -0,0 +1,298 @@
+#include "i2c_transport.h"
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+
+LinuxI2CBus::LinuxI2CBus(const std::string& dev, uint16_t addr) {
+    fd_ = ::open(dev.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd_ >= 0) {
+        if (ioctl(fd_, I2C_SLAVE, addr) < 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+}
+
+LinuxI2CBus::~LinuxI2CBus() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+int LinuxI2CBus::rdwr(i2c_msg* msgs, size_t count) {
+    if (fd_ < 0) return -EBADF;
+    i2c_rdwr_ioctl_data xfer{};
+    xfer.msgs = msgs;
+    xfer.nmsgs = static_cast<__u32>(count);
+    if (ioctl(fd_, I2C_RDWR, &xfer) < 0) return -errno;
+    return 0;
+}
+
+int LinuxI2CBus::write(const uint8_t* data, size_t len) {
+    if (fd_ < 0) return -EBADF;
+    ssize_t n = ::write(fd_, data, len);
+    if (n < 0) return -errno;
+    return static_cast<size_t>(n) == len ? 0 : -EIO;
+}
+
+// --- Mock adapter -----------------------------------------------------------
+
+MockI2CBus::MockI2CBus(size_t maxMsgLen, bool rdwrSupported, int columnOffset)
+    : maxMsgLen_(maxMsgLen), rdwrSupported_(rdwrSupported), columnOffset_(columnOffset) {}
+
+int MockI2CBus::rdwr(i2c_msg* msgs, size_t count) {
+    ++syscalls_;
+    if (!rdwrSupported_) return -ENOTTY;
+    if (count > I2C_RDWR_IOCTL_MAX_MSGS) return -EINVAL;
+    // i2c-dev validates the whole transaction before anything hits the bus
+    for (size_t i = 0; i < count; ++i) {
+        if (maxMsgLen_ && msgs[i].len > maxMsgLen_) return -EINVAL;
+    }
+    for (size_t i = 0; i < count; ++i) message(msgs[i].buf, msgs[i].len);
+    return 0;
+}
+
+int MockI2CBus::write(const uint8_t* data, size_t len) {
+    ++syscalls_;
+    message(data, len);
+    return 0;
+}
+
+void MockI2CBus::message(const uint8_t* buf, size_t len) {
+    ++messages_;
+    bytes_ += len;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t ctrl = buf[i++];
+        bool isData = (ctrl & 0x40) != 0;
+        // Co=1: a single byte follows, then another control byte
+        size_t end = (ctrl & 0x80) ? std::min(len, i + 1) : len;
+        for (; i < end; ++i) {
+            if (isData) data(buf[i]); else command(buf[i]);
+        }
+    }
+}
+
+static int commandArgs(uint8_t op) {
+    switch (op) {
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xAD:
+        case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        case 0x21: case 0x22: case 0xA3:
+            return 2;
+        case 0x29: case 0x2A:
+            return 5;
+        case 0x26: case 0x27:
+            return 6;
+        default:
+            return 0;
+    }
+}
+
+void MockI2CBus::command(uint8_t b) {
+    if (pendingNeed_ > 0) {
+        pending_[pendingLen_++] = b;
+        if (--pendingNeed_ > 0) return;
+    } else {
+        pending_[0] = b;
+        pendingLen_ = 1;
+        pendingNeed_ = commandArgs(b);
+        if (pendingNeed_ > 0) return;
+    }
+    uint8_t op = pending_[0];
+    if (pendingLen_ == 1 && op < 0x20) {
+        // Page addressing column pointer: low / high nibble
+        col_ = op < 0x10 ? (col_ & 0xF0) | op : (col_ & 0x0F) | ((op & 0x0F) << 4);
+        pendingLen_ = 0;
+        return;
+    }
+    if (op >= 0xB0 && op <= 0xB7) {
+        page_ = op & (MAX_PAGES - 1);
+        pendingLen_ = 0;
+        return;
+    }
+    switch (op) {
+        case 0x20:
+            horizontal_ = (pending_[1] & 0x03) == 0x00;
+            break;
+        case 0x21:
+            colStart_ = pending_[1] & 0x7F;
+            colEnd_ = pending_[2] & 0x7F;
+            col_ = colStart_;
+            break;
+        case 0x22:
+            pageStart_ = pending_[1] & (MAX_PAGES - 1);
+            pageEnd_ = pending_[2] & (MAX_PAGES - 1);
+            page_ = pageStart_;
+            break;
+        case 0x81:
+            contrast_ = pending_[1];
+            break;
+        case 0xA6: case 0xA7:
+            inverted_ = op == 0xA7;
+            break;
+        case 0xAE: case 0xAF:
+            on_ = op == 0xAF;
+            break;
+        case 0x2E: case 0x2F:
+            scrolling_ = op == 0x2F;
+            break;
+        default:
+            break;
+    }
+    pendingLen_ = 0;
+}
+
+void MockI2CBus::data(uint8_t b) {
+    ++dataBytes_;
+    if (!horizontal_) {
+        // Page addressing: the pointer runs along the page and stops at the
+        // end of controller RAM
+        int x = col_ - columnOffset_;
+        if (x >= 0 && x < COLS) ram_[page_ * COLS + x] = b;
+        if (col_ < COLS + 2 * columnOffset_ - 1) ++col_;
+        return;
+    }
+    ram_[page_ * COLS + col_] = b;
+    // Horizontal addressing: wrap to the next page inside the window
+    if (++col_ > colEnd_) {
+        col_ = colStart_;
+        if (++page_ > pageEnd_) page_ = pageStart_;
+    }
+}
+
+// --- Transport --------------------------------------------------------------
+
+I2CTransport::I2CTransport(I2CBus& bus, uint16_t addr, size_t maxTransfer)
+    : bus_(bus), addr_(addr) {
+    if (maxTransfer < 2) maxTransfer = 2;
+    if (maxTransfer > kMaxTransfer) maxTransfer = kMaxTransfer;
+    maxTransfer_ = maxTransfer;
+    wire_.reserve(2048);
+    msgs_.reserve(16);
+    iov_.reserve(16);
+}
+
+void I2CTransport::append(uint8_t ctrl, const uint8_t* p, size_t n) {
+    while (n > 0) {
+        bool extend = !msgs_.empty() && wire_[msgs_.back().off] == ctrl &&
+                      msgs_.back().len < maxTransfer_;
+        if (!extend) {
+            msgs_.push_back({wire_.size(), 1});
+            wire_.push_back(ctrl);
+        }
+        Msg& m = msgs_.back();
+        size_t take = std::min(n, maxTransfer_ - m.len);
+        wire_.insert(wire_.end(), p, p + take);
+        m.len += take;
+        p += take;
+        n -= take;
+    }
+}
+
+void I2CTransport::queueCmds(const uint8_t* cmds, size_t n) { append(0x00, cmds, n); }
+
+void I2CTransport::queueData(const uint8_t* data, size_t n) { append(0x40, data, n); }
+
+static bool isUnsupported(int err) {
+    return err == -EINVAL || err == -EOPNOTSUPP || err == -ENOTTY || err == -ENOSYS;
+}
+
+// NACKs and arbitration/timeouts on a bus shared with sensors are usually
+// gone on the next attempt
+static bool isTransient(int err) {
+    return err == -EREMOTEIO || err == -EIO || err == -ETIMEDOUT || err == -EAGAIN;
+}
+
+int I2CTransport::rdwrRetry(i2c_msg* msgs, size_t count) {
+    ++c_.syscalls;
+    int err = bus_.rdwr(msgs, count);
+    if (err != 0 && isTransient(err)) {
+        ++c_.retries;
+        ++c_.syscalls;
+        err = bus_.rdwr(msgs, count);
+    }
+    return err;
+}
+
+int I2CTransport::writeRetry(const uint8_t* data, size_t len) {
+    ++c_.syscalls;
+    int err = bus_.write(data, len);
+    if (err != 0 && isTransient(err)) {
+        ++c_.retries;
+        ++c_.syscalls;
+        err = bus_.write(data, len);
+    }
+    return err;
+}
+
+bool I2CTransport::submitBatched(size_t& done) {
+    iov_.clear();
+    for (const Msg& m : msgs_) {
+        i2c_msg im{};
+        im.addr = addr_;
+        im.flags = 0;
+        im.len = static_cast<__u16>(m.len);
+        im.buf = &wire_[m.off];
+        iov_.push_back(im);
+    }
+    while (done < iov_.size()) {
+        size_t n = std::min<size_t>(iov_.size() - done, I2C_RDWR_IOCTL_MAX_MSGS);
+        int err = rdwrRetry(&iov_[done], n);
+        if (err != 0) {
+            if (!isUnsupported(err)) return false;
+            fallback_ = true;
+            ++c_.fallbacks;
+            return submitWrites(done);
+        }
+        done += n;
+    }
+    return true;
+}
+
+bool I2CTransport::submitWrites(size_t from) {
+    // Same packets the driver used before batching: one write() per command
+    // byte, data in 16-byte chunks behind a 0x40 control byte
+    uint8_t packet[17];
+    for (size_t i = from; i < msgs_.size(); ++i) {
+        const uint8_t* p = &wire_[msgs_[i].off];
+        uint8_t ctrl = p[0];
+        size_t len = msgs_[i].len - 1;
+        ++p;
+        size_t step = (ctrl == 0x00) ? 1 : 16;
+        packet[0] = ctrl;
+        for (size_t off = 0; off < len; off += step) {
+            size_t n = std::min(step, len - off);
+            std::copy(p + off, p + off + n, packet + 1);
+            if (writeRetry(packet, n + 1) != 0) return false;
+        }
+    }
+    return true;
+}
+
+bool I2CTransport::flush() {
+    if (msgs_.empty()) return true;
+    auto t0 = std::chrono::steady_clock::now();
+
+    bool ok;
+    if (fallback_) {
+        ok = submitWrites(0);
+    } else {
+        size_t done = 0;
+        ok = submitBatched(done);
+    }
+
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    c_.lastFlushUs = static_cast<uint32_t>(us);
+    if (c_.lastFlushUs > c_.maxFlushUs) c_.maxFlushUs = c_.lastFlushUs;
+    ++c_.flushes;
+    c_.bytes += wire_.size();
+    if (!ok) ++c_.errors;
+
+    wire_.clear();
+    msgs_.clear();
+    return ok;
+}
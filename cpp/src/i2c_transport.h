@@ -0,0 +1,135 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <linux/i2c.h>
+
+// Byte-level access to an i2c-dev adapter. Split out of SSD1306 so the
+// batching logic can run against a fake bus when no display is attached.
+class I2CBus {
+public:
+    virtual ~I2CBus() = default;
+    virtual bool isOpen() const = 0;
+    // One ioctl(I2C_RDWR) transaction; returns 0 or -errno
+    virtual int rdwr(i2c_msg* msgs, size_t count) = 0;
+    // One write() to the I2C_SLAVE address; returns 0 or -errno
+    virtual int write(const uint8_t* data, size_t len) = 0;
+    // Called by the driver after each display(); lets emulated panels
+    // capture whole frames
+    virtual void endFrame() {}
+};
+
+// Real /dev/i2c-N adapter bound to one slave address
+class LinuxI2CBus : public I2CBus {
+public:
+    LinuxI2CBus(const std::string& dev, uint16_t addr);
+    ~LinuxI2CBus() override;
+    bool isOpen() const override { return fd_ >= 0; }
+    int rdwr(i2c_msg* msgs, size_t count) override;
+    int write(const uint8_t* data, size_t len) override;
+
+private:
+    int fd_ = -1;
+};
+
+// In-memory stand-in for an SSD1306/SH1106 on i2c-dev: decodes the command
+// stream (addressing windows, memory mode, page/column pointers) into an
+// emulated GDDRAM so the frames a driver produces can be inspected without
+// hardware.
+class MockI2CBus : public I2CBus {
+public:
+    static constexpr int COLS = 128;
+    static constexpr int MAX_PAGES = 8;
+
+    // maxMsgLen emulates an adapter that rejects long messages with EINVAL
+    // (0 = no limit); rdwrSupported=false emulates one without I2C_RDWR.
+    // columnOffset is where the glass starts in controller RAM (2 on SH1106);
+    // gddram() is always the visible 128 columns.
+    explicit MockI2CBus(size_t maxMsgLen = 0, bool rdwrSupported = true, int columnOffset = 0);
+    bool isOpen() const override { return true; }
+    int rdwr(i2c_msg* msgs, size_t count) override;
+    int write(const uint8_t* data, size_t len) override;
+
+    const uint8_t* gddram() const { return ram_; }
+    uint64_t syscalls() const { return syscalls_; }
+    uint64_t messages() const { return messages_; }
+    uint64_t bytes() const { return bytes_; }
+    uint64_t dataBytes() const { return dataBytes_; }
+    // Display state set by commands; the scroll itself isn't emulated
+    bool displayOn() const { return on_; }
+    bool inverted() const { return inverted_; }
+    uint8_t contrast() const { return contrast_; }
+    bool scrolling() const { return scrolling_; }
+
+private:
+    size_t maxMsgLen_;
+    bool rdwrSupported_;
+    int columnOffset_;
+    uint8_t ram_[COLS * MAX_PAGES] = {};
+    bool horizontal_ = false; // power-on default is page addressing
+    int col_ = 0, page_ = 0;
+    int colStart_ = 0, colEnd_ = COLS - 1;
+    int pageStart_ = 0, pageEnd_ = MAX_PAGES - 1;
+    bool on_ = false, inverted_ = false, scrolling_ = false;
+    uint8_t contrast_ = 0x7F; // reset value
+    // Pending multi-byte command (opcode + collected args)
+    uint8_t pending_[8] = {};
+    int pendingLen_ = 0, pendingNeed_ = 0;
+    uint64_t syscalls_ = 0, messages_ = 0, bytes_ = 0, dataBytes_ = 0;
+
+    void message(const uint8_t* buf, size_t len);
+    void command(uint8_t b);
+    void data(uint8_t b);
+};
+
+// Queues SSD1306 command sequences and data payloads and submits them as a
+// few large I2C_RDWR transactions instead of one write() per packet.
+class I2CTransport {
+public:
+    // Largest single message the adapter is asked to take (control byte included)
+    static constexpr size_t kDefaultMaxTransfer = 1025;
+    static constexpr size_t kMaxTransfer = 8192;
+
+    I2CTransport(I2CBus& bus, uint16_t addr, size_t maxTransfer = kDefaultMaxTransfer);
+
+    void queueCmds(const uint8_t* cmds, size_t n);
+    void queueData(const uint8_t* data, size_t n);
+    // Submit everything queued; the queue is empty afterwards either way
+    bool flush();
+
+    size_t pendingBytes() const { return wire_.size(); }
+    // True once the adapter rejected batched messages and we fell back to
+    // the one-command / 16-byte-packet write() path
+    bool fallbackActive() const { return fallback_; }
+
+    struct Counters {
+        uint64_t flushes = 0;
+        uint64_t syscalls = 0;
+        uint64_t bytes = 0;      // on the wire, control bytes included
+        uint64_t errors = 0;     // failed flushes
+        uint64_t retries = 0;    // transfers resent after a transient bus error
+        uint64_t fallbacks = 0;  // batched submits retried on the write() path
+        uint32_t lastFlushUs = 0;
+        uint32_t maxFlushUs = 0;
+    };
+    const Counters& counters() const { return c_; }
+
+private:
+    struct Msg { size_t off; size_t len; };
+
+    I2CBus& bus_;
+    uint16_t addr_;
+    size_t maxTransfer_;
+    bool fallback_ = false;
+    std::vector<uint8_t> wire_; // control byte + payload per message
+    std::vector<Msg> msgs_;
+    std::vector<i2c_msg> iov_;
+    Counters c_;
+
+    void append(uint8_t ctrl, const uint8_t* p, size_t n);
+    bool submitBatched(size_t& done);
+    bool submitWrites(size_t from);
+    int rdwrRetry(i2c_msg* msgs, size_t count);
+    int writeRetry(const uint8_t* data, size_t len);
+};
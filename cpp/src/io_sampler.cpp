@@ -0,0 +1,187 @@
+#include "io_sampler.h"
+#include "metrics.h"
+#include <cstring>
+
+uint64_t counterDelta(uint64_t cur, uint64_t prev) {
+    if (cur >= prev) return cur - prev;
+    if (prev >= 0x80000000ull && prev <= 0xFFFFFFFFull) return cur + (0x100000000ull - prev);
+    return cur;
+}
+
+// Per-second rate of `delta` events over dtNs
+static uint64_t perSecond(uint64_t delta, uint64_t dtNs) {
+    return static_cast<uint64_t>(static_cast<double>(delta) * 1e9 / static_cast<double>(dtNs) + 0.5);
+}
+
+static uint32_t perSecondCeil(uint64_t delta, uint64_t dtNs) {
+    if (delta == 0) return 0;
+    double r = static_cast<double>(delta) * 1e9 / static_cast<double>(dtNs);
+    uint64_t v = static_cast<uint64_t>(r);
+    if (static_cast<double>(v) < r) ++v;
+    return v > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(v);
+}
+
+// Copy the token at p (up to a space, ':' or newline) into name; returns
+// the position after it
+static const char* readName(const char* p, char* name, size_t cap) {
+    p = procparse::skipSpaces(p);
+    size_t n = 0;
+    while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != ':') {
+        if (n + 1 < cap) name[n++] = *p;
+        ++p;
+    }
+    name[n] = '\0';
+    return p;
+}
+
+static bool allDigits(const char* p) {
+    if (!*p) return false;
+    for (; *p; ++p) {
+        if (*p < '0' || *p > '9') return false;
+    }
+    return true;
+}
+
+// Whole disks only: the kernel lists partitions next to their disk, and
+// summing both would double count
+static bool isWholeDisk(const char* name) {
+    using procparse::startsWith;
+    if (startsWith(name, "loop") || startsWith(name, "ram") || startsWith(name, "zram") || startsWith(name, "fd") ||
+        startsWith(name, "sr")) {
+        return false;
+    }
+    // eMMC hardware partitions (mmcblk0boot0, mmcblk0boot1, mmcblk0rpmb)
+    // are listed as disks of their own but are part of mmcblk0
+    if (startsWith(name, "mmcblk")) {
+        const char* p = name + 6;
+        while (*p >= '0' && *p <= '9') ++p;
+        if (std::strcmp(p, "rpmb") == 0 || (startsWith(p, "boot") && allDigits(p + 4))) return false;
+    }
+    // mmcblk0p1, nvme0n1p2: 'p' + digits after a digit
+    if (startsWith(name, "mmcblk") || startsWith(name, "nvme")) {
+        const char* p = std::strrchr(name, 'p');
+        return !(p && p > name && p[-1] >= '0' && p[-1] <= '9' && allDigits(p + 1));
+    }
+    // sda1, vdb2, xvda1: trailing digits
+    if (startsWith(name, "sd") || startsWith(name, "hd") || startsWith(name, "vd") || startsWith(name, "xvd")) {
+        size_t n = std::strlen(name);
+        return !(n > 0 && name[n - 1] >= '0' && name[n - 1] <= '9');
+    }
+    return true;
+}
+
+template <typename C, int N>
+static const C* findPrev(const C (&prev)[N], int count, const char* name) {
+    for (int i = 0; i < count; ++i) {
+        if (std::strcmp(prev[i].name, name) == 0) return &prev[i];
+    }
+    return nullptr;
+}
+
+DiskStatsSampler::DiskStatsSampler(std::string path) : file_(std::move(path)) {}
+
+bool DiskStatsSampler::sample() {
+    using namespace procparse;
+    // Loop devices come first and can number in the dozens (snaps)
+    char buf[16384];
+    if (file_.read(buf, sizeof(buf)) <= 0) return false;
+    uint64_t now = monotonicNs();
+    uint64_t dt = lastNs_ ? now - lastNs_ : 0;
+
+    Counters next[kMaxDevices];
+    DiskRate rates[kMaxDevices];
+    int n = 0;
+    for (const char* line = buf; line && n < kMaxDevices; line = nextLine(line)) {
+        // major minor name reads merged sectors ms writes merged sectors ms ...
+        uint64_t major = 0, minor = 0;
+        const char* p = parseU64(line, major);
+        if (!p || !(p = parseU64(p, minor))) continue;
+        Counters c{};
+        p = readName(p, c.name, sizeof(c.name));
+        if (!isWholeDisk(c.name)) continue;
+        uint64_t v[7] = {};
+        int got = 0;
+        for (; got < 7; ++got) {
+            const char* q = parseU64(p, v[got]);
+            if (!q) break;
+            p = q;
+        }
+        if (got < 7 || *p == '\0') continue; // short or truncated line
+        c.reads = v[0];
+        c.readSectors = v[2];
+        c.writes = v[4];
+        c.writeSectors = v[6];
+
+        DiskRate& r = rates[n];
+        std::memcpy(r.name, c.name, sizeof(r.name));
+        const Counters* old = findPrev(prev_, count_, c.name);
+        if (old && dt > 0) {
+            // diskstats sectors are always 512 bytes, whatever the device
+            r.read_bps = perSecond(counterDelta(c.readSectors, old->readSectors) * 512, dt);
+            r.write_bps = perSecond(counterDelta(c.writeSectors, old->writeSectors) * 512, dt);
+            r.read_iops = static_cast<uint32_t>(perSecond(counterDelta(c.reads, old->reads), dt));
+            r.write_iops = static_cast<uint32_t>(perSecond(counterDelta(c.writes, old->writes), dt));
+        }
+        next[n++] = c;
+    }
+    for (int i = 0; i < n; ++i) {
+        prev_[i] = next[i];
+        rates_[i] = rates[i];
+    }
+    count_ = n;
+    lastNs_ = now;
+    return true;
+}
+
+NetDevSampler::NetDevSampler(std::string path) : file_(std::move(path)) {}
+
+bool NetDevSampler::sample() {
+    using namespace procparse;
+    char buf[8192];
+    if (file_.read(buf, sizeof(buf)) <= 0) return false;
+    uint64_t now = monotonicNs();
+    uint64_t dt = lastNs_ ? now - lastNs_ : 0;
+
+    Counters next[kMaxInterfaces];
+    NetRate rates[kMaxInterfaces];
+    int n = 0;
+    // Two header lines, then "  eth0: rx_bytes packets errs drop fifo frame
+    // compressed multicast tx_bytes packets errs drop ..."
+    const char* line = nextLine(buf);
+    for (line = line ? nextLine(line) : nullptr; line && n < kMaxInterfaces; line = nextLine(line)) {
+        Counters c{};
+        const char* p = readName(line, c.name, sizeof(c.name));
+        if (*p != ':' || std::strcmp(c.name, "lo") == 0) continue;
+        ++p;
+        uint64_t v[12] = {};
+        int got = 0;
+        for (; got < 12; ++got) {
+            const char* q = parseU64(p, v[got]);
+            if (!q) break;
+            p = q;
+        }
+        if (got < 12) continue;
+        c.rxBytes = v[0];
+        c.rxDrops = v[3];
+        c.txBytes = v[8];
+        c.txDrops = v[11];
+
+        NetRate& r = rates[n];
+        std::memcpy(r.name, c.name, sizeof(r.name));
+        const Counters* old = findPrev(prev_, count_, c.name);
+        if (old && dt > 0) {
+            r.rx_bps = perSecond(counterDelta(c.rxBytes, old->rxBytes), dt);
+            r.tx_bps = perSecond(counterDelta(c.txBytes, old->txBytes), dt);
+            r.rx_drops = perSecondCeil(counterDelta(c.rxDrops, old->rxDrops), dt);
+            r.tx_drops = perSecondCeil(counterDelta(c.txDrops, old->txDrops), dt);
+        }
+        next[n++] = c;
+    }
+    for (int i = 0; i < n; ++i) {
+        prev_[i] = next[i];
+        rates_[i] = rates[i];
+    }
+    count_ = n;
+    lastNs_ = now;
+    return true;
+}
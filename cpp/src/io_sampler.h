@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "proc_reader.h"
+
+// Throughput of one block device over the last sampling interval
+struct DiskRate {
+    char name[16] = "";
+    uint64_t read_bps = 0;  // bytes/s
+    uint64_t write_bps = 0;
+    uint32_t read_iops = 0; // completed requests/s
+    uint32_t write_iops = 0;
+};
+
+// Throughput of one network interface over the last sampling interval
+struct NetRate {
+    char name[16] = "";
+    uint64_t rx_bps = 0; // bytes/s
+    uint64_t tx_bps = 0;
+    uint32_t rx_drops = 0; // dropped packets/s, rounded up so any drop shows
+    uint32_t tx_drops = 0;
+};
+
+// Difference of two kernel counter readings. A counter below its previous
+// value either wrapped at 32 bits (diskstats fields are unsigned long, so
+// 32-bit on armhf; some net drivers too) or restarted from zero (device
+// re-created); a previous value in the upper half of the 32-bit range is
+// taken as a wrap.
+uint64_t counterDelta(uint64_t cur, uint64_t prev);
+
+// Stateful /proc/diskstats reader for whole disks (partitions, eMMC boot and
+// RPMB areas, loop, ram and zram devices are skipped). Devices are matched by name between samples, so
+// hotplug just starts a new one at zero; the first sample reports zeros.
+// Fixed-size state, no allocation per sample.
+class DiskStatsSampler {
+public:
+    static constexpr int kMaxDevices = 8;
+
+    explicit DiskStatsSampler(std::string path = "/proc/diskstats");
+
+    bool sample();
+    int count() const { return count_; }
+    const DiskRate& device(int i) const { return rates_[i]; }
+
+private:
+    struct Counters {
+        char name[16];
+        uint64_t reads, readSectors, writes, writeSectors;
+    };
+    ProcFile file_;
+    int count_ = 0;
+    uint64_t lastNs_ = 0;
+    Counters prev_[kMaxDevices] = {};
+    DiskRate rates_[kMaxDevices];
+};
+
+// Stateful /proc/net/dev reader, same scheme as DiskStatsSampler; the
+// loopback interface is skipped.
+class NetDevSampler {
+public:
+    static constexpr int kMaxInterfaces = 8;
+
+    explicit NetDevSampler(std::string path = "/proc/net/dev");
+
+    bool sample();
+    int count() const { return count_; }
+    const NetRate& interface(int i) const { return rates_[i]; }
+
+private:
+    struct Counters {
+        char name[16];
+        uint64_t rxBytes, rxDrops, txBytes, txDrops;
+    };
+    ProcFile file_;
+    int count_ = 0;
+    uint64_t lastNs_ = 0;
+    Counters prev_[kMaxInterfaces] = {};
+    NetRate rates_[kMaxInterfaces];
+};
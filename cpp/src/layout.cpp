@@ -0,0 +1,305 @@
+#include "layout.h"
+#include <cstdio>
+#include <cstring>
+
+// CPU donut geometry per portrait width, resolved at compile time
+constexpr gauge::RingLut<15, 12> kCpuRing{};
+constexpr gauge::RingLut<20, 16> kCpuRingWide{};
+
+bool ScreenView::operator==(const ScreenView& o) const {
+    return std::strcmp(ip, o.ip) == 0 && std::strcmp(freq, o.freq) == 0 &&
+           std::strcmp(cpu, o.cpu) == 0 && cpuPercent == o.cpuPercent && memPercent == o.memPercent &&
+           diskPercent == o.diskPercent && page == o.page &&
+           warning == o.warning && stall == o.stall && std::strcmp(line1, o.line1) == 0 && std::strcmp(line2, o.line2) == 0 &&
+           std::strcmp(temp, o.temp) == 0 && std::strcmp(power, o.power) == 0 &&
+           std::strcmp(diskIo, o.diskIo) == 0 && std::strcmp(netIo, o.netIo) == 0 &&
+           std::strcmp(top1, o.top1) == 0 && std::strcmp(top2, o.top2) == 0 &&
+           std::strcmp(unit1, o.unit1) == 0 && std::strcmp(unit2, o.unit2) == 0 &&
+           std::strcmp(cluster, o.cluster) == 0 && nodeBars == o.nodeBars &&
+           std::memcmp(nodeCpu, o.nodeCpu, sizeof(nodeCpu)) == 0 &&
+           std::memcmp(cpuSpark, o.cpuSpark, sizeof(cpuSpark)) == 0 &&
+           std::memcmp(tempSpark, o.tempSpark, sizeof(tempSpark)) == 0;
+}
+
+// Sparkline scales: CPU 0..100 %, temperature 30..85 'C. Any sample in
+// range gets at least one pixel so it reads differently from "no data".
+static void sparkHeights(const MetricHistory& h, MetricHistory::Series series, int64_t unixSec,
+                         double lo, double hi, uint8_t* out) {
+    constexpr int n = ScreenView::kSparkSamples;
+    constexpr int px = ScreenView::kSparkHeight;
+    MetricHistory::Bucket b[n];
+    h.recent(series, MetricHistory::TIER_1S, unixSec, b, n);
+    for (int i = 0; i < n; ++i) {
+        if (b[i].count == 0) { out[i] = 0; continue; }
+        double f = (MetricHistory::decode(series, b[i].avg) - lo) / (hi - lo);
+        int v = static_cast<int>(f * px + 0.5);
+        out[i] = static_cast<uint8_t>(v < 1 ? 1 : (v > px ? px : v));
+    }
+}
+
+void formatTicker(const ScreenView& v, char* out, size_t n) {
+    std::snprintf(out, n, "C%s %s M%d D%d %s ", v.cpu, v.temp, v.memPercent, v.diskPercent, v.freq);
+}
+
+void formatRate(uint64_t bps, char* out, size_t n) {
+    static const char kUnits[] = "KMGT";
+    if (bps < 1000) {
+        std::snprintf(out, n, "%u", static_cast<unsigned>(bps));
+        return;
+    }
+    double v = static_cast<double>(bps) / 1000.0;
+    int u = 0;
+    while (v >= 999.5 && u < 3) {
+        v /= 1000.0;
+        ++u;
+    }
+    if (v < 9.95) std::snprintf(out, n, "%.1f%c", v, kUnits[u]);
+    else std::snprintf(out, n, "%.0f%c", v, kUnits[u]);
+}
+
+ScreenView makeScreenView(const Stats& s, Page page, double uvThreshold,
+                          const MetricHistory* history, int64_t unixSec, const ClusterSummary* cluster) {
+    ScreenView v;
+    std::snprintf(v.ip, sizeof(v.ip), "%s", s.ip_last_octet);
+
+    // CPU freq (xx.xG)
+    double freqVal = s.has(SRC_FREQ) ? s.cpu_freq_ghz : 0.0;
+    std::snprintf(v.freq, sizeof(v.freq), "%.1fG", freqVal);
+
+    v.cpuPercent = gauge::clampPercent(s.cpu_percent);
+    std::snprintf(v.cpu, sizeof(v.cpu), "%d%%", s.cpu_percent);
+    v.memPercent = gauge::clampPercent(s.mem_percent);
+    v.diskPercent = gauge::clampPercent(s.disk_percent);
+
+    bool haveV = s.has(SRC_VOLTAGE);
+    double volts = s.voltage_v;
+    bool low = haveV && volts < uvThreshold && volts > 0.0;
+    v.warning = low || s.throttled;
+    if (s.has(SRC_TEMP)) std::snprintf(v.temp, sizeof(v.temp), "T:%.1fC", s.cpu_temp_c);
+    else std::snprintf(v.temp, sizeof(v.temp), "T:NA");
+    if (s.throttled) std::snprintf(v.power, sizeof(v.power), "H:%X", s.throttle_raw);
+    else if (haveV) std::snprintf(v.power, sizeof(v.power), "V:%.1f", volts);
+    else std::snprintf(v.power, sizeof(v.power), "V:NA");
+
+    // Lower section (alternate sets)
+    v.page = page;
+    if (page == Page::Main) {
+        std::snprintf(v.line1, sizeof(v.line1), "R:%d%%", s.mem_percent);
+        std::snprintf(v.line2, sizeof(v.line2), "D:%d%%", s.disk_percent);
+    } else if (page == Page::Thermal) {
+        std::snprintf(v.line1, sizeof(v.line1), "%s", v.temp);
+        std::snprintf(v.line2, sizeof(v.line2), "%s", v.power);
+    } else if (page == Page::Procs) {
+        // Portrait: the busiest process name cut to five characters and its
+        // CPU share; landscape lists two with their resident memory
+        if (s.top_count > 0) {
+            const ProcessUsage& p = s.top_cpu[0];
+            std::snprintf(v.line1, sizeof(v.line1), "%.5s", p.name);
+            std::snprintf(v.line2, sizeof(v.line2), "%.0f%%", static_cast<double>(p.cpu_percent));
+        } else {
+            std::snprintf(v.line1, sizeof(v.line1), "P:NA");
+        }
+        char* rows[2] = {v.top1, v.top2};
+        for (int i = 0; i < 2 && i < s.top_count; ++i) {
+            const ProcessUsage& p = s.top_cpu[i];
+            char rss[6];
+            formatRate(p.rss_kb * 1024, rss, sizeof(rss));
+            double pct = static_cast<double>(p.cpu_percent);
+            std::snprintf(rows[i], sizeof(v.top1), "%-9.9s%3.0f%% %s", p.name, pct > 999.0 ? 999.0 : pct, rss);
+        }
+    } else if (page == Page::Units) {
+        // Like Procs, for the configured systemd units
+        if (s.unit_top_count > 0) {
+            const UnitUsage& u = s.units[0];
+            std::snprintf(v.line1, sizeof(v.line1), "%.5s", u.name);
+            std::snprintf(v.line2, sizeof(v.line2), "%.0f%%", static_cast<double>(u.cpu_percent));
+        } else {
+            std::snprintf(v.line1, sizeof(v.line1), "U:NA");
+            std::snprintf(v.unit1, sizeof(v.unit1), "no units");
+        }
+        char* rows[2] = {v.unit1, v.unit2};
+        for (int i = 0; i < 2 && i < s.unit_top_count; ++i) {
+            const UnitUsage& u = s.units[i];
+            char mem[6];
+            formatRate(u.mem_kb * 1024, mem, sizeof(mem));
+            double pct = static_cast<double>(u.cpu_percent);
+            std::snprintf(rows[i], sizeof(v.unit1), "%-9.9s%3.0f%% %s", u.name, pct > 999.0 ? 999.0 : pct, mem);
+        }
+    } else if (page == Page::Cluster) {
+        // Portrait: node count, then "THR" + how many nodes are throttled or
+        // the worst temperature; landscape says both and which node is hot
+        const ClusterSummary c = cluster ? *cluster : ClusterSummary{};
+        std::snprintf(v.line1, sizeof(v.line1), "N:%d", c.nodes);
+        if (c.throttled) std::snprintf(v.line2, sizeof(v.line2), "THR%d", c.throttled > 99 ? 99 : c.throttled);
+        else if (c.haveTemp) std::snprintf(v.line2, sizeof(v.line2), "%.0fC", static_cast<double>(c.worstTemp));
+        else std::snprintf(v.line2, sizeof(v.line2), "T:NA");
+        if (c.nodes == 0) {
+            std::snprintf(v.cluster, sizeof(v.cluster), "no nodes");
+        } else {
+            int off = std::snprintf(v.cluster, sizeof(v.cluster), "%dN", c.nodes);
+            if (c.haveTemp) {
+                off += std::snprintf(v.cluster + off, sizeof(v.cluster) - static_cast<size_t>(off), " %.1fC@%u",
+                                     static_cast<double>(c.worstTemp), c.worstNode);
+            }
+            if (c.throttled) {
+                std::snprintf(v.cluster + off, sizeof(v.cluster) - static_cast<size_t>(off), " THR%d", c.throttled);
+            }
+        }
+        v.nodeBars = static_cast<uint8_t>(c.bars);
+        std::memcpy(v.nodeCpu, c.barCpu, sizeof(v.nodeCpu));
+    } else {
+        // Portrait fits five characters: disk and network totals, both
+        // directions summed; landscape splits them
+        const IoTotals t = ioTotals(s);
+        char a[6], b[6];
+        formatRate(t.read_bps + t.write_bps, a, sizeof(a));
+        std::snprintf(v.line1, sizeof(v.line1), "D%s", a);
+        formatRate(t.rx_bps + t.tx_bps, a, sizeof(a));
+        std::snprintf(v.line2, sizeof(v.line2), "N%s", a);
+        formatRate(t.read_bps, a, sizeof(a));
+        formatRate(t.write_bps, b, sizeof(b));
+        std::snprintf(v.diskIo, sizeof(v.diskIo), "DSK R%s W%s", a, b);
+        formatRate(t.rx_bps, a, sizeof(a));
+        formatRate(t.tx_bps, b, sizeof(b));
+        uint32_t drops = t.rx_drops + t.tx_drops;
+        if (drops) std::snprintf(v.netIo, sizeof(v.netIo), "NET R%s T%s D%u", a, b, drops > 9999 ? 9999u : drops);
+        else std::snprintf(v.netIo, sizeof(v.netIo), "NET R%s T%s", a, b);
+    }
+
+    if (history) {
+        sparkHeights(*history, MetricHistory::SERIES_CPU, unixSec, 0.0, 100.0, v.cpuSpark);
+        sparkHeights(*history, MetricHistory::SERIES_TEMP, unixSec, 30.0, 85.0, v.tempSpark);
+    }
+    return v;
+}
+
+template <typename P>
+void renderPortrait(Canvas<P, Rotation::Portrait>& canvas, const ScreenView& v) {
+    using Cv = Canvas<P, Rotation::Portrait>;
+    // The portrait height is the panel width (128) on every panel; a 64-row
+    // panel only makes it wider, so the layout scales horizontally
+    constexpr int S = Cv::W / 32;
+    canvas.clear();
+
+    // 1) IP (proportional scaling) in reserved top area
+    int ipAreaHeight = 26; // reserved vertical space
+    canvas.textFit(v.ip, 0, ipAreaHeight);
+
+    // 2) Divider
+    canvas.hline(0, ipAreaHeight, Cv::W);
+
+    // 3) CPU freq
+    canvas.textCentered(ipAreaHeight + 4, v.freq);
+
+    // 4) CPU donut + percent
+    int cx = Cv::W / 2, cy = 64;
+    auto plot = [&](int x, int y) { canvas.setPixel(x, y); };
+    if constexpr (S == 1) gauge::drawRing(kCpuRing, cx, cy, v.cpuPercent, plot);
+    else gauge::drawRing(kCpuRingWide, cx, cy, v.cpuPercent, plot);
+    canvas.textCentered(58, v.cpu);
+
+    // 5) Lower section
+    canvas.textCentered(86, v.line1);
+    if (v.page == Page::Main && v.warning) drawWarnIcon(canvas, 2, 101);
+    canvas.textCentered(101, v.line2);
+
+    // 6) Last 32 s of CPU and temperature across the full width
+    drawSparkline(canvas, 0, 111, v.cpuSpark, S, 1);
+    drawSparkline(canvas, 0, 120, v.tempSpark, S, 1);
+
+    if (v.stall) drawStallOverlay(canvas, 84, 26, v.stall);
+}
+
+void renderPortrait(PortraitCanvas& canvas, const Stats& s, bool phaseA, double uvThreshold) {
+    renderPortrait(canvas, makeScreenView(s, phaseA ? Page::Main : Page::Thermal, uvThreshold));
+}
+
+template <typename P>
+void renderLandscape(Canvas<P, Rotation::Landscape>& canvas, const ScreenView& v) {
+    using Cv = Canvas<P, Rotation::Landscape>;
+    // 32 rows: four text rows; the lower two cycle RAM/disk, temperature/
+    // sparklines and throughput. 64 rows: bars, temperature and sparklines
+    // (throughput on the Io page) at once.
+    constexpr bool kTall = Cv::H >= 64;
+    constexpr int kBarX = 56, kBarW = Cv::W - kBarX;
+    canvas.clear();
+    auto plot = [&](int x, int y) { canvas.setPixel(x, y); };
+    char buf[16];
+
+    // Row 0: IP left, frequency right, warning mark in between
+    std::snprintf(buf, sizeof(buf), "IP .%s", v.ip);
+    canvas.text(0, 0, buf);
+    canvas.text(Cv::W - static_cast<int>(std::strlen(v.freq)) * 6 + 1, 0, v.freq);
+    if (v.warning) canvas.text(60, 0, "!");
+
+    // Row 1: CPU
+    std::snprintf(buf, sizeof(buf), "CPU %s", v.cpu);
+    canvas.text(0, 8, buf);
+    gauge::drawBar(kBarX, 8, kBarW, 7, v.cpuPercent, plot);
+
+    if (kTall || v.page == Page::Main) {
+        // Rows 2-3: RAM and disk bars
+        std::snprintf(buf, sizeof(buf), "RAM %d%%", v.memPercent);
+        canvas.text(0, 16, buf);
+        gauge::drawBar(kBarX, 16, kBarW, 7, v.memPercent, plot);
+        std::snprintf(buf, sizeof(buf), "DSK %d%%", v.diskPercent);
+        canvas.text(0, 24, buf);
+        gauge::drawBar(kBarX, 24, kBarW, 7, v.diskPercent, plot);
+    }
+    if constexpr (kTall) {
+        // Rows 4+: temperature/voltage, then 2x sparklines side by side
+        canvas.hline(0, 33, Cv::W);
+        canvas.text(0, 36, v.temp);
+        canvas.text(kBarX + 8, 36, v.power);
+        if (v.page == Page::Io) {
+            canvas.text(0, 46, v.diskIo);
+            canvas.text(0, 55, v.netIo);
+        } else if (v.page == Page::Procs) {
+            canvas.text(0, 46, v.top1);
+            canvas.text(0, 55, v.top2);
+        } else if (v.page == Page::Units) {
+            canvas.text(0, 46, v.unit1);
+            canvas.text(0, 55, v.unit2);
+        } else if (v.page == Page::Cluster) {
+            canvas.text(0, 46, v.cluster);
+            drawNodeBars(canvas, 0, 55, Cv::W, 9, v.nodeCpu, v.nodeBars);
+        } else {
+            drawSparkline(canvas, 0, 46, v.cpuSpark, 2, 2);
+            drawSparkline(canvas, Cv::W / 2, 46, v.tempSpark, 2, 2);
+        }
+    } else if (v.page == Page::Io) {
+        // Rows 2-3: disk and network throughput
+        canvas.text(0, 16, v.diskIo);
+        canvas.text(0, 24, v.netIo);
+    } else if (v.page == Page::Procs) {
+        // Rows 2-3: the two busiest processes
+        canvas.text(0, 16, v.top1);
+        canvas.text(0, 24, v.top2);
+    } else if (v.page == Page::Units) {
+        // Rows 2-3: the two busiest systemd units
+        canvas.text(0, 16, v.unit1);
+        canvas.text(0, 24, v.unit2);
+    } else if (v.page == Page::Cluster) {
+        // Row 2: cluster summary; row 3: a CPU column per node
+        canvas.text(0, 16, v.cluster);
+        drawNodeBars(canvas, 0, 24, Cv::W, 8, v.nodeCpu, v.nodeBars);
+    } else if (v.page == Page::Thermal) {
+        // Row 2: temperature and voltage/throttle; row 3: sparklines
+        canvas.text(0, 16, v.temp);
+        canvas.text(kBarX, 16, v.power);
+        drawSparkline(canvas, 0, 24, v.cpuSpark, 1, 1);
+        drawSparkline(canvas, kBarX, 24, v.tempSpark, 1, 1);
+    }
+
+    if (v.stall) {
+        if constexpr (kTall) drawStallOverlay(canvas, 44, 20, v.stall);
+        else drawStallOverlay(canvas, 16, 16, v.stall);
+    }
+}
+
+template void renderPortrait(Canvas<Ssd1306_128x32, Rotation::Portrait>&, const ScreenView&);
+template void renderPortrait(Canvas<Ssd1306_128x64, Rotation::Portrait>&, const ScreenView&);
+template void renderPortrait(Canvas<Sh1106_128x64, Rotation::Portrait>&, const ScreenView&);
+template void renderLandscape(Canvas<Ssd1306_128x32, Rotation::Landscape>&, const ScreenView&);
+template void renderLandscape(Canvas<Ssd1306_128x64, Rotation::Landscape>&, const ScreenView&);
+template void renderLandscape(Canvas<Sh1106_128x64, Rotation::Landscape>&, const ScreenView&);
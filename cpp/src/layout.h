@@ -0,0 +1,172 @@
+#pragma once
+#include "canvas.h"
+#include "cluster.h"
+#include "gauge.h"
+#include "history.h"
+#include "stats.h"
+#include <cstdio>
+
+// Pages the lower screen section cycles through
+enum class Page { Main, Thermal, Io, Procs, Cluster, Units, Count };
+
+// Everything the stats screens show, already formatted. Two views that
+// compare equal render to identical frames, so the main loop compares
+// views instead of framebuffers to decide whether to redraw at all.
+struct ScreenView {
+    static constexpr int kSparkSamples = 32; // one per column
+    static constexpr int kSparkHeight = 8;
+
+    char ip[4] = "";
+    char freq[12] = "";
+    char cpu[8] = "";
+    int cpuPercent = 0;  // donut sweep / bar fill
+    int memPercent = 0;
+    int diskPercent = 0;
+    Page page = Page::Main;
+    bool warning = false; // low voltage or throttled
+    uint8_t stall = 0;    // 1 << PsiResource for recently fired PSI triggers (set by the caller)
+    char line1[12] = "";  // R:.. / T:.. / D<rate>
+    char line2[16] = "";  // D:.. / V:.. or H:.. / N<rate>
+    char temp[12] = "";   // T:..
+    char power[16] = "";  // V:.. or H:.. (throttle flags)
+    char diskIo[24] = ""; // DSK R.. W.. (Io page only)
+    char netIo[24] = "";  // NET R.. T.. [D..]
+    char top1[24] = "";   // busiest process: name, CPU %, RSS (Procs page only)
+    char top2[24] = "";   // second busiest
+    char unit1[24] = "";  // busiest systemd unit: name, CPU %, memory (Units page only)
+    char unit2[24] = "";  // second busiest
+    char cluster[24] = "";  // node count, hottest node, throttled nodes (Cluster page only)
+    uint8_t nodeBars = 0;   // per-node CPU bars, node id order
+    uint8_t nodeCpu[ClusterSummary::kMaxBars] = {};
+    // Sparkline column heights (px, 0 = no data), oldest first
+    uint8_t cpuSpark[kSparkSamples] = {};
+    uint8_t tempSpark[kSparkSamples] = {};
+
+    bool operator==(const ScreenView& o) const;
+    bool operator!=(const ScreenView& o) const { return !(*this == o); }
+};
+
+// `history` (optional) feeds the CPU and temperature sparklines with the
+// 1 s tier ending at `unixSec`.
+// The I/O, process, unit and cluster fields are only filled on their own pages
+// (cluster ones from `cluster`), so changes there don't force redraws of
+// the other pages.
+ScreenView makeScreenView(const Stats& s, Page page, double uvThreshold,
+                          const MetricHistory* history = nullptr, int64_t unixSec = 0,
+                          const ClusterSummary* cluster = nullptr);
+
+// Byte rate in at most four characters: "512", "9.5K", "340K", "1.2M", "12M"
+void formatRate(uint64_t bytesPerSec, char* out, size_t n);
+
+// One loop of ticker text, most important first: "C45% T:54.0C M33 D40 1.5G"
+void formatTicker(const ScreenView& v, char* out, size_t n);
+
+// Portrait (32x128, or 64x128 on 64-row panels) stats screen: IP,
+// frequency, CPU donut, then RAM/disk (Main), temperature/voltage/throttle
+// (Thermal), disk/network throughput (Io), the busiest process (Procs), the
+// cluster's node count and worst temperature (Cluster) or the busiest
+// systemd unit (Units), and
+// CPU/temperature sparklines at the bottom. Clears the canvas. Instantiated for every Panel alias in
+// panel.h. The Stats overload (phaseA = Main, else Thermal) is the bench's.
+template <typename P>
+void renderPortrait(Canvas<P, Rotation::Portrait>& canvas, const ScreenView& v);
+void renderPortrait(PortraitCanvas& canvas, const Stats& s, bool phaseA, double uvThreshold);
+
+// Both screens draw a boxed STALL overlay over the lower section while
+// ScreenView::stall is non-zero.
+//
+// Landscape (128x32 / 128x64) stats screen: text rows with bars for CPU,
+// RAM and disk (Main), temperature/voltage and sparklines (Thermal),
+// disk/network throughput (Io), the two busiest processes (Procs), a
+// cluster summary over per-node CPU bars (Cluster) or the two busiest
+// systemd units (Units); 64-row panels show
+// bars, temperature and sparklines at once and swap the sparklines for the
+// page's rows on the other pages.
+template <typename P>
+void renderLandscape(Canvas<P, Rotation::Landscape>& canvas, const ScreenView& v);
+
+// Pieces shared by the built-in screens and widget layouts (widgets.h)
+
+// CPU donut for 32- and 64-wide portrait canvases
+extern const gauge::RingLut<15, 12> kCpuRing;
+extern const gauge::RingLut<20, 16> kCpuRingWide;
+
+// Column graph of ScreenView::kSparkSamples samples with its bottom at
+// y + kSparkHeight * ys; each sample is xs pixels wide, heights scale by ys
+template <typename Cv>
+void drawSparkline(Cv& canvas, int x, int y, const uint8_t* heights, int xs, int ys) {
+    for (int i = 0; i < ScreenView::kSparkSamples; ++i) {
+        int h = heights[i] * ys;
+        if (h) canvas.fillRect(x + i * xs, y + ScreenView::kSparkHeight * ys - h, xs, h);
+    }
+}
+
+// One CPU column per cluster node in a w x h box, each w / kMaxBars wide
+// with a gap; any node shows at least one pixel row
+template <typename Cv>
+void drawNodeBars(Cv& canvas, int x, int y, int w, int h, const uint8_t* cpu, int n) {
+    const int step = w / ClusterSummary::kMaxBars;
+    for (int i = 0; i < n && i < ClusterSummary::kMaxBars; ++i) {
+        int bh = (cpu[i] * h + 50) / 100;
+        if (bh < 1) bh = 1;
+        canvas.fillRect(x + i * step, y + h - bh, step - 1, bh);
+    }
+}
+
+// Framed box cleared to black with "STALL" and the stalled resources. Two
+// lines when the box is narrow (portrait), one otherwise.
+template <typename Cv>
+void drawStallOverlay(Cv& canvas, int y, int h, uint8_t stall) {
+    canvas.fillRect(0, y, Cv::W, h, false);
+    canvas.hline(0, y, Cv::W);
+    canvas.hline(0, y + h - 1, Cv::W);
+    canvas.fillRect(0, y, 1, h);
+    canvas.fillRect(Cv::W - 1, y, 1, h);
+    static const char kShort[PSI_COUNT] = {'C', 'M', 'I'};
+    if (Cv::W < 96) {
+        char which[PSI_COUNT + 1];
+        for (int r = 0; r < PSI_COUNT; ++r) which[r] = (stall >> r) & 1u ? kShort[r] : '.';
+        which[PSI_COUNT] = '\0';
+        canvas.textCentered(y + 3, "STALL");
+        canvas.textCentered(y + h - 10, which);
+        return;
+    }
+    static const char* const kLong[PSI_COUNT] = {" CPU", " MEM", " IO"};
+    char line[24] = "STALL";
+    for (int r = 0; r < PSI_COUNT; ++r) {
+        if ((stall >> r) & 1u) std::strncat(line, kLong[r], sizeof(line) - std::strlen(line) - 1);
+    }
+    canvas.textCentered(y + (h - 7) / 2, line);
+}
+
+// The ticker band is the panel's last page, the only part its hardware
+// scroll moves: the bottom 8 rows in landscape, the leftmost 8 columns in
+// portrait (where the scroll runs along the long side, so characters stack
+// one per 8 rows). Clears the band and writes as much of `text` as fits.
+template <typename Cv>
+void drawTickerBand(Cv& canvas, const char* text) {
+    if constexpr (Cv::W < Cv::H) {
+        canvas.fillRect(0, 0, 8, Cv::H, false);
+        char c[2] = {};
+        for (int i = 0; i < Cv::H / 8 && text[i]; ++i) {
+            c[0] = text[i];
+            canvas.text(1, i * 8, c);
+        }
+    } else {
+        char line[Cv::W / 6 + 1];
+        std::snprintf(line, sizeof(line), "%s", text);
+        canvas.fillRect(0, Cv::H - 8, Cv::W, 8, false);
+        canvas.text(0, Cv::H - 8, line);
+    }
+}
+
+// Warning triangle, 11 x 7 with its top-left corner at (x, y)
+template <typename Cv>
+void drawWarnIcon(Cv& canvas, int x, int y) {
+    for (int dx = 0; dx < 11; ++dx) canvas.fillRect(x + dx, y, 1, dx / 2 + 1);
+    canvas.setPixel(x + 5, y + 2);
+    canvas.setPixel(x + 5, y + 4);
+    canvas.setPixel(x + 5, y + 6);
+}
+
+enum class LayoutKind { Portrait, Landscape };
@@ -1,178 +1,149 @@
 #include "ssd1306.h"
 #include "stats.h"
-#include <chrono>
-#include <thread>
+#include "collector.h"
+#include "layout.h"
+#include "display_set.h"
+#include "metrics.h"
+#include "event_loop.h"
+#include "exporter.h"
+#include "history.h"
+#include "cluster.h"
+#include "panel_fx.h"
+#include "psi.h"
+#include "trace.h"
+#include "widgets.h"
+#include <cstdarg>
 #include <cstdio>
 #include <csignal>
-#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <sys/epoll.h>
 
-// Bring font locally for portrait text drawing
-static const uint8_t font5x7_portrait[] = {
-#include "tiny5x7.inc"
+// Render-loop stage latencies (us). Jitter is how late each frame woke up
+// relative to its absolute deadline.
+struct LoopMetrics {
+    LatencyHistogram render, flush, jitter;
+    uint64_t overruns = 0; // deadlines missed or frames whose work exceeded the period
+    uint64_t drawn = 0, skipped = 0;
 };
 
-static bool running = true;
-void onSig(int){ running = false; }
+// Frame interval policy. Fast while something is near a threshold (or just
+// crossed one), slow once the screen has been static for a while.
+struct RefreshPolicy {
+    uint32_t baseMs = 1000, fastMs = 250, idleMs = 2000;
+    int idleAfter = 5;          // unchanged frames before slowing down
+    uint32_t fastHoldMs = 10000; // stay fast this long after a crossing
+    int cpuAlert = 90;
+    double tempAlert = 80.0;
+};
 
-static inline void setPortraitPixel(SSD1306& oled, int xp, int yp, bool on) {
-    // Portrait buffer is 32x128; rotate CCW into 128x32 device buffer
-    // Mapping: xd = yp, yd = 31 - xp
-    int xd = yp;
-    int yd = 31 - xp;
-    oled.setPixel(xd, yd, on);
+// Above any alert threshold; a change of this bit is a "crossing"
+static bool alerting(const Stats& s, const RefreshPolicy& p, double uvThreshold) {
+    bool low = s.has(SRC_VOLTAGE) && s.voltage_v > 0.0 && s.voltage_v < uvThreshold;
+    bool hot = s.has(SRC_TEMP) && s.cpu_temp_c >= p.tempAlert;
+    return s.cpu_percent >= p.cpuAlert || s.throttled || low || hot;
 }
 
-static void drawHLinePortrait(SSD1306& oled, int x, int y, int w, bool on=true) {
-    for (int i = 0; i < w; ++i) setPortraitPixel(oled, x + i, y, on);
-}
+// Appends to one of the log line's list fields. Once the buffer is full the
+// entry is cut short and later ones are dropped, never written past the end.
+struct LogList {
+    char* p;
+    size_t cap, len = 0;
 
-static void drawTextPortrait(SSD1306& oled, int x, int y, const std::string& text) {
-    for (char ch : text) {
-        uint8_t c = static_cast<uint8_t>(ch);
-        if (c < 32 || c > 127) c = '?';
-        const uint8_t* glyph = &font5x7_portrait[(c - 32) * 5];
-        for (int col = 0; col < 5; ++col) {
-            uint8_t bits = glyph[col];
-            for (int row = 0; row < 7; ++row) {
-                bool on = bits & (1u << row);
-                setPortraitPixel(oled, x + col, y + row, on);
-            }
-        }
-        x += 6; // 5 + 1 spacing
+    void add(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (len >= cap) return;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = std::vsnprintf(p + len, cap - len, fmt, ap);
+        va_end(ap);
+        len = (n < 0 || static_cast<size_t>(n) >= cap - len) ? cap : len + static_cast<size_t>(n);
     }
-}
+};
 
-static void drawCenteredTextPortrait(SSD1306& oled, int y, const std::string& text) {
-    int w = static_cast<int>(text.size()) * 6; // approx
-    int x = (32 - w) / 2;
-    if (x < 0) x = 0;
-    drawTextPortrait(oled, x, y, text);
+static int64_t unixSeconds() {
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec);
 }
 
-// --- Scaled text (integer scaling of 5x7 font) to fit width 32 ---
-static void drawScaledTextPortrait(SSD1306& oled, int x, int y, const std::string& text, int scale) {
-    if (scale < 1) scale = 1; if (scale > 6) scale = 6;
-    for (char ch : text) {
-        uint8_t c = static_cast<uint8_t>(ch);
-        if (c < 32 || c > 127) c = '?';
-        const uint8_t* glyph = &font5x7_portrait[(c - 32) * 5];
-        for (int col = 0; col < 5; ++col) {
-            uint8_t bits = glyph[col];
-            for (int row = 0; row < 7; ++row) {
-                if (bits & (1u << row)) {
-                    // scale block
-                    for (int dx = 0; dx < scale; ++dx)
-                        for (int dy = 0; dy < scale; ++dy)
-                            setPortraitPixel(oled, x + col*scale + dx, y + row*scale + dy, true);
-                }
-            }
-        }
-        x += 5 * scale + scale; // glyph width + spacing
+static uint32_t envMs(const char* name, uint32_t def) {
+    if (const char* env = std::getenv(name)) {
+        long v = std::atol(env);
+        if (v >= 50 && v <= 60000) return static_cast<uint32_t>(v);
     }
+    return def;
 }
 
-static void drawScaledTextPortraitCentered(SSD1306& oled, int y, const std::string& text) {
-    if (text.empty()) return;
-    // Base width without final trailing space: n*5 + (n-1)*1 = n*6 -1
-    int baseW = static_cast<int>(text.size()) * 6 - 1;
-    if (baseW <= 0) baseW = static_cast<int>(text.size()) * 6;
-    int chosenScale = 1;
-    for (int scale = 6; scale >= 1; --scale) { // try largest down to 1
-        if (baseW * scale <= 32) { chosenScale = scale; break; }
+static void dumpHistograms(LoopMetrics& lm, BackgroundCollector& collector, const DisplaySet& displays) {
+    collector.passLatency().dump(stdout, "collect");
+    for (int i = 0; i < METRIC_COUNT; ++i) {
+        char name[24];
+        std::snprintf(name, sizeof(name), "collect.%s", metricName(static_cast<Metric>(i)));
+        collector.sampleLatency(static_cast<Metric>(i)).dump(stdout, name);
     }
-    int scaledW = baseW * chosenScale;
-    int x = (32 - scaledW) / 2;
-    if (x < 0) x = 0;
-    drawScaledTextPortrait(oled, x, y, text, chosenScale);
+    lm.render.dump(stdout, "render");
+    lm.flush.dump(stdout, "flush");
+    lm.jitter.dump(stdout, "jitter");
+    displays.dump(stdout);
+    const I2CTransport::Counters tc = displays.totals();
+    printf("i2c flushes=%llu syscalls=%llu bytes=%llu errors=%llu retries=%llu fallbacks=%llu max_flush_us=%u overruns=%llu\n",
+           static_cast<unsigned long long>(tc.flushes), static_cast<unsigned long long>(tc.syscalls),
+           static_cast<unsigned long long>(tc.bytes), static_cast<unsigned long long>(tc.errors),
+           static_cast<unsigned long long>(tc.retries), static_cast<unsigned long long>(tc.fallbacks),
+           tc.maxFlushUs, static_cast<unsigned long long>(lm.overruns));
+    fflush(stdout);
 }
 
-// Stretched (non-integer) scaling to occupy full 32px width and desired height (up to 28 rows area)
-// Uniform (proportional) scaling: attempt to fill width=32; height scales by same factor.
-// If resulting height exceeds available space, scale is reduced uniformly.
-static void drawIPProportional(SSD1306& oled, const std::string& text, int topY, int heightAvail) {
-    if (text.empty()) return;
-    if (heightAvail < 7) heightAvail = 7;
-    struct Cache {
-        std::string lastText;
-        int srcCols = 0;
-        std::vector<uint8_t> cols; // glyph columns
-    };
-    static Cache cache;
-
-    if (cache.lastText != text) {
-        cache.lastText = text;
-        int n = static_cast<int>(text.size());
-        cache.srcCols = n * 5 + (n - 1);
-        cache.cols.clear();
-        if (cache.srcCols <= 0) return;
-        cache.cols.resize(cache.srcCols, 0);
-        int writeCol = 0;
-        for (int i = 0; i < n; ++i) {
-            uint8_t c = static_cast<uint8_t>(text[i]);
-            if (c < 32 || c > 127) c = '?';
-            const uint8_t* glyph = &font5x7_portrait[(c - 32) * 5];
-            for (int gc = 0; gc < 5; ++gc) cache.cols[writeCol++] = glyph[gc];
-            if (i != n - 1) cache.cols[writeCol++] = 0x00;
-        }
+int main(int argc, char** argv) {
+    // --record FILE appends every published sample to a trace; --replay FILE
+    // publishes a trace instead of sampling, at its recorded pace or, with
+    // --fast, one sample per frame as fast as the displays take them
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    bool fastReplay = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) recordPath = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replayPath = argv[++i];
+        else if (std::strcmp(argv[i], "--fast") == 0) fastReplay = true;
     }
-    if (cache.srcCols <= 0) return;
-
-    // Desired scale to fill width
-    float scale = 32.0f / cache.srcCols;
-    float maxScaleHeight = static_cast<float>(heightAvail) / 7.0f;
-    if (scale > maxScaleHeight) scale = maxScaleHeight; // constrain by height
-
-    int outW = static_cast<int>(std::round(cache.srcCols * scale));
-    if (outW <= 0) return;
-    int outH = static_cast<int>(std::round(7 * scale));
-    if (outH < 1) outH = 1;
-    if (outW > 32) outW = 32;
-    if (outH > heightAvail) outH = heightAvail;
-
-    int startX = (32 - outW) / 2; if (startX < 0) startX = 0;
-    int startY = topY + (heightAvail - outH) / 2; if (startY < topY) startY = topY;
-
-    for (int dx = 0; dx < outW; ++dx) {
-        float srcXf = (dx + 0.5f) / scale; // back to source col
-        int sx = static_cast<int>(srcXf);
-        if (sx < 0) sx = 0; if (sx >= cache.srcCols) sx = cache.srcCols - 1;
-        uint8_t colBits = cache.cols[sx];
-        for (int dy = 0; dy < outH; ++dy) {
-            float srcYf = (dy + 0.5f) / scale; // back to source row (0..7)
-            int sy = static_cast<int>(srcYf);
-            if (sy < 0) sy = 0; if (sy > 6) sy = 6;
-            if (colBits & (1u << sy)) setPortraitPixel(oled, startX + dx, startY + dy, true);
+    const bool replay = replayPath != nullptr;
+    TraceReader replayTrace;
+    TraceWriter recordTrace;
+    {
+        std::string err;
+        if (replay && !replayTrace.open(replayPath, err)) {
+            fprintf(stderr, "replay: %s\n", err.c_str());
+            return 1;
         }
-    }
-}
-
-static void drawDonutPortrait(SSD1306& oled, int cx, int cy, int rOuter, int rInner, int percent) {
-    if (percent < 0) percent = 0; if (percent > 100) percent = 100;
-    float maxDeg = 360.0f * (percent / 100.0f);
-    int rO2 = rOuter * rOuter;
-    int rI2 = rInner * rInner;
-    for (int y = cy - rOuter; y <= cy + rOuter; ++y) {
-        for (int x = cx - rOuter; x <= cx + rOuter; ++x) {
-            int dx = x - cx;
-            int dy = y - cy;
-            int r2 = dx*dx + dy*dy;
-            if (r2 > rO2 || r2 < rI2) continue;
-            float ang = std::atan2(static_cast<float>(dy), static_cast<float>(dx)) * 180.0f / 3.14159265f;
-            if (ang < 0) ang += 360.0f;
-            if (ang <= maxDeg) setPortraitPixel(oled, x, y, true);
+        if (!replay && recordPath && !recordTrace.open(recordPath, err)) {
+            fprintf(stderr, "record: %s\n", err.c_str());
+            return 1;
         }
     }
-}
 
-int main() {
-    std::signal(SIGINT, onSig);
-    std::signal(SIGTERM, onSig);
+    // Before any thread exists, so the collector inherits the blocked mask
+    SignalFd signals({SIGINT, SIGTERM, SIGUSR1});
 
-    SSD1306 oled("/dev/i2c-1", 0x3C);
-    if (!oled.init()) return 1;
+    size_t maxXfer = I2CTransport::kDefaultMaxTransfer;
+    if (const char* envX = std::getenv("RPI_STATS_I2C_MAX_XFER")) {
+        long v = std::atol(envX);
+        if (v >= 2 && v <= static_cast<long>(I2CTransport::kMaxTransfer)) maxXfer = static_cast<size_t>(v);
+    }
+    // Widget layouts for some canvas sizes, and the page rotation
+    LayoutFile layouts;
+    if (const char* envL = std::getenv("RPI_STATS_LAYOUT")) {
+        std::string err;
+        if (*envL && !loadLayoutFile(envL, layouts, err)) {
+            fprintf(stderr, "layout: %s\n", err.c_str());
+            return 1;
+        }
+    }
+    LoopMetrics lm;
+    DisplaySet displays;
+    if (!displays.open(std::getenv("RPI_STATS_DISPLAY"), maxXfer, lm.flush, &layouts)) return 1;
 
-    int counter = 0;
     // --- Logging & thresholds from environment ---
     int logInterval = 30; // seconds
     if (const char* envLi = std::getenv("RPI_STATS_LOG_INTERVAL")) {
@@ -184,102 +155,411 @@ int main() {
         double vv = std::atof(envUv);
         if (vv > 0.5 && vv < 2.0) uvThreshold = vv;
     }
-    auto lastLog = std::chrono::steady_clock::now();
+    RefreshPolicy policy;
+    policy.baseMs = envMs("RPI_STATS_REFRESH_MS", policy.baseMs);
+    policy.fastMs = envMs("RPI_STATS_FAST_MS", policy.fastMs);
+    policy.idleMs = envMs("RPI_STATS_IDLE_MS", policy.idleMs);
+    if (policy.fastMs > policy.baseMs) policy.fastMs = policy.baseMs;
+    if (policy.idleMs < policy.baseMs) policy.idleMs = policy.baseMs;
 
-    while (running) {
-        auto s = collectStats();
-        oled.clear();
-
-        // 1) IP (proportional scaling) in reserved top area
-        int ipAreaHeight = 26; // reserved vertical space
-        drawIPProportional(oled, s.ip_last_octet, 0, ipAreaHeight);
-
-        // 2) Divider
-        drawHLinePortrait(oled, 0, ipAreaHeight, 32);
-
-        // 3) CPU freq (F:xx.xG)
-        double freqVal = 0.0;
-        try {
-            if (!s.cpu_freq.empty()) {
-                size_t posG = s.cpu_freq.find('G');
-                std::string num = s.cpu_freq.substr(0, posG);
-                freqVal = std::stod(num);
+    // Controller-side effects: one while an alert is up, one once the
+    // screen has gone idle (until the next frame that changes)
+    PanelFx alertFx = PanelFx::None, idleFx = PanelFx::None;
+    if (const char* envAf = std::getenv("RPI_STATS_ALERT_FX")) {
+        if (!parsePanelFx(envAf, alertFx)) fprintf(stderr, "fx: unknown effect %s\n", envAf);
+    }
+    if (const char* envIf = std::getenv("RPI_STATS_IDLE_FX")) {
+        if (!parsePanelFx(envIf, idleFx)) fprintf(stderr, "fx: unknown effect %s\n", envIf);
+    }
+    const bool fxEnabled = alertFx != PanelFx::None || idleFx != PanelFx::None;
+    uint8_t contrast = kDefaultContrast;
+    if (const char* envC = std::getenv("RPI_STATS_CONTRAST")) {
+        long v = std::strtol(envC, nullptr, 0);
+        if (v >= 0 && v <= 255) contrast = static_cast<uint8_t>(v);
+    }
+    FxAnimator fx(contrast);
+    displays.setFx(fx.rest());
+
+    // History: explicit path, else systemd's StateDirectory, else RAM only.
+    // A replay keeps its own in RAM, fed on the trace's clock.
+    std::string historyPath;
+    if (const char* envH = std::getenv("RPI_STATS_HISTORY")) historyPath = envH;
+    else if (const char* stateDir = std::getenv("STATE_DIRECTORY")) historyPath = std::string(stateDir) + "/history.bin";
+    if (replay) historyPath.clear();
+    MetricHistory history;
+    if (!history.open(historyPath)) return 1;
+    if (!historyPath.empty() && !history.persistent()) fprintf(stderr, "history: cannot map %s, keeping it in memory\n", historyPath.c_str());
+
+    BackgroundCollector collector;
+    collector.configurePeriods(std::getenv("RPI_STATS_PERIODS"));
+    // The process ranking opens one file per process; a scan costing more
+    // than this skips the following ones in proportion
+    uint32_t procBudgetUs = 20000;
+    if (const char* envPb = std::getenv("RPI_STATS_PROC_BUDGET_US")) {
+        long v = std::strtol(envPb, nullptr, 10);
+        if (v >= 0 && v <= 1000000) procBudgetUs = static_cast<uint32_t>(v);
+    }
+    collector.setProcScanBudgetUs(procBudgetUs);
+    // systemd units accounted from their cgroups; RPI_STATS_CGROUP_ROOT
+    // points the sampler at another slice (or a fake tree)
+    const char* unitList = std::getenv("RPI_STATS_UNITS");
+    const bool unitsOn = !replay && unitList && *unitList;
+    if (unitsOn) {
+        const char* envCg = std::getenv("RPI_STATS_CGROUP_ROOT");
+        collector.setUnits(unitList, envCg ? envCg : "");
+    }
+    if (replay) {
+        collector.startReplay(replayTrace, !fastReplay);
+    } else {
+        if (recordPath) collector.record(&recordTrace);
+        collector.start();
+    }
+    displays.start();
+
+    WindowedLatency logCollect(collector.passLatency()), logRender(lm.render),
+        logFlush(lm.flush), logJitter(lm.jitter);
+
+    // --- Cluster mode: send this node's samples, and/or collect other
+    // nodes' for the cluster page ---
+    ClusterSender clusterTx;
+    ClusterReceiver clusterRx;
+    int clusterNode = -1; // ip_last_octet
+    uint32_t clusterIntervalMs = envMs("RPI_STATS_CLUSTER_INTERVAL_MS", 1000);
+    if (const char* envN = std::getenv("RPI_STATS_CLUSTER_NODE")) {
+        long v = std::atol(envN);
+        if (v >= 0 && v <= 255) clusterNode = static_cast<int>(v);
+    }
+    if (const char* envS = std::getenv("RPI_STATS_CLUSTER_SEND")) {
+        sockaddr_in to{};
+        if (!cluster::parseAddress(envS, false, to) || !clusterTx.open(to)) fprintf(stderr, "cluster: cannot send to %s\n", envS);
+    }
+    if (const char* envR = std::getenv("RPI_STATS_CLUSTER_LISTEN")) {
+        sockaddr_in at{};
+        if (!cluster::parseAddress(envR, true, at) || !clusterRx.open(at)) fprintf(stderr, "cluster: cannot listen on %s\n", envR);
+    }
+
+    // Pages of the lower section rotate on wall time, independent of
+    // how often frames are drawn. The cluster page needs a listener, the
+    // units page a list of units.
+    PageRotator rotator = layouts.rotator;
+    if (clusterRx.fd() < 0) rotator.drop(Page::Cluster);
+    if (!unitsOn) rotator.drop(Page::Units);
+    const uint64_t startNs = monotonicNs();
+
+    bool haveShown = false;
+    Page shownPage = Page::Main;
+    uint32_t shownVersion = 0;
+    bool retry = false; // some display was still flushing last frame
+    bool wasAlerting = false;
+    uint64_t fastUntilNs = 0;
+    int unchanged = 0;
+    // The effect for the current alert state after this many unchanged frames
+    auto effectFor = [&](int unchangedFrames) {
+        return wasAlerting ? alertFx : (unchangedFrames >= policy.idleAfter ? idleFx : PanelFx::None);
+    };
+    uint32_t periodMs = policy.baseMs;
+    bool running = true;
+    bool historyChanged = false;
+    bool clusterChanged = false;
+    // A fired PSI trigger keeps its overlay up this long after the last event
+    constexpr uint64_t kStallHoldNs = 5000ull * 1000000ull;
+    uint64_t stallUntilNs[PSI_COUNT] = {};
+    uint8_t shownStall = 0;
+    int64_t replayStartMs = 0; // unix_ms of the first replayed sample
+    uint64_t replaySamples = 0;
+
+    EventLoop loop;
+    FrameTimer frameTimer, logTimer, historyTimer, clusterTimer, fxTimer;
+
+    loop.add(signals.fd(), EPOLLIN, [&](uint32_t) {
+        while (int sig = signals.read()) {
+            if (sig == SIGUSR1) dumpHistograms(lm, collector, displays);
+            else running = false;
+        }
+    });
+
+    loop.add(frameTimer.fd(), EPOLLIN, [&](uint32_t) {
+        uint64_t wakeNs = monotonicNs();
+        uint64_t deadline = frameTimer.deadlineNs();
+        lm.jitter.record(wakeNs > deadline ? (wakeNs - deadline) / 1000 : 0);
+
+        // A replay runs pages and sparklines on the trace's clock, so every
+        // run draws the same frames
+        int64_t replayMs = 0;
+        if (replay) {
+            if (fastReplay && !retry && !collector.replayStep()) {
+                running = false;
+                return;
             }
-        } catch (...) { freqVal = 0.0; }
-        char freqBuf[12];
-        std::snprintf(freqBuf, sizeof(freqBuf), "%.1fG", freqVal);
-        drawCenteredTextPortrait(oled, ipAreaHeight + 4, freqBuf);
-
-        // 4) CPU donut + percent
-        int cx = 16, cy = 64;
-        drawDonutPortrait(oled, cx, cy, 15, 12, s.cpu_percent);
-        char pct[8];
-        std::snprintf(pct, sizeof(pct), "%d%%", s.cpu_percent);
-        drawCenteredTextPortrait(oled, 58, pct);
-
-        // 5) Lower section (alternate sets)
-        bool phaseA = ((counter / 6) % 2 == 0);
-
-        double volts = 0.0; bool haveV = false;
-        try { if (!s.voltage.empty() && s.voltage[0] != 'N') { volts = std::stod(s.voltage); haveV = true; } } catch (...) { volts = 0.0; }
-        char voltBuf[10];
-        if (haveV) std::snprintf(voltBuf, sizeof(voltBuf), "V:%.1f", volts);
-        else std::snprintf(voltBuf, sizeof(voltBuf), "V:NA");
-
-        if (phaseA) {
-            char ramLine[12]; std::snprintf(ramLine, sizeof(ramLine), "R:%d%%", s.mem_percent);
-            drawCenteredTextPortrait(oled, 86, ramLine);
-            char diskLine[12]; std::snprintf(diskLine, sizeof(diskLine), "D:%d%%", s.disk_percent);
-            bool low = haveV && volts < uvThreshold && volts > 0.0;
-            if (low || s.throttled) {
-                int baseY = 101;
-                for (int dx = 0; dx < 11; ++dx) {
-                    int height = dx / 2 + 1;
-                    for (int dy = 0; dy < height; ++dy) setPortraitPixel(oled, 2 + dx, baseY + dy, true);
-                }
-                setPortraitPixel(oled, 7, baseY + 2, true);
-                setPortraitPixel(oled, 7, baseY + 4, true);
-                setPortraitPixel(oled, 7, baseY + 6, true);
+            replayMs = collector.latest().unix_ms;
+            if (replayMs && !replayStartMs) replayStartMs = replayMs;
+        }
+        Page page = rotator.at(replay ? static_cast<uint64_t>(replayMs - replayStartMs) * 1000000ull : wakeNs - startNs);
+        uint32_t version = collector.version();
+        uint8_t stall = 0;
+        for (int r = 0; r < PSI_COUNT; ++r) {
+            if (wakeNs < stallUntilNs[r]) stall = static_cast<uint8_t>(stall | (1u << r));
+        }
+        bool changed = false;
+        if (!haveShown || version != shownVersion || page != shownPage || stall != shownStall ||
+            historyChanged || (clusterChanged && page == Page::Cluster) || retry) {
+            historyChanged = false;
+            clusterChanged = false;
+            const StatsSnapshot snap = collector.latest();
+            if (replay && version != shownVersion) {
+                history.append(snap.unix_ms / 1000, snap.stats);
+                ++replaySamples;
+            }
+            shownVersion = version;
+
+            bool alert = alerting(snap.stats, policy, uvThreshold) || stall;
+            if (alert || alert != wasAlerting) fastUntilNs = wakeNs + policy.fastHoldMs * 1000000ull;
+            wasAlerting = alert;
+
+            const ClusterSummary nodes = clusterRx.summary(wakeNs);
+            ScreenView view = makeScreenView(snap.stats, page, uvThreshold, &history,
+                                             replay ? snap.unix_ms / 1000 : unixSeconds(), &nodes);
+            view.stall = stall;
+            // Each display renders only if its own framebuffer is stale and
+            // hands the flush to its bus thread, together with the effect
+            // state that holds once the frame counts as a change (so leaving
+            // the idle ticker costs one frame, not a frame plus a redraw)
+            FxAnimator next = fx;
+            PanelFx frameFx = effectFor(0);
+            if (frameFx != next.active()) {
+                if (frameFx == PanelFx::None) next.stop();
+                else next.start(frameFx, wakeNs);
             }
-            drawCenteredTextPortrait(oled, 101, diskLine);
+            DisplaySet::Update u = displays.update(view, next.state(wakeNs), lm.render);
+            retry = u.deferred > 0;
+            changed = u.changed > 0;
+            shownPage = page;
+            shownStall = stall;
+            haveShown = true;
+        }
+        if (changed) {
+            ++lm.drawn;
+            unchanged = 0;
         } else {
-            double tempVal = 0.0; bool haveT = false;
-            try {
-                if (!s.cpu_temp.empty() && s.cpu_temp[0] != 'N') {
-                    std::string num; num.reserve(6);
-                    for (char c : s.cpu_temp) {
-                        if ((c >= '0' && c <= '9') || c == '.') num.push_back(c); else break;
-                    }
-                    if (!num.empty()) { tempVal = std::stod(num); haveT = true; }
-                }
-            } catch (...) { haveT = false; }
-            char tBuf[12];
-            if (haveT) std::snprintf(tBuf, sizeof(tBuf), "T:%.1fC", tempVal);
-            else std::snprintf(tBuf, sizeof(tBuf), "T:NA");
-            drawCenteredTextPortrait(oled, 86, tBuf);
-
-            if (s.throttled) {
-                char thr[16]; std::snprintf(thr, sizeof(thr), "H:%X", s.throttle_raw);
-                drawCenteredTextPortrait(oled, 101, thr);
-            } else {
-                drawCenteredTextPortrait(oled, 101, voltBuf);
+            ++lm.skipped;
+            ++unchanged;
+        }
+        PanelFx wantFx = effectFor(unchanged);
+        if (wantFx != fx.active()) {
+            if (wantFx == PanelFx::None) fx.stop();
+            else fx.start(wantFx, wakeNs);
+            displays.setFx(fx.state(wakeNs));
+            if (fx.stepMs()) fxTimer.fireNow();
+        }
+
+        if (replay && collector.replayDone() && !retry && collector.version() == shownVersion) {
+            running = false;
+            return;
+        }
+        if (fastReplay) {
+            // Next sample straight away; a bus still flushing gets 1 ms
+            frameTimer.advance(1);
+            if (!retry) frameTimer.fireNow();
+            return;
+        }
+        if (wakeNs < fastUntilNs) periodMs = policy.fastMs;
+        else if (unchanged >= policy.idleAfter) periodMs = policy.idleMs;
+        else periodMs = policy.baseMs;
+
+        lm.overruns += frameTimer.advance(periodMs);
+    });
+
+    // --- 1 Hz history append (also moves the sparklines) ---
+    loop.add(historyTimer.fd(), EPOLLIN, [&](uint32_t) {
+        historyTimer.advance(1000);
+        if (replay) return; // appended per replayed sample
+        history.append(unixSeconds(), collector.latest().stats);
+        historyChanged = true;
+    });
+
+    // --- PSI triggers: redraw with the overlay as soon as the kernel reports
+    // a stall, instead of on the next poll ---
+    PsiMonitor psi;
+    uint32_t psiWindowMs = 1000;
+    if (const char* envW = std::getenv("RPI_STATS_PSI_WINDOW_MS")) {
+        long v = std::atol(envW);
+        if (v >= 500 && v <= 10000) psiWindowMs = static_cast<uint32_t>(v);
+    }
+    // Live stalls have nothing to do with a replayed trace
+    if (!replay) psi.open(std::getenv("RPI_STATS_PSI"), psiWindowMs);
+    for (int r = 0; r < PSI_COUNT; ++r) {
+        PsiResource res = static_cast<PsiResource>(r);
+        if (psi.fd(res) < 0) continue;
+        loop.add(psi.fd(res), EPOLLPRI, [&, res](uint32_t events) {
+            if (events & EPOLLERR) {
+                fprintf(stderr, "psi: %s trigger closed\n", psiResourceName(res));
+                loop.remove(psi.fd(res));
+                psi.close(res);
+                return;
+            }
+            uint64_t now = monotonicNs();
+            bool fresh = now >= stallUntilNs[res];
+            stallUntilNs[res] = now + kStallHoldNs;
+            if (fresh) {
+                const PsiAverages& a = collector.latest().stats.psi[res];
+                printf("psi: %s stall over %ums in %ums window (some avg10=%.2f avg60=%.2f)\n",
+                       psiResourceName(res), psi.stallMs(res), psi.windowMs(), static_cast<double>(a.some_avg10),
+                       static_cast<double>(a.some_avg60));
+                fflush(stdout);
+                frameTimer.fireNow();
             }
+        });
+    }
+
+    // --- Effect steps (blink phases, fade levels) between frames: a few
+    // command bytes each, no pixel data ---
+    if (fxEnabled) {
+        loop.add(fxTimer.fd(), EPOLLIN, [&](uint32_t) {
+            const uint32_t step = fx.stepMs();
+            fxTimer.advance(step ? step : 60000);
+            if (step) displays.setFx(fx.state(monotonicNs()));
+        });
+    }
+
+    if (clusterRx.fd() >= 0) {
+        loop.add(clusterRx.fd(), EPOLLIN, [&](uint32_t) {
+            if (clusterRx.onReadable(monotonicNs()) > 0) clusterChanged = true;
+        });
+    }
+    if (clusterTx.isOpen()) {
+        loop.add(clusterTimer.fd(), EPOLLIN, [&](uint32_t) {
+            clusterTimer.advance(clusterIntervalMs);
+            clusterTx.send(collector.latest().stats, clusterNode);
+        });
+    }
+
+    // --- OpenMetrics endpoint (optional) ---
+    MetricsExporter exporter(collector, loop);
+    if (const char* envSock = std::getenv("RPI_STATS_METRICS_SOCKET")) {
+        if (*envSock && !exporter.listenUnix(envSock)) fprintf(stderr, "metrics: cannot listen on %s\n", envSock);
+    }
+    if (const char* envPort = std::getenv("RPI_STATS_METRICS_PORT")) {
+        long port = std::atol(envPort);
+        if (port > 0 && port < 65536) {
+            if (!exporter.listenTcp(static_cast<uint16_t>(port))) fprintf(stderr, "metrics: cannot listen on 127.0.0.1:%ld\n", port);
         }
+    }
 
-        // --- Periodic log line for journalctl ---
-        auto now = std::chrono::steady_clock::now();
-        if (std::chrono::duration_cast<std::chrono::seconds>(now - lastLog).count() >= logInterval) {
-            printf("stats ip=%s cpu=%d ram=%d disk=%d freq=%s temp=%s volt=%s thr=0x%X\n",
-                   s.ip_last_octet.c_str(), s.cpu_percent, s.mem_percent, s.disk_percent,
-                   s.cpu_freq.c_str(), s.cpu_temp.c_str(), s.voltage.c_str(), s.throttle_raw);
-            fflush(stdout);
-            lastLog = now;
+    // --- Periodic log line for journalctl, on its own deadline ---
+    loop.add(logTimer.fd(), EPOLLIN, [&](uint32_t) {
+        logTimer.advance(static_cast<uint32_t>(logInterval) * 1000u);
+        const StatsSnapshot snap = collector.latest();
+        const Stats& s = snap.stats;
+        char freqStr[16], tempStr[16], voltStr[16];
+        formatCpuFreq(s, freqStr, sizeof(freqStr));
+        formatCpuTemp(s, tempStr, sizeof(tempStr));
+        formatVoltage(s, voltStr, sizeof(voltStr));
+        char ages[METRIC_COUNT * 16] = "";
+        uint64_t nowNs = BackgroundCollector::nowNs();
+        for (int i = 0, off = 0; i < METRIC_COUNT; ++i) {
+            Metric mt = static_cast<Metric>(i);
+            off += std::snprintf(ages + off, sizeof(ages) - static_cast<size_t>(off), i ? ",%s:%u" : "%s:%u",
+                                 metricName(mt), snap.ageMs(mt, nowNs));
+        }
+        char cores[CpuSampler::kMaxCores * 4 + 1] = "-";
+        for (int i = 0, off = 0; i < s.cpu_core_count; ++i) {
+            off += std::snprintf(cores + off, sizeof(cores) - static_cast<size_t>(off), i ? "/%d" : "%d",
+                                 s.cpu_core_percent[i]);
+        }
+        char lat[160];
+        int off = logCollect.format(lat, sizeof(lat), "collect");
+        off += logRender.format(lat + off, sizeof(lat) - static_cast<size_t>(off), ",render");
+        off += logFlush.format(lat + off, sizeof(lat) - static_cast<size_t>(off), ",flush");
+        logJitter.format(lat + off, sizeof(lat) - static_cast<size_t>(off), ",jitter");
+        char diskIo[DiskStatsSampler::kMaxDevices * 48] = "-";
+        LogList dl{diskIo, sizeof(diskIo)};
+        for (int i = 0; i < s.disk_io_count; ++i) {
+            const DiskRate& d = s.disk_io[i];
+            dl.add(i ? ";%s:%llu/%llu/%u/%u" : "%s:%llu/%llu/%u/%u", d.name,
+                   static_cast<unsigned long long>(d.read_bps / 1024),
+                   static_cast<unsigned long long>(d.write_bps / 1024), d.read_iops, d.write_iops);
         }
+        char netIo[NetDevSampler::kMaxInterfaces * 48] = "-";
+        LogList nl{netIo, sizeof(netIo)};
+        for (int i = 0; i < s.net_count; ++i) {
+            const NetRate& n = s.net[i];
+            nl.add(i ? ";%s:%llu/%llu/%u/%u" : "%s:%llu/%llu/%u/%u", n.name,
+                   static_cast<unsigned long long>(n.rx_bps / 1024),
+                   static_cast<unsigned long long>(n.tx_bps / 1024), n.rx_drops, n.tx_drops);
+        }
+        char psiStr[PSI_COUNT * 32] = "-";
+        if (s.has(SRC_PSI)) {
+            for (int r = 0, off = 0; r < PSI_COUNT; ++r) {
+                off += std::snprintf(psiStr + off, sizeof(psiStr) - static_cast<size_t>(off),
+                                     r ? ",%s:%.2f/%.2f" : "%s:%.2f/%.2f", psiResourceName(static_cast<PsiResource>(r)),
+                                     static_cast<double>(s.psi[r].some_avg10), static_cast<double>(s.psi[r].some_avg60));
+            }
+        }
+        char topCpu[ProcessSampler::kTopN * 32] = "-", topRss[ProcessSampler::kTopN * 32] = "-";
+        LogList cl{topCpu, sizeof(topCpu)}, rl{topRss, sizeof(topRss)};
+        for (int i = 0; i < s.top_count; ++i) {
+            const ProcessUsage& c = s.top_cpu[i];
+            const ProcessUsage& r = s.top_rss[i];
+            cl.add(i ? ";%s/%d:%.1f" : "%s/%d:%.1f", c.name, c.pid, static_cast<double>(c.cpu_percent));
+            rl.add(i ? ";%s/%d:%llu" : "%s/%d:%llu", r.name, r.pid, static_cast<unsigned long long>(r.rss_kb / 1024));
+        }
+        char unitStr[CgroupSampler::kTopN * 48] = "-";
+        LogList ul{unitStr, sizeof(unitStr)};
+        for (int i = 0; unitsOn && i < s.unit_top_count; ++i) {
+            const UnitUsage& u = s.units[i];
+            ul.add(i ? ";%s:%.1f/%llu/%llu/%llu/%.2f" : "%s:%.1f/%llu/%llu/%llu/%.2f", u.name,
+                   static_cast<double>(u.cpu_percent), static_cast<unsigned long long>(u.mem_kb / 1024),
+                   static_cast<unsigned long long>(u.read_bps / 1024),
+                   static_cast<unsigned long long>(u.write_bps / 1024), static_cast<double>(u.mem_some_avg10));
+        }
+        char clusterStr[64] = "-";
+        if (clusterRx.fd() >= 0) {
+            const ClusterSummary c = clusterRx.summary(nowNs);
+            std::snprintf(clusterStr, sizeof(clusterStr), "%d/%d/%.1f/%llu/%llu", c.nodes, c.throttled,
+                          static_cast<double>(c.worstTemp), static_cast<unsigned long long>(clusterRx.received()),
+                          static_cast<unsigned long long>(clusterRx.rejected()));
+        }
+        const I2CTransport::Counters tc = displays.totals();
+        printf("stats ip=%s cpu=%d ram=%d disk=%d freq=%s temp=%s volt=%s thr=0x%X cores=%s iow=%d steal=%d irq=%d cached=%llukB buffers=%llukB swap=%llukB dirty=%llukB disk_io=%s net=%s psi=%s procs=%d/%uus top_cpu=%s top_rss=%s units=%d:%s cluster=%s fx=%s age_ms=%s lat_us=%s frames=%llu/%llu interval_ms=%u overruns=%llu i2c_err=%llu i2c_retry=%llu\n",
+               s.ip_last_octet, s.cpu_percent, s.mem_percent, s.disk_percent,
+               freqStr, tempStr, voltStr, s.throttle_raw, cores,
+               s.cpu_iowait_percent, s.cpu_steal_percent, s.cpu_irq_percent,
+               static_cast<unsigned long long>(s.mem_cached_kb),
+               static_cast<unsigned long long>(s.mem_buffers_kb),
+               static_cast<unsigned long long>(s.swap_used_kb),
+               static_cast<unsigned long long>(s.mem_dirty_kb), diskIo, netIo, psiStr, s.proc_count, s.proc_scan_us, topCpu, topRss, s.unit_count, unitStr, clusterStr, panelFxName(fx.active()), ages, lat,
+               static_cast<unsigned long long>(lm.drawn), static_cast<unsigned long long>(lm.drawn + lm.skipped),
+               periodMs, static_cast<unsigned long long>(lm.overruns),
+               static_cast<unsigned long long>(tc.errors), static_cast<unsigned long long>(tc.retries));
+        fflush(stdout);
+    });
 
-        oled.display();
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        ++counter;
+    if (!frameTimer.start(1) || !logTimer.start(static_cast<uint32_t>(logInterval) * 1000u) ||
+        !historyTimer.start(1000) || (clusterTx.isOpen() && !clusterTimer.start(clusterIntervalMs)) ||
+        (fxEnabled && !fxTimer.start(60000))) {
+        fprintf(stderr, "timerfd setup failed\n");
+        displays.stop();
+        collector.stop();
+        return 1;
+    }
+    const uint64_t loopStartNs = monotonicNs();
+    while (running) {
+        if (loop.runOnce(-1) < 0) break;
     }
 
+    // Leave the panels steady: stop() still sends queued controller states
+    displays.setFx(fx.rest());
+    displays.stop();
+    collector.stop();
+    if (replay) {
+        double sec = static_cast<double>(monotonicNs() - loopStartNs) / 1e9;
+        printf("replay: shown=%llu records=%zu elapsed_s=%.3f shown_per_s=%.1f frames=%llu\n",
+               static_cast<unsigned long long>(replaySamples), replayTrace.records(), sec,
+               sec > 0 ? static_cast<double>(replaySamples) / sec : 0.0, static_cast<unsigned long long>(lm.drawn));
+        dumpHistograms(lm, collector, displays);
+    } else if (recordPath) {
+        printf("record: records=%llu errors=%llu\n", static_cast<unsigned long long>(recordTrace.records()),
+               static_cast<unsigned long long>(recordTrace.errors()));
+    }
     return 0;
 }
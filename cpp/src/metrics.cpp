@@ -0,0 +1,79 @@
+#include "metrics.h"
+#include <algorithm>
+#include <time.h>
+
+uint64_t monotonicNs() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+int LatencyHistogram::bucketOf(uint64_t us) {
+    if (us < kSub) return static_cast<int>(us);
+    int e = 63 - __builtin_clzll(us); // us in [2^e, 2^(e+1)), e >= 3
+    int sub = static_cast<int>((us >> (e - 3)) & (kSub - 1));
+    int b = kSub + kSub * (e - 3) + sub;
+    return b < kBuckets ? b : kBuckets - 1;
+}
+
+uint64_t LatencyHistogram::bucketUpper(int b) {
+    if (b < kSub) return static_cast<uint64_t>(b);
+    int e = (b - kSub) / kSub + 3;
+    uint64_t sub = static_cast<uint64_t>((b - kSub) % kSub);
+    return (uint64_t{1} << e) + ((sub + 1) << (e - 3)) - 1;
+}
+
+static void raiseMax(std::atomic<uint64_t>& a, uint64_t v) {
+    uint64_t cur = a.load(std::memory_order_relaxed);
+    while (v > cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::record(uint64_t us) {
+    counts_[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    raiseMax(max_, us);
+    raiseMax(windowMax_, us);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot s;
+    for (int b = 0; b < kBuckets; ++b) {
+        s.counts[b] = counts_[b].load(std::memory_order_relaxed);
+        s.total += s.counts[b];
+    }
+    return s;
+}
+
+uint64_t LatencyHistogram::percentile(const Snapshot& now, const Snapshot& before, double q) {
+    uint64_t total = now.total - before.total;
+    if (total == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total) + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += now.counts[b] - before.counts[b];
+        if (seen >= rank) return bucketUpper(b);
+    }
+    return bucketUpper(kBuckets - 1);
+}
+
+void LatencyHistogram::dump(FILE* out, const char* name) const {
+    Snapshot s = snapshot();
+    fprintf(out, "hist %s count=%llu max_us=%llu\n", name, static_cast<unsigned long long>(s.total),
+            static_cast<unsigned long long>(lifetimeMax()));
+    for (int b = 0; b < kBuckets; ++b) {
+        if (s.counts[b] == 0) continue;
+        fprintf(out, "  <=%llu %llu\n", static_cast<unsigned long long>(bucketUpper(b)),
+                static_cast<unsigned long long>(s.counts[b]));
+    }
+}
+
+int WindowedLatency::format(char* out, size_t n, const char* name) {
+    LatencyHistogram::Snapshot now = h_.snapshot();
+    uint64_t max = h_.takeWindowMax();
+    uint64_t p50 = std::min(LatencyHistogram::percentile(now, prev_, 0.50), max);
+    uint64_t p99 = std::min(LatencyHistogram::percentile(now, prev_, 0.99), max);
+    int w = snprintf(out, n, "%s=%llu/%llu/%llu", name, static_cast<unsigned long long>(p50),
+                     static_cast<unsigned long long>(p99), static_cast<unsigned long long>(max));
+    prev_ = now;
+    return w;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+// CLOCK_MONOTONIC in ns
+uint64_t monotonicNs();
+
+// Lock-free latency histogram over microseconds: exact below 8 us, then 8
+// sub-buckets per power of two (<= 12.5% bucket width) up to ~67 s.
+// record() is a handful of relaxed atomic ops, safe from any thread.
+class LatencyHistogram {
+public:
+    static constexpr int kSub = 8;
+    static constexpr int kBuckets = kSub + kSub * 23;
+
+    void record(uint64_t us);
+
+    // Plain copy of the counters, for windowed percentiles
+    struct Snapshot {
+        uint64_t counts[kBuckets] = {};
+        uint64_t total = 0;
+    };
+    Snapshot snapshot() const;
+
+    // Windowed max: returns the largest value since the previous call
+    uint64_t takeWindowMax() { return windowMax_.exchange(0, std::memory_order_relaxed); }
+    uint64_t lifetimeMax() const { return max_.load(std::memory_order_relaxed); }
+
+    static int bucketOf(uint64_t us);
+    // Largest value that falls into bucket b
+    static uint64_t bucketUpper(int b);
+    // Value at quantile q (0..1) of the samples in (now - before): the
+    // upper bound of the bucket holding it
+    static uint64_t percentile(const Snapshot& now, const Snapshot& before, double q);
+
+    // One line per non-empty bucket: "  <upper_us> <count>"
+    void dump(FILE* out, const char* name) const;
+
+private:
+    std::atomic<uint64_t> counts_[kBuckets] = {};
+    std::atomic<uint64_t> max_{0};
+    std::atomic<uint64_t> windowMax_{0};
+};
+
+// Monotonic span timer: `StageTimer t; ...; hist.record(t.elapsedUs());`
+class StageTimer {
+public:
+    StageTimer() : start_(monotonicNs()) {}
+    uint64_t startNs() const { return start_; }
+    uint64_t elapsedUs() const { return (monotonicNs() - start_) / 1000; }
+
+private:
+    uint64_t start_;
+};
+
+// Percentile summary of a histogram over the window since the last call,
+// for the periodic log line.
+class WindowedLatency {
+public:
+    explicit WindowedLatency(LatencyHistogram& h) : h_(h), prev_(h.snapshot()) {}
+    // Writes "name=p50/p99/max" (us) and starts a new window. Percentiles
+    // are bucket upper bounds, capped at the window max.
+    int format(char* out, size_t n, const char* name);
+
+private:
+    LatencyHistogram& h_;
+    LatencyHistogram::Snapshot prev_;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+
+// Controller families driven over the same i2c-dev transport
+enum class Controller {
+    SSD1306, // horizontal addressing mode, 0x21/0x22 column/page windows
+    SH1106,  // page addressing only, 132-column RAM with the glass at 2..129
+};
+
+// Contrast (0x81) the init sequences set
+constexpr uint8_t kDefaultContrast = 0x8F;
+
+// Panel geometry and controller, fixed at compile time. Everything the
+// driver, canvas and layouts derive from the panel (page count, init
+// values, column offset) is a constant of this type.
+template <int W, int H, Controller C>
+struct Panel {
+    static_assert(W == 128, "only 128-column panels are wired up");
+    static_assert(H == 32 || H == 64, "panel height must be 32 or 64");
+
+    static constexpr int WIDTH = W;
+    static constexpr int HEIGHT = H;
+    static constexpr int PAGES = H / 8;
+    static constexpr Controller CONTROLLER = C;
+    static constexpr bool PAGE_ADDRESSING = C == Controller::SH1106;
+    static constexpr int COLUMN_OFFSET = C == Controller::SH1106 ? 2 : 0;
+
+    static constexpr uint8_t MULTIPLEX = static_cast<uint8_t>(H - 1); // 0xA8
+    static constexpr uint8_t COM_PINS = H == 32 ? 0x02 : 0x12;        // 0xDA
+};
+
+using Ssd1306_128x32 = Panel<128, 32, Controller::SSD1306>;
+using Ssd1306_128x64 = Panel<128, 64, Controller::SSD1306>;
+using Sh1106_128x64 = Panel<128, 64, Controller::SH1106>;
+
+// Runtime tag for the panel types above (display configuration)
+enum class PanelKind { Ssd1306_128x32, Ssd1306_128x64, Sh1106_128x64 };
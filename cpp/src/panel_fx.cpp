@@ -0,0 +1,67 @@
+#include "panel_fx.h"
+#include <cstring>
+
+namespace {
+const char* const kFxNames[] = {"none", "blink", "fade", "ticker"};
+}
+
+bool parsePanelFx(const char* name, PanelFx& out) {
+    if (!name) return false;
+    for (int i = 0; i < 4; ++i) {
+        if (std::strcmp(name, kFxNames[i]) == 0) {
+            out = static_cast<PanelFx>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* panelFxName(PanelFx fx) {
+    return kFxNames[static_cast<int>(fx)];
+}
+
+void FxAnimator::start(PanelFx fx, uint64_t nowNs) {
+    if (fx == fx_) return;
+    fx_ = fx;
+    startNs_ = nowNs;
+}
+
+PanelFxState FxAnimator::rest() const {
+    PanelFxState s;
+    s.contrast = contrast_;
+    return s;
+}
+
+PanelFxState FxAnimator::state(uint64_t nowNs) const {
+    PanelFxState s = rest();
+    const uint64_t ms = nowNs > startNs_ ? (nowNs - startNs_) / 1000000ull : 0;
+    switch (fx_) {
+        case PanelFx::Blink:
+            s.inverted = (ms / kBlinkMs) % 2 == 0;
+            break;
+        case PanelFx::Fade: {
+            // Triangle wave down to an eighth of the contrast and back,
+            // quantised to whole steps
+            const uint64_t half = kFadePeriodMs / 2;
+            const uint64_t t = (ms % kFadePeriodMs) / kFadeStepMs * kFadeStepMs;
+            const uint64_t depth = t < half ? t : kFadePeriodMs - t; // 0 .. half
+            const uint32_t lo = contrast_ / 8u;
+            s.contrast = static_cast<uint8_t>(contrast_ - (contrast_ - lo) * depth / half);
+            break;
+        }
+        case PanelFx::Ticker:
+            s.scroll = true;
+            break;
+        case PanelFx::None:
+            break;
+    }
+    return s;
+}
+
+uint32_t FxAnimator::stepMs() const {
+    switch (fx_) {
+        case PanelFx::Blink: return kBlinkMs;
+        case PanelFx::Fade: return kFadeStepMs;
+        default: return 0;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "panel.h"
+#include <cstdint>
+
+// Animations the panel controller runs from a few command bytes per step,
+// instead of the host pushing a frame per step: blink flips the display
+// inversion, fade ramps the contrast down and back up, and the ticker
+// writes a line of stats into the panel's last page and has the hardware
+// scroll (SSD1306 only) run that page alone. A new frame stops the scroll
+// and goes out as a diff; the band page is resent only if its text changed,
+// and a ticker still wanted is started again over it.
+enum class PanelFx : uint8_t { None, Blink, Fade, Ticker };
+
+// "none", "blink", "fade" or "ticker"
+bool parsePanelFx(const char* name, PanelFx& out);
+const char* panelFxName(PanelFx fx);
+
+// What the controller should be doing; panels send only the differences
+struct PanelFxState {
+    uint8_t contrast = kDefaultContrast;
+    bool inverted = false;
+    bool scroll = false; // the ticker band is scrolling
+
+    bool operator==(const PanelFxState& o) const {
+        return contrast == o.contrast && inverted == o.inverted && scroll == o.scroll;
+    }
+    bool operator!=(const PanelFxState& o) const { return !(*this == o); }
+};
+
+// One effect at a time, as a function of CLOCK_MONOTONIC time from its
+// start. With none running, state() is the resting state at `contrast`.
+class FxAnimator {
+public:
+    static constexpr uint32_t kBlinkMs = 500;      // per phase
+    static constexpr uint32_t kFadePeriodMs = 2000; // full -> dim -> full
+    static constexpr uint32_t kFadeStepMs = 100;
+
+    explicit FxAnimator(uint8_t contrast = kDefaultContrast) : contrast_(contrast) {}
+
+    // Restarting the running effect keeps its phase
+    void start(PanelFx fx, uint64_t nowNs);
+    void stop() { fx_ = PanelFx::None; }
+    PanelFx active() const { return fx_; }
+
+    PanelFxState state(uint64_t nowNs) const;
+    PanelFxState rest() const;
+    // How often state() changes while the effect runs; 0 if it doesn't
+    uint32_t stepMs() const;
+
+private:
+    uint8_t contrast_;
+    PanelFx fx_ = PanelFx::None;
+    uint64_t startNs_ = 0;
+};
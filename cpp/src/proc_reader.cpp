@@ -0,0 +1,30 @@
+#include "proc_reader.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+ProcFile::~ProcFile() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+void ProcFile::reset(const std::string& path) {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    path_.assign(path);
+}
+
+ssize_t ProcFile::read(char* buf, size_t cap) {
+    if (cap == 0) return -1;
+    buf[0] = '\0';
+    if (fd_ < 0) {
+        fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) return -1;
+    }
+    ssize_t n = ::pread(fd_, buf, cap - 1, 0);
+    if (n < 0) {
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+    buf[n] = '\0';
+    return n;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+// A /proc or /sys pseudo-file kept open across samples. Each read() is a
+// single pread() at offset 0 into a caller-supplied (stack) buffer, which
+// re-generates the file contents without reopening it.
+class ProcFile {
+public:
+    ProcFile() = default;
+    explicit ProcFile(std::string path) : path_(std::move(path)) {}
+    ~ProcFile();
+    ProcFile(const ProcFile&) = delete;
+    ProcFile& operator=(const ProcFile&) = delete;
+
+    // Point at another file; the old fd is closed. The path is copied into
+    // the existing string, so re-pointing between paths of similar length
+    // doesn't allocate.
+    void reset(const std::string& path);
+    const std::string& path() const { return path_; }
+
+    // Fill buf with up to cap-1 bytes and NUL-terminate. Returns the byte
+    // count or -1; on error the fd is dropped and reopened next time.
+    ssize_t read(char* buf, size_t cap);
+
+private:
+    std::string path_;
+    int fd_ = -1;
+};
+
+// Allocation-free scanners over a NUL-terminated buffer. Each returns the
+// position after what it consumed, or nullptr when the input doesn't match.
+namespace procparse {
+
+inline const char* skipSpaces(const char* p) {
+    while (*p == ' ' || *p == '\t') ++p;
+    return p;
+}
+
+inline const char* parseU64(const char* p, uint64_t& v) {
+    p = skipSpaces(p);
+    if (*p < '0' || *p > '9') return nullptr;
+    uint64_t r = 0;
+    while (*p >= '0' && *p <= '9') r = r * 10 + static_cast<uint64_t>(*p++ - '0');
+    v = r;
+    return p;
+}
+
+inline const char* skipToken(const char* p) {
+    p = skipSpaces(p);
+    while (*p && *p != ' ' && *p != '\t' && *p != '\n') ++p;
+    return p;
+}
+
+// Start of the next line, or nullptr at the end of the buffer
+inline const char* nextLine(const char* p) {
+    while (*p && *p != '\n') ++p;
+    return *p ? p + 1 : nullptr;
+}
+
+inline bool startsWith(const char* p, const char* lit) {
+    while (*lit) {
+        if (*p++ != *lit++) return false;
+    }
+    return true;
+}
+
+} // namespace procparse
@@ -0,0 +1,170 @@
+#include "proc_top.h"
+#include "metrics.h"
+#include "proc_reader.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+ProcessSampler::ProcessSampler(std::string procRoot)
+    : procRoot_(std::move(procRoot)), tables_(new Slot[2 * kTableSlots]()) {
+    long hz = sysconf(_SC_CLK_TCK);
+    if (hz > 0) ticksPerSec_ = static_cast<double>(hz);
+    long page = sysconf(_SC_PAGESIZE);
+    if (page > 0) pageKb_ = static_cast<uint64_t>(page) / 1024;
+}
+
+ProcessSampler::~ProcessSampler() {
+    if (dir_) closedir(dir_);
+}
+
+static uint32_t slotOf(int32_t pid) {
+    return (static_cast<uint32_t>(pid) * 2654435761u) & (ProcessSampler::kTableSlots - 1);
+}
+
+const ProcessSampler::Slot* ProcessSampler::find(int32_t pid, uint32_t gen) {
+    const Slot* t = table(gen);
+    for (uint32_t i = slotOf(pid), n = 0; n < kTableSlots; i = (i + 1) & (kTableSlots - 1), ++n) {
+        if (t[i].gen != gen) return nullptr;
+        if (t[i].pid == pid) return &t[i];
+    }
+    return nullptr;
+}
+
+bool ProcessSampler::insert(const Slot& s) {
+    Slot* t = table(s.gen);
+    for (uint32_t i = slotOf(s.pid), n = 0; n < kTableSlots; i = (i + 1) & (kTableSlots - 1), ++n) {
+        if (t[i].gen != s.gen) {
+            t[i] = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Keep `top` (descending by key, `n` used of kTopN) with `u` inserted in order
+template <typename Key>
+static void rank(ProcessUsage (&top)[ProcessSampler::kTopN], int& n, const ProcessUsage& u, Key key) {
+    int i = n < ProcessSampler::kTopN ? n++ : ProcessSampler::kTopN;
+    if (i == ProcessSampler::kTopN) {
+        if (!(key(u) > key(top[i - 1]))) return;
+        --i;
+    }
+    for (; i > 0 && key(u) > key(top[i - 1]); --i) top[i] = top[i - 1];
+    top[i] = u;
+}
+
+// Fields of /proc/[pid]/stat the ranking needs. The command name is in
+// parentheses and may itself contain spaces or ')', so fields are counted
+// from the last ')'. The process sets its own name (prctl), so anything
+// outside [A-Za-z0-9._-] becomes '_' before it reaches the log line.
+static bool parseStat(const char* buf, ProcessUsage& u, uint64_t& ticks, uint64_t& startTime, uint64_t pageKb) {
+    using namespace procparse;
+    const char* open = std::strchr(buf, '(');
+    const char* close = std::strrchr(buf, ')');
+    if (!open || !close || close < open) return false;
+    size_t len = static_cast<size_t>(close - open - 1);
+    if (len >= sizeof(u.name)) len = sizeof(u.name) - 1;
+    for (size_t i = 0; i < len; ++i) {
+        const char c = open[1 + i];
+        const bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                           c == '.' || c == '_' || c == '-';
+        u.name[i] = plain ? c : '_';
+    }
+    u.name[len] = '\0';
+
+    const char* p = close + 1;
+    for (int f = 3; f < 14; ++f) p = skipToken(p); // state .. cmajflt
+    uint64_t utime = 0, stime = 0, rss = 0;
+    if (!(p = parseU64(p, utime)) || !(p = parseU64(p, stime))) return false;
+    for (int f = 16; f < 22; ++f) p = skipToken(p); // cutime .. itrealvalue
+    if (!(p = parseU64(p, startTime))) return false;
+    p = skipToken(p); // vsize
+    if (!parseU64(p, rss)) return false;
+    ticks = utime + stime;
+    u.rss_kb = rss * pageKb;
+    return true;
+}
+
+bool ProcessSampler::sample() {
+    if (skip_ > 0) {
+        --skip_;
+        return false;
+    }
+    if (!dir_) {
+        dir_ = opendir(procRoot_.c_str());
+        if (!dir_) return false;
+    } else {
+        rewinddir(dir_);
+    }
+    const uint64_t start = monotonicNs();
+    const double dtSec = lastNs_ ? static_cast<double>(start - lastNs_) / 1e9 : 0.0;
+    const uint32_t prevGen = gen_;
+    const bool prevFull = lastFull_;
+    const uint32_t gen = ++gen_;
+    const int dfd = dirfd(dir_);
+
+    ProcessUsage cpuTop[kTopN], rssTop[kTopN];
+    int cpuN = 0, rssN = 0, seen = 0, tracked = 0;
+    bool full = false;
+    while (const dirent* e = readdir(dir_)) {
+        const char* d = e->d_name;
+        if (*d < '1' || *d > '9') continue;
+        int32_t pid = 0;
+        for (; *d >= '0' && *d <= '9'; ++d) pid = pid * 10 + (*d - '0');
+        if (*d) continue;
+
+        char path[32];
+        std::snprintf(path, sizeof(path), "%.16s/stat", e->d_name); // pids are at most 7 digits
+        int fd = openat(dfd, path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue; // exited since readdir
+        char buf[512];
+        ssize_t n = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (n <= 0) continue;
+        buf[n] = '\0';
+
+        ProcessUsage u;
+        uint64_t ticks = 0, startTime = 0;
+        if (!parseStat(buf, u, ticks, startTime, pageKb_)) continue;
+        u.pid = pid;
+        ++seen;
+
+        if (dtSec > 0.0) {
+            // A new process (or a reused pid) ran at most since its start,
+            // which is inside the interval. If the last scan ran out of
+            // slots, a missing pid may be an old untracked process whose
+            // lifetime ticks say nothing about the interval.
+            const Slot* old = find(pid, prevGen);
+            uint64_t delta = 0;
+            if (old && old->startTime == startTime) delta = ticks >= old->ticks ? ticks - old->ticks : 0;
+            else if (old || !prevFull) delta = ticks;
+            u.cpu_percent = static_cast<float>(static_cast<double>(delta) * 100.0 / (ticksPerSec_ * dtSec));
+        } else {
+            u.cpu_percent = 0.f;
+        }
+        if (tracked < kTableSlots / 2 && insert(Slot{pid, gen, startTime, ticks})) ++tracked;
+        else full = true;
+
+        rank(cpuTop, cpuN, u, [](const ProcessUsage& x) { return x.cpu_percent; });
+        rank(rssTop, rssN, u, [](const ProcessUsage& x) { return x.rss_kb; });
+    }
+    if (seen == 0) return false;
+
+    for (int i = 0; i < cpuN; ++i) {
+        topCpu_[i] = cpuTop[i];
+        topRss_[i] = rssTop[i];
+    }
+    topCount_ = cpuN;
+    processes_ = seen;
+    lastFull_ = full;
+    lastNs_ = start;
+
+    uint64_t us = (monotonicNs() - start) / 1000;
+    scanUs_ = us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us);
+    if (budgetUs_ && scanUs_ > budgetUs_) {
+        uint32_t over = scanUs_ / budgetUs_;
+        skip_ = over > kMaxSkip ? kMaxSkip : over;
+    }
+    return true;
+}
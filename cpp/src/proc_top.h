@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <dirent.h>
+
+// One process in a top-N ranking
+struct ProcessUsage {
+    char name[16] = "";      // comm (the kernel truncates it to 15 characters), [A-Za-z0-9._-] only
+    int32_t pid = 0;
+    float cpu_percent = 0.f; // of one core over the last scan interval
+    uint64_t rss_kb = 0;
+};
+
+// Incremental /proc/[pid] scanner ranking processes by CPU and by resident
+// memory. Keeps the /proc directory open and rewinds it per scan, opens each
+// stat file relative to it, and parses into stack buffers. Previous CPU
+// ticks live in two fixed open-addressing tables (current and last scan,
+// told apart by a scan generation), so a scan neither allocates nor has to
+// clear or compact anything for exited processes. Past kTableSlots/2
+// processes the rest go untracked, and after such a scan a pid missing from
+// the table reads as 0% rather than as new.
+//
+// With a budget set, a scan that costs more than it skips the next
+// cost/budget calls (at most kMaxSkip), stretching the effective interval
+// on a busy system instead of adding to the load.
+class ProcessSampler {
+public:
+    static constexpr int kTopN = 5;
+    static constexpr int kTableSlots = 4096; // power of two; tracks up to half
+    static constexpr uint32_t kMaxSkip = 8;
+
+    explicit ProcessSampler(std::string procRoot = "/proc");
+    ~ProcessSampler();
+    ProcessSampler(const ProcessSampler&) = delete;
+    ProcessSampler& operator=(const ProcessSampler&) = delete;
+
+    void setBudgetUs(uint32_t us) { budgetUs_ = us; }
+
+    // Scan every process; false when /proc is unreadable or the scan was
+    // skipped for the budget (results keep their previous values). The
+    // first scan has nothing to diff against and reports 0% CPU.
+    bool sample();
+
+    int processCount() const { return processes_; }
+    uint32_t scanUs() const { return scanUs_; }
+    int topCount() const { return topCount_; }
+    const ProcessUsage& topCpu(int i) const { return topCpu_[i]; }
+    const ProcessUsage& topRss(int i) const { return topRss_[i]; }
+
+private:
+    struct Slot {
+        int32_t pid;
+        uint32_t gen;       // scan that wrote it; other values read as empty
+        uint64_t startTime; // tells a reused pid from the old process
+        uint64_t ticks;     // utime + stime
+    };
+
+    std::string procRoot_;
+    DIR* dir_ = nullptr;
+    std::unique_ptr<Slot[]> tables_; // 2 * kTableSlots
+    uint32_t gen_ = 0;
+    bool lastFull_ = false; // the previous scan had more processes than slots
+    uint64_t lastNs_ = 0;
+    double ticksPerSec_ = 100.0;
+    uint64_t pageKb_ = 4;
+    uint32_t budgetUs_ = 0;
+    uint32_t skip_ = 0;
+    uint32_t scanUs_ = 0;
+    int processes_ = 0;
+    int topCount_ = 0;
+    ProcessUsage topCpu_[kTopN];
+    ProcessUsage topRss_[kTopN];
+
+    Slot* table(uint32_t gen) { return tables_.get() + (gen & 1u) * kTableSlots; }
+    const Slot* find(int32_t pid, uint32_t gen);
+    bool insert(const Slot& s);
+};
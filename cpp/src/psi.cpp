@@ -0,0 +1,114 @@
+#include "psi.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+const char* psiResourceName(PsiResource r) {
+    static const char* const names[PSI_COUNT] = {"cpu", "memory", "io"};
+    return (r >= 0 && r < PSI_COUNT) ? names[r] : "?";
+}
+
+// "25.26" -> 25.26f; the kernel always prints two decimals
+static const char* parseFixed2(const char* p, float& out) {
+    uint64_t whole = 0, frac = 0;
+    p = procparse::parseU64(p, whole);
+    if (!p) return nullptr;
+    if (*p == '.') {
+        const char* q = procparse::parseU64(p + 1, frac);
+        if (!q) return nullptr;
+        p = q;
+    }
+    out = static_cast<float>(whole) + static_cast<float>(frac) / 100.0f;
+    return p;
+}
+
+// "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+static bool parseLine(const char* line, float& avg10, float& avg60) {
+    const char* p = std::strstr(line, "avg10=");
+    if (!p || !(p = parseFixed2(p + 6, avg10))) return false;
+    p = procparse::skipSpaces(p);
+    if (!procparse::startsWith(p, "avg60=")) return false;
+    return parseFixed2(p + 6, avg60) != nullptr;
+}
+
+bool readPsi(ProcFile& file, PsiAverages& out) {
+    using namespace procparse;
+    char buf[256];
+    if (file.read(buf, sizeof(buf)) <= 0) return false;
+    bool ok = false;
+    for (const char* line = buf; line; line = nextLine(line)) {
+        if (startsWith(line, "some ")) ok = parseLine(line, out.some_avg10, out.some_avg60);
+        else if (startsWith(line, "full ")) parseLine(line, out.full_avg10, out.full_avg60);
+    }
+    return ok;
+}
+
+// The trigger string includes its terminating NUL
+static bool writeTrigger(int fd, uint32_t stallMs, uint32_t windowMs) {
+    char trig[64];
+    int n = std::snprintf(trig, sizeof(trig), "some %u %u", stallMs * 1000u, windowMs * 1000u);
+    return ::write(fd, trig, static_cast<size_t>(n) + 1) >= 0;
+}
+
+PsiMonitor::~PsiMonitor() {
+    for (int r = 0; r < PSI_COUNT; ++r) close(static_cast<PsiResource>(r));
+}
+
+void PsiMonitor::close(PsiResource r) {
+    if (fds_[r] >= 0) ::close(fds_[r]);
+    fds_[r] = -1;
+}
+
+int PsiMonitor::open(const char* spec, uint32_t windowMs, const std::string& procRoot) {
+    windowMs_ = windowMs;
+    for (int r = 0; r < PSI_COUNT; ++r) stallMs_[r] = kDefaultStallMs[r];
+    // Same "key=ms,key=ms" shape as RPI_STATS_PERIODS
+    for (const char* p = spec; p && *p;) {
+        const char* eq = std::strchr(p, '=');
+        if (!eq) break;
+        for (int r = 0; r < PSI_COUNT; ++r) {
+            const char* name = psiResourceName(static_cast<PsiResource>(r));
+            size_t len = std::strlen(name);
+            if (static_cast<size_t>(eq - p) == len && std::strncmp(p, name, len) == 0) {
+                long v = std::atol(eq + 1);
+                if (v >= 0 && v <= static_cast<long>(windowMs)) stallMs_[r] = static_cast<uint32_t>(v);
+            }
+        }
+        const char* comma = std::strchr(eq, ',');
+        p = comma ? comma + 1 : nullptr;
+    }
+
+    int armed = 0;
+    for (int r = 0; r < PSI_COUNT; ++r) {
+        PsiResource res = static_cast<PsiResource>(r);
+        close(res);
+        if (stallMs_[r] == 0) continue;
+        std::string path = procRoot + "/pressure/" + psiResourceName(res);
+        int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "psi: cannot open %s: %s\n", path.c_str(), std::strerror(errno));
+            continue;
+        }
+        bool ok = writeTrigger(fd, stallMs_[r], windowMs_);
+        if (!ok && errno == EINVAL && windowMs_ % 2000 != 0) {
+            // Without CAP_SYS_RESOURCE the window must be a multiple of 2 s
+            uint32_t wider = (windowMs_ / 2000 + 1) * 2000;
+            if (writeTrigger(fd, stallMs_[r], wider)) {
+                fprintf(stderr, "psi: unprivileged triggers, window widened to %ums\n", wider);
+                windowMs_ = wider;
+                ok = true;
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "psi: cannot arm %s trigger: %s\n", psiResourceName(res), std::strerror(errno));
+            ::close(fd);
+            continue;
+        }
+        fds_[r] = fd;
+        ++armed;
+    }
+    return armed;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "proc_reader.h"
+
+// Pressure Stall Information resources under /proc/pressure
+enum PsiResource : int { PSI_CPU, PSI_MEMORY, PSI_IO, PSI_COUNT };
+
+// "cpu", "memory", "io" (file names, env keys and log labels)
+const char* psiResourceName(PsiResource r);
+
+// Share of wall time (%) some / all non-idle tasks were stalled, averaged
+// over the last 10 s and 60 s. "full" is 0 for cpu on kernels before 5.13.
+struct PsiAverages {
+    float some_avg10 = 0.0f, some_avg60 = 0.0f;
+    float full_avg10 = 0.0f, full_avg60 = 0.0f;
+};
+
+// Parse one /proc/pressure/<resource> file read through `file`
+bool readPsi(ProcFile& file, PsiAverages& out);
+
+// Kernel PSI triggers ("some <stall us> <window us>" written to the
+// pressure file). The fd reports EPOLLPRI each time tasks stall for more
+// than the threshold within a window, at most once per window; EPOLLERR
+// means the trigger is gone. Without CAP_SYS_RESOURCE (6.5+ kernels) the
+// window must be a multiple of 2 s; open() widens it once if refused.
+class PsiMonitor {
+public:
+    PsiMonitor() = default;
+    ~PsiMonitor();
+    PsiMonitor(const PsiMonitor&) = delete;
+    PsiMonitor& operator=(const PsiMonitor&) = delete;
+
+    // "cpu=300,memory=100,io=300": stall threshold in ms per resource,
+    // 0 disables one; missing keys keep kDefaultStallMs. Returns the number
+    // of triggers armed.
+    int open(const char* spec, uint32_t windowMs, const std::string& procRoot = "/proc");
+
+    int fd(PsiResource r) const { return fds_[r]; }
+    uint32_t stallMs(PsiResource r) const { return stallMs_[r]; }
+    uint32_t windowMs() const { return windowMs_; }
+    void close(PsiResource r);
+
+    static constexpr uint32_t kDefaultStallMs[PSI_COUNT] = {300, 100, 300};
+
+private:
+    int fds_[PSI_COUNT] = {-1, -1, -1};
+    uint32_t stallMs_[PSI_COUNT] = {};
+    uint32_t windowMs_ = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer seqlock. The writer never waits; readers retry while a
+// write is in flight. The payload is stored as relaxed atomic words so a
+// torn read is detected rather than being a data race.
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock payload must be trivially copyable");
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+public:
+    Seqlock() {
+        for (auto& w : words_) w.store(0, std::memory_order_relaxed);
+    }
+
+    void store(const T& value) {
+        uint64_t tmp[kWords] = {};
+        std::memcpy(tmp, &value, sizeof(T));
+        uint32_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) words_[i].store(tmp[i], std::memory_order_relaxed);
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t tmp[kWords];
+        uint32_t s0, s1;
+        do {
+            s0 = seq_.load(std::memory_order_acquire);
+            for (size_t i = 0; i < kWords; ++i) tmp[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s1 = seq_.load(std::memory_order_relaxed);
+        } while ((s0 & 1u) || s0 != s1);
+        T value;
+        std::memcpy(&value, tmp, sizeof(T));
+        return value;
+    }
+
+    // Bumps by 2 per store; lets readers skip work when nothing changed
+    uint32_t version() const { return seq_.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<uint64_t> words_[kWords];
+};
@@ -1,121 +1,331 @@
 #include "ssd1306.h"
-#include <linux/i2c-dev.h>
-#include <sys/ioctl.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include "font5x7.h"
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
+#include <algorithm>
 
-// 5x7 ASCII font (32..127), adapted from public domain sources
-static const uint8_t font5x7[] = {
-#include "tiny5x7.inc"
-};
-
-SSD1306::SSD1306(const std::string& i2cDev, uint8_t addr) : addr_(addr) {
-    buf_.assign(WIDTH * PAGES, 0);
-    fd_ = ::open(i2cDev.c_str(), O_RDWR);
-    if (fd_ >= 0) {
-        if (ioctl(fd_, I2C_SLAVE, addr_) < 0) {
-            ::close(fd_);
-            fd_ = -1;
-        }
-    }
-}
+template <typename P>
+OledDisplay<P>::OledDisplay(const std::string& i2cDev, uint8_t addr, size_t maxTransfer)
+    : OledDisplay(std::make_unique<LinuxI2CBus>(i2cDev, addr), addr, maxTransfer) {}
 
-SSD1306::~SSD1306() {
-    if (fd_ >= 0) ::close(fd_);
+template <typename P>
+OledDisplay<P>::OledDisplay(std::unique_ptr<I2CBus> bus, uint8_t addr, size_t maxTransfer)
+    : bus_(std::move(bus)), addr_(addr) {
+    tx_ = std::make_unique<I2CTransport>(*bus_, addr_, maxTransfer);
+    clearDirty();
+    markAllDirty();
 }
 
-bool SSD1306::init() {
-    if (fd_ < 0) return false;
+template <typename P>
+OledDisplay<P>::~OledDisplay() = default;
+
+template <typename P>
+bool OledDisplay<P>::init() {
+    if (!bus_->isOpen()) return false;
     initSeq();
     clear();
+    invalidate();
     display();
     return true;
 }
 
-void SSD1306::initSeq() {
-    // Minimal init for 128x32
-    uint8_t cmds[] = {
-        0xAE,       // Display off
-        0xD5, 0x80, // Set display clock divide ratio/oscillator frequency
-        0xA8, 0x1F, // Multiplex ratio (0x1F = 32-1)
-        0xD3, 0x00, // Display offset
-        0x40,       // Start line 0
-        0x8D, 0x14, // Charge pump on
-        0x20, 0x00, // Memory addressing mode: horizontal
-        0xA1,       // Segment remap
-        0xC8,       // COM output scan direction remapped
-        0xDA, 0x02, // COM pins hardware configuration for 128x32
-        0x81, 0x8F, // Contrast
-        0xD9, 0xF1, // Pre-charge period
-        0xDB, 0x40, // VCOMH deselect level
-        0xA4,       // Entire display ON from RAM
-        0xA6,       // Normal display
-        0x2E,       // Deactivate scroll
-        0xAF        // Display ON
-    };
-    for (uint8_t c : cmds) writeCmd(c);
-}
-
-bool SSD1306::writeCmd(uint8_t c) {
-    if (fd_ < 0) return false;
-    uint8_t buf[2] = {0x00, c};
-    return ::write(fd_, buf, 2) == 2;
-}
-
-bool SSD1306::writeData(const uint8_t* data, size_t len) {
-    if (fd_ < 0) return false;
-    // We need to prefix with 0x40 control byte; send in chunks
-    uint8_t packet[17]; // 1 ctrl + 16 data
-    packet[0] = 0x40;
-    size_t i = 0;
-    while (i < len) {
-        size_t n = (len - i > 16) ? 16 : (len - i);
-        memcpy(packet + 1, data + i, n);
-        if (::write(fd_, packet, n + 1) != static_cast<ssize_t>(n + 1)) return false;
-        i += n;
+template <typename P>
+void OledDisplay<P>::initSeq() {
+    if constexpr (P::CONTROLLER == Controller::SH1106) {
+        // SH1106: page addressing only, DC-DC converter instead of the
+        // charge pump, no scroll engine
+        const uint8_t cmds[] = {
+            0xAE,             // Display off
+            0xD5, 0x80,       // Set display clock divide ratio/oscillator frequency
+            0xA8, P::MULTIPLEX, // Multiplex ratio (height - 1)
+            0xD3, 0x00,       // Display offset
+            0x40,             // Start line 0
+            0xAD, 0x8B,       // DC-DC on
+            0xA1,             // Segment remap
+            0xC8,             // COM output scan direction remapped
+            0xDA, P::COM_PINS, // COM pins hardware configuration
+            0x81, kDefaultContrast, // Contrast
+            0xD9, 0x22,       // Pre-charge period
+            0xDB, 0x40,       // VCOM deselect level
+            0xA4,             // Entire display ON from RAM
+            0xA6,             // Normal display
+            0xAF              // Display ON
+        };
+        writeCmds(cmds, sizeof(cmds));
+    } else {
+        const uint8_t cmds[] = {
+            0xAE,       // Display off
+            0xD5, 0x80, // Set display clock divide ratio/oscillator frequency
+            0xA8, P::MULTIPLEX, // Multiplex ratio (height - 1)
+            0xD3, 0x00, // Display offset
+            0x40,       // Start line 0
+            0x8D, 0x14, // Charge pump on
+            0x20, 0x00, // Memory addressing mode: horizontal
+            0xA1,       // Segment remap
+            0xC8,       // COM output scan direction remapped
+            0xDA, P::COM_PINS, // COM pins hardware configuration (0x02 for 32 rows, 0x12 for 64)
+            0x81, kDefaultContrast, // Contrast
+            0xD9, 0xF1, // Pre-charge period
+            0xDB, 0x40, // VCOMH deselect level
+            0xA4,       // Entire display ON from RAM
+            0xA6,       // Normal display
+            0x2E,       // Deactivate scroll
+            0xAF        // Display ON
+        };
+        writeCmds(cmds, sizeof(cmds));
     }
-    return true;
+    flush();
+}
+
+template <typename P>
+void OledDisplay<P>::writeCmds(const uint8_t* cmds, size_t n) {
+    tx_->queueCmds(cmds, n);
+}
+
+template <typename P>
+void OledDisplay<P>::writeData(const uint8_t* data, size_t len) {
+    tx_->queueData(data, len);
 }
 
-void SSD1306::clear() {
-    std::fill(buf_.begin(), buf_.end(), 0);
+template <typename P>
+bool OledDisplay<P>::flush() {
+    lastFrameBytes_ += tx_->pendingBytes();
+    return tx_->flush();
 }
 
-void SSD1306::display() {
-    writeCmd(0x21); // set column address
-    writeCmd(0);
-    writeCmd(WIDTH - 1);
+template <typename P>
+bool OledDisplay<P>::sendCmds(const uint8_t* cmds, size_t n) {
+    if (!bus_->isOpen()) return false;
+    writeCmds(cmds, n);
+    totalBytes_ += tx_->pendingBytes();
+    return tx_->flush();
+}
 
-    writeCmd(0x22); // set page address
-    writeCmd(0);
-    writeCmd(PAGES - 1);
+template <typename P>
+void OledDisplay<P>::setContrast(uint8_t level) {
+    const uint8_t cmds[] = {0x81, level};
+    sendCmds(cmds, sizeof(cmds));
+}
 
-    writeData(buf_.data(), buf_.size());
+template <typename P>
+void OledDisplay<P>::setPower(bool on) {
+    const uint8_t cmd = on ? 0xAF : 0xAE;
+    sendCmds(&cmd, 1);
 }
 
-void SSD1306::setPixel(int x, int y, bool on) {
+template <typename P>
+void OledDisplay<P>::setInverted(bool inverted) {
+    const uint8_t cmd = inverted ? 0xA7 : 0xA6;
+    sendCmds(&cmd, 1);
+}
+
+template <typename P>
+bool OledDisplay<P>::startScroll(ScrollDir dir, int page0, int page1, int frames, uint8_t verticalOffset) {
+    if constexpr (P::CONTROLLER == Controller::SH1106) {
+        (void)dir; (void)page0; (void)page1; (void)frames; (void)verticalOffset;
+        return false;
+    } else {
+        if (!bus_->isOpen() || page0 < 0 || page1 >= PAGES || page0 > page1) return false;
+        // Frames per step for each value of the 3-bit interval field
+        constexpr int kIntervals[8] = {5, 64, 128, 256, 3, 4, 25, 2};
+        uint8_t code = 0;
+        for (uint8_t i = 1; i < 8; ++i) {
+            if (std::abs(kIntervals[i] - frames) < std::abs(kIntervals[code] - frames)) code = i;
+        }
+        const uint8_t p0 = static_cast<uint8_t>(page0), p1 = static_cast<uint8_t>(page1);
+        // Whatever runs is stopped first: the setup must not change under a
+        // running scroll. If the transfer fails the panel may be scrolling
+        // anyway, so the next display() stops it regardless.
+        if (scrolling_) scrollStopped();
+        scrolling_ = true;
+        scrollVertical_ = dir == ScrollDir::UpRight || dir == ScrollDir::UpLeft;
+        scrollPages_ = static_cast<uint8_t>(((1u << (p1 + 1)) - 1) & ~((1u << p0) - 1));
+        if (!scrollVertical_) {
+            const uint8_t cmds[] = {
+                0x2E,
+                static_cast<uint8_t>(dir == ScrollDir::Right ? 0x26 : 0x27),
+                0x00, p0, code, p1, 0x00, 0xFF, // dummy, pages, interval, dummies
+                0x2F,                           // activate
+            };
+            return sendCmds(cmds, sizeof(cmds));
+        }
+        if (verticalOffset < 1) verticalOffset = 1;
+        if (verticalOffset > HEIGHT - 1) verticalOffset = static_cast<uint8_t>(HEIGHT - 1);
+        const uint8_t cmds[] = {
+            0x2E,
+            0xA3, 0x00, static_cast<uint8_t>(HEIGHT), // every row takes part in the vertical move
+            static_cast<uint8_t>(dir == ScrollDir::UpRight ? 0x29 : 0x2A),
+            0x00, p0, code, p1, verticalOffset,
+            0x2F,
+        };
+        return sendCmds(cmds, sizeof(cmds));
+    }
+}
+
+template <typename P>
+void OledDisplay<P>::stopScroll() {
+    if (!scrolling_) return;
+    const uint8_t cmd = 0x2E;
+    sendCmds(&cmd, 1);
+    scrollStopped();
+    stale_ = static_cast<uint8_t>(stale_ | rotated_);
+}
+
+template <typename P>
+void OledDisplay<P>::scrollStopped() {
+    scrolling_ = false;
+    if (scrollVertical_) invalidate();
+    else rotated_ = static_cast<uint8_t>(rotated_ | scrollPages_);
+}
+
+template <typename P>
+void OledDisplay<P>::clear() {
+    buf_.fill(0);
+    markAllDirty();
+}
+
+// Bytes an extra address window costs on the wire: six command bytes plus
+// the control bytes of the command and data messages it splits off. With
+// page addressing every page is addressed separately anyway, so merging
+// pages never saves anything.
+template <typename P>
+static constexpr int kWindowOverhead = P::PAGE_ADDRESSING ? 0 : 6 + 2;
+
+template <typename P>
+void OledDisplay<P>::queueWindow(int col0, int col1, int page0, int page1) {
+    size_t cols = static_cast<size_t>(col1 - col0 + 1);
+    if constexpr (P::PAGE_ADDRESSING) {
+        // Page start + column nibbles per page; the column pointer only
+        // advances within the page
+        const int c = col0 + P::COLUMN_OFFSET;
+        for (int p = page0; p <= page1; ++p) {
+            const uint8_t cmds[] = {
+                static_cast<uint8_t>(0xB0 | p),
+                static_cast<uint8_t>(0x00 | (c & 0x0F)),
+                static_cast<uint8_t>(0x10 | (c >> 4)),
+            };
+            writeCmds(cmds, sizeof(cmds));
+            writeData(&buf_[static_cast<size_t>(p * WIDTH + col0)], cols);
+        }
+    } else {
+        const uint8_t cmds[] = {
+            0x21, static_cast<uint8_t>(col0), static_cast<uint8_t>(col1),   // column address
+            0x22, static_cast<uint8_t>(page0), static_cast<uint8_t>(page1), // page address
+        };
+        writeCmds(cmds, sizeof(cmds));
+        // Horizontal addressing wraps col1 -> col0 on the next page, so the
+        // window payload is each page's [col0, col1] slice back to back.
+        for (int p = page0; p <= page1; ++p) {
+            writeData(&buf_[static_cast<size_t>(p * WIDTH + col0)], cols);
+        }
+    }
+}
+
+template <typename P>
+void OledDisplay<P>::display() {
+    lastFrameBytes_ = 0;
+    if (!bus_->isOpen()) return;
+
+    // GDDRAM must not be written while the controller scrolls it: stop in
+    // the same transfer. The scrolled pages are rotated by an unknown amount
+    // from here on.
+    if (scrolling_) {
+        const uint8_t stop = 0x2E;
+        writeCmds(&stop, 1);
+        scrollStopped();
+    }
+    if (!shadowValid_) {
+        queueWindow(0, WIDTH - 1, 0, PAGES - 1);
+        shadowValid_ = flush();
+        if (shadowValid_) shadow_ = buf_;
+        rotated_ = stale_ = 0;
+        clearDirty();
+        totalBytes_ += lastFrameBytes_;
+        bus_->endFrame();
+        return;
+    }
+
+    // Changed column range per page (lo > hi means the page is clean),
+    // looking only at the columns drawn since the last frame. A rotated page
+    // with any change goes out whole: its columns aren't where the shadow
+    // says.
+    int lo[PAGES], hi[PAGES];
+    uint8_t whole = 0;
+    for (int p = 0; p < PAGES; ++p) {
+        const uint8_t* cur = &buf_[static_cast<size_t>(p * WIDTH)];
+        const uint8_t* old = &shadow_[static_cast<size_t>(p * WIDTH)];
+        lo[p] = WIDTH; hi[p] = -1;
+        for (int x = dirtyLo_[p]; x <= dirtyHi_[p]; ++x) {
+            if (cur[x] != old[x]) { lo[p] = x; break; }
+        }
+        if ((stale_ >> p) & 1u || (lo[p] < WIDTH && (rotated_ >> p) & 1u)) {
+            lo[p] = 0; hi[p] = WIDTH - 1;
+            whole = static_cast<uint8_t>(whole | 1u << p);
+            continue;
+        }
+        if (lo[p] == WIDTH) continue;
+        for (int x = dirtyHi_[p]; x >= lo[p]; --x) {
+            if (cur[x] != old[x]) { hi[p] = x; break; }
+        }
+    }
+    clearDirty();
+
+    // Greedily grow a window over following dirty pages while resending the
+    // unchanged bytes inside the union is cheaper than opening a new window.
+    int p = 0;
+    while (p < PAGES) {
+        if (hi[p] < 0) { ++p; continue; }
+        int p0 = p, p1 = p, c0 = lo[p], c1 = hi[p];
+        int cost = c1 - c0 + 1;
+        int q = p + 1;
+        for (; q < PAGES; ++q) {
+            if (hi[q] < 0) continue;
+            int m0 = std::min(c0, lo[q]), m1 = std::max(c1, hi[q]);
+            int merged = (q - p0 + 1) * (m1 - m0 + 1);
+            int separate = cost + (hi[q] - lo[q] + 1) + kWindowOverhead<P>;
+            if (merged > separate) break;
+            p1 = q; c0 = m0; c1 = m1; cost = merged;
+        }
+        queueWindow(c0, c1, p0, p1);
+        p = q;
+    }
+    // All windows go out in one flush; after a failure the panel contents
+    // are unknown, so the next frame is sent in full.
+    if (flush()) {
+        shadow_ = buf_;
+        rotated_ = static_cast<uint8_t>(rotated_ & ~whole);
+        stale_ = 0;
+    } else {
+        shadowValid_ = false;
+    }
+    totalBytes_ += lastFrameBytes_;
+    bus_->endFrame();
+}
+
+template <typename P>
+void OledDisplay<P>::setPixel(int x, int y, bool on) {
     if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
     int page = y / 8;
     int bit = y % 8;
-    size_t idx = page * WIDTH + x;
+    size_t idx = static_cast<size_t>(page * WIDTH + x);
+    markDirty(x, x, page);
     if (on)
-        buf_[idx] |= (1u << bit);
+        buf_[idx] = static_cast<uint8_t>(buf_[idx] | (1u << bit));
     else
-        buf_[idx] &= ~(1u << bit);
+        buf_[idx] = static_cast<uint8_t>(buf_[idx] & ~(1u << bit));
 }
 
-void SSD1306::drawHLine(int x, int y, int w, bool on) {
+template <typename P>
+void OledDisplay<P>::drawHLine(int x, int y, int w, bool on) {
     for (int i = 0; i < w; ++i) setPixel(x + i, y, on);
 }
 
-void SSD1306::drawText(int x, int y, const std::string& text) {
+template <typename P>
+void OledDisplay<P>::drawText(int x, int y, const std::string& text) {
     // Draw glyphs 5x7 with 1px space
     for (char ch : text) {
-        uint8_t c = static_cast<uint8_t>(ch);
-        if (c < 32 || c > 127) c = '?';
-        const uint8_t* glyph = &font5x7[(c - 32) * 5];
+        const uint8_t* glyph = &kFont5x7[fontGlyphIndex(ch) * 5];
         for (int col = 0; col < 5; ++col) {
             uint8_t bits = glyph[col];
             for (int row = 0; row < 7; ++row) {
@@ -126,3 +336,7 @@ void SSD1306::drawText(int x, int y, const std::string& text) {
         x += 6; // 5 + 1 spacing
     }
 }
+
+template class OledDisplay<Ssd1306_128x32>;
+template class OledDisplay<Ssd1306_128x64>;
+template class OledDisplay<Sh1106_128x64>;
@@ -1,36 +1,124 @@
 #pragma once
+#include <array>
 #include <cstdint>
+#include <memory>
 #include <string>
-#include <vector>
+#include "i2c_transport.h"
+#include "panel.h"
 
-// Minimal SSD1306 I2C driver for 128x32 displays (addr 0x3C by default)
-class SSD1306 {
+// Hardware scroll directions. The diagonal ones also move the picture up
+// by the vertical offset on every step.
+enum class ScrollDir : uint8_t { Right, Left, UpRight, UpLeft };
+
+// Minimal I2C driver for SSD1306/SH1106 OLEDs (addr 0x3C by default). The
+// panel type fixes geometry, init values and addressing at compile time;
+// the definitions live in ssd1306.cpp, instantiated for the Panel aliases.
+template <typename P>
+class OledDisplay {
 public:
-    SSD1306(const std::string& i2cDev = "/dev/i2c-1", uint8_t addr = 0x3C);
-    ~SSD1306();
+    using PanelType = P;
+
+    OledDisplay(const std::string& i2cDev = "/dev/i2c-1", uint8_t addr = 0x3C,
+                size_t maxTransfer = I2CTransport::kDefaultMaxTransfer);
+    // Drive the panel through an arbitrary bus (e.g. MockI2CBus)
+    OledDisplay(std::unique_ptr<I2CBus> bus, uint8_t addr = 0x3C,
+                size_t maxTransfer = I2CTransport::kDefaultMaxTransfer);
+    ~OledDisplay();
 
     bool init();
     void clear();
+    // Sends only the page/column windows that changed since the last call.
     void display();
+    // Forget what the panel holds; the next display() resends everything.
+    void invalidate() { shadowValid_ = false; }
+
+    // Controller state, a few command bytes each and no pixel data
+    void setContrast(uint8_t level);
+    void setPower(bool on);
+    void setInverted(bool inverted);
+    // Let the controller scroll pages [page0, page1] on its own, one column
+    // every `frames` panel frames (rounded to the nearest of 2, 3, 4, 5, 25,
+    // 64, 128, 256). False on SH1106, which has no scroll engine. The
+    // scroll rotates GDDRAM by an unknown amount. display() stops it before
+    // writing and leaves the scrolled pages rotated: such a page is resent
+    // whole once something on it changes, and untouched it can be scrolled
+    // on from where it stopped. stopScroll() has them resent by the next
+    // display(). A diagonal scroll moves every row, so after one the next
+    // frame goes out in full.
+    bool startScroll(ScrollDir dir, int page0, int page1, int frames, uint8_t verticalOffset = 0);
+    void stopScroll();
+    bool scrolling() const { return scrolling_; }
+
+    // Bytes written to the bus by the last display() call / since startup
+    size_t lastFrameBytes() const { return lastFrameBytes_; }
+    uint64_t totalBytesSent() const { return totalBytes_; }
+    // Syscall count, flush latency and fallback state of the I2C transport
+    const I2CTransport::Counters& transportCounters() const { return tx_->counters(); }
+
+    // Framebuffer is WIDTH x HEIGHT mono, pages of 8 rows
+    static constexpr int WIDTH = P::WIDTH;
+    static constexpr int HEIGHT = P::HEIGHT;
+    static constexpr int PAGES = P::PAGES;
 
-    // Framebuffer is 128x32 mono, pages of 8 rows => 4 pages * 128 cols
-    static constexpr int WIDTH = 128;
-    static constexpr int HEIGHT = 32;
-    static constexpr int PAGES = HEIGHT / 8;
+    // Raw page-major framebuffer (PAGES rows of WIDTH bytes). Writers
+    // report what they touched with markDirty(), as Canvas does.
+    const uint8_t* buffer() const { return buf_.data(); }
+    uint8_t* buffer() { return buf_.data(); }
+
+    // Columns written since the last display(), per page; display() only
+    // compares that span against what the panel holds
+    void markDirty(int col0, int col1, int page) {
+        if (col0 < dirtyLo_[page]) dirtyLo_[page] = static_cast<int16_t>(col0);
+        if (col1 > dirtyHi_[page]) dirtyHi_[page] = static_cast<int16_t>(col1);
+    }
+    void markAllDirty() {
+        for (int p = 0; p < PAGES; ++p) markDirty(0, WIDTH - 1, p);
+    }
 
     // Pixel operations
     void setPixel(int x, int y, bool on);
     void drawHLine(int x, int y, int w, bool on = true);
     void drawText(int x, int y, const std::string& text); // 5x7 font
-    // Note: For portrait (32x128) rendering, rotate coordinates in caller
-    // mapping (xp,yp) -> (xd,yd) before calling setPixel.
+    // Note: rotated layouts go through Canvas (canvas.h) instead.
 
 private:
-    int fd_ = -1;
+    using Frame = std::array<uint8_t, WIDTH * PAGES>;
+
+    std::unique_ptr<I2CBus> bus_;
+    std::unique_ptr<I2CTransport> tx_;
     uint8_t addr_ = 0x3C;
-    std::vector<uint8_t> buf_; // 128 * 4 bytes
+    Frame buf_{};
+    Frame shadow_{}; // what the panel GDDRAM holds
+    bool shadowValid_ = false;
+    int16_t dirtyLo_[PAGES];
+    int16_t dirtyHi_[PAGES];
+    size_t lastFrameBytes_ = 0;
+    uint64_t totalBytes_ = 0;
+    bool scrolling_ = false;
+    bool scrollVertical_ = false;
+    uint8_t scrollPages_ = 0; // bit per page the running scroll moves
+    uint8_t rotated_ = 0;     // left shifted by a stopped scroll; resent whole on change
+    uint8_t stale_ = 0;       // resent whole by the next display()
 
-    bool writeCmd(uint8_t c);
-    bool writeData(const uint8_t* data, size_t len);
+    // Queue on the transport; nothing reaches the bus until flush()
+    void writeCmds(const uint8_t* cmds, size_t n);
+    void writeData(const uint8_t* data, size_t len);
+    bool flush();
+    // Queue and flush a command-only transfer outside display()
+    bool sendCmds(const uint8_t* cmds, size_t n);
+    void queueWindow(int col0, int col1, int page0, int page1);
+    void clearDirty() {
+        for (int p = 0; p < PAGES; ++p) { dirtyLo_[p] = WIDTH; dirtyHi_[p] = -1; }
+    }
     void initSeq();
+    // The controller no longer scrolls; record what that left behind
+    void scrollStopped();
 };
+
+using SSD1306 = OledDisplay<Ssd1306_128x32>;
+using SSD1306_128x64 = OledDisplay<Ssd1306_128x64>;
+using SH1106 = OledDisplay<Sh1106_128x64>;
+
+extern template class OledDisplay<Ssd1306_128x32>;
+extern template class OledDisplay<Ssd1306_128x64>;
+extern template class OledDisplay<Sh1106_128x64>;
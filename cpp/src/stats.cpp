@@ -1,131 +1,318 @@
 #include "stats.h"
-#include <fstream>
-#include <sstream>
+#include <cstring>
 #include <string>
-#include <array>
 #include <cstdio>
 #include <cstdlib>
 #include <unistd.h>
+#include <fcntl.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
 #include <sys/statvfs.h>
 
-static std::string runCmd(const char* cmd) {
-    std::array<char, 128> buf{};
-    std::string out;
-    FILE* pipe = popen(cmd, "r");
-    if (!pipe) return out;
-    while (fgets(buf.data(), buf.size(), pipe)) out += buf.data();
-    pclose(pipe);
-    // trim
-    while (!out.empty() && (out.back()=='\n' || out.back()=='\r' || out.back()==' ')) out.pop_back();
-    return out;
-}
-
-static int readCpuPercent() {
-    // Simple moving average of /proc/stat over 100ms
-    auto read = [](){
-        std::ifstream f("/proc/stat");
-        std::string cpu; long user=0,nicev=0,sys=0,idle=0,iow=0,irq=0,sirq=0,steal=0,guest=0,nguest=0;
-        f >> cpu >> user >> nicev >> sys >> idle >> iow >> irq >> sirq >> steal >> guest >> nguest;
-        long idleAll = idle + iow;
-        long nonIdle = user + nicev + sys + irq + sirq + steal;
-        long total = idleAll + nonIdle;
-        return std::pair<long,long>(idleAll, total);
+// VideoCore mailbox property interface (see raspberrypi/firmware wiki,
+// "Mailbox property interface"); this is what vcgencmd talks to.
+#define IOCTL_MBOX_PROPERTY _IOWR(100, 0, char*)
+static constexpr uint32_t kMboxRequest = 0x00000000;
+static constexpr uint32_t kMboxSuccess = 0x80000000;
+static constexpr uint32_t kTagGetVoltage = 0x00030003;
+static constexpr uint32_t kTagGetThrottled = 0x00030046;
+static constexpr uint32_t kVoltageIdCore = 1;
+
+static int percentOf(uint64_t part, uint64_t total) {
+    if (total == 0) return 0;
+    return static_cast<int>(100.0 * static_cast<double>(part) / static_cast<double>(total) + 0.5);
+}
+
+bool StatsCollector::readMemInfo(Stats& s) {
+    using namespace procparse;
+    char buf[4096];
+    if (meminfo_.read(buf, sizeof(buf)) <= 0) return false;
+    struct Field { const char* key; uint64_t* dst; };
+    uint64_t swapTotal = 0, swapFree = 0;
+    const Field fields[] = {
+        {"MemTotal:", &s.mem_total_kb},
+        {"MemAvailable:", &s.mem_available_kb},
+        {"Buffers:", &s.mem_buffers_kb},
+        {"Cached:", &s.mem_cached_kb},
+        {"SwapTotal:", &swapTotal},
+        {"SwapFree:", &swapFree},
+        {"Dirty:", &s.mem_dirty_kb},
     };
-    auto p1 = read();
-    usleep(100000);
-    auto p2 = read();
-    long idleDelta = p2.first - p1.first;
-    long totalDelta = p2.second - p1.second;
-    if (totalDelta <= 0) return 0;
-    int cpu = static_cast<int>( (100.0 * (totalDelta - idleDelta)) / totalDelta + 0.5 );
-    if (cpu < 0) cpu = 0; if (cpu > 100) cpu = 100;
-    return cpu;
-}
-
-static int readMemPercent() {
-    std::ifstream f("/proc/meminfo");
-    std::string key; long val; std::string unit;
-    long memTotal=0, memAvail=0;
-    while (f >> key >> val >> unit) {
-        if (key == "MemTotal:") memTotal = val;
-        else if (key == "MemAvailable:") memAvail = val;
-        if (memTotal && memAvail) break;
+    // Keys appear in this order in every kernel since 3.14; scan forward
+    // once and stop after the last one
+    size_t next = 0;
+    constexpr size_t count = sizeof(fields) / sizeof(fields[0]);
+    for (const char* line = buf; line && next < count; line = nextLine(line)) {
+        for (size_t i = next; i < count; ++i) {
+            size_t len = std::strlen(fields[i].key);
+            if (std::strncmp(line, fields[i].key, len) != 0) continue;
+            parseU64(line + len, *fields[i].dst);
+            next = i + 1;
+            break;
+        }
     }
-    if (memTotal == 0) return 0;
-    long used = memTotal - memAvail;
-    return static_cast<int>(100.0 * used / memTotal + 0.5);
+    if (s.mem_total_kb == 0) return false;
+    s.swap_used_kb = swapTotal > swapFree ? swapTotal - swapFree : 0;
+    s.mem_percent = percentOf(s.mem_total_kb - s.mem_available_kb, s.mem_total_kb);
+    return true;
 }
 
 static int readDiskPercent(const char* path = "/") {
     struct statvfs s{};
     if (statvfs(path, &s) != 0) return 0;
-    unsigned long total = s.f_blocks * s.f_frsize;
-    unsigned long avail = s.f_bavail * s.f_frsize;
+    // 64-bit math: f_blocks * f_frsize overflows unsigned long on armhf
+    uint64_t total = static_cast<uint64_t>(s.f_blocks) * s.f_frsize;
+    uint64_t avail = static_cast<uint64_t>(s.f_bavail) * s.f_frsize;
     if (total == 0) return 0;
-    unsigned long used = total - avail;
-    return static_cast<int>(100.0 * used / total + 0.5);
-}
-
-static std::string readCpuFreq() {
-    std::ifstream f("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq");
-    long khz = 0; f >> khz;
-    if (!f) return "N/A";
-    double ghz = khz / 1e6;
-    char buf[16];
-    snprintf(buf, sizeof(buf), "%.1fGHz", ghz);
-    return buf;
-}
-
-static std::string readCpuTemp() {
-    // Prefer vcgencmd; fallback to /sys
-    std::string out = runCmd("vcgencmd measure_temp | cut -d '=' -f2 | tr -d '\n' ");
-    if (!out.empty()) return out;
-    std::ifstream f("/sys/class/thermal/thermal_zone0/temp");
-    long milli = 0; f >> milli;
-    if (!f) return "N/A";
-    char buf[16];
-    snprintf(buf, sizeof(buf), "%ld°C", milli/1000);
-    return buf;
-}
-
-static std::string readIpLastOctet() {
-    std::string ip = runCmd("ip -4 addr show scope global | grep -oP 'inet \\K([0-9.]+)' | head -n1");
-    if (ip.empty()) return "0";
-    auto pos = ip.find_last_of('.');
-    if (pos == std::string::npos) return ip;
-    return ip.substr(pos+1);
-}
-
-static std::string readVoltage() {
-    std::string v = runCmd("vcgencmd measure_volts core | cut -d '=' -f2");
-    if (v.empty()) return "N/A";
-    return v; // typically like 1.2500V
-}
-
-static uint32_t readThrottleRaw() {
-    std::string t = runCmd("vcgencmd get_throttled | cut -d '=' -f2");
-    if (t.empty()) return 0;
-    // Expect 0xNNNNNNNN
-    uint32_t val = 0;
-    if (t.rfind("0x",0)==0) {
-        std::stringstream ss; ss << std::hex << t; ss >> val; return val;
+    return percentOf(total - avail, total);
+}
+
+StatsCollector::StatsCollector(std::string vcioDev, std::string sysRoot, const std::string& procRoot)
+    : vcioDev_(std::move(vcioDev)), sysRoot_(std::move(sysRoot)),
+      cpu_(procRoot + "/stat"), diskio_(procRoot + "/diskstats"), net_(procRoot + "/net/dev"),
+      procs_(procRoot), units_(sysRoot_ + "/fs/cgroup/system.slice"),
+      meminfo_(procRoot + "/meminfo"),
+      freq_(sysRoot_ + "/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq") {
+    for (int r = 0; r < PSI_COUNT; ++r) psi_[r].reset(procRoot + "/pressure/" + psiResourceName(static_cast<PsiResource>(r)));
+    thermalPaths_[0] = sysRoot_ + "/class/thermal/thermal_zone0/temp";
+    for (int i = 1; i < kThermalPaths; ++i) {
+        thermalPaths_[i] = sysRoot_ + "/class/hwmon/hwmon" + std::to_string(i - 1) + "/temp1_input";
     }
-    return val;
 }
 
-Stats collectStats() {
+StatsCollector::~StatsCollector() {
+    if (vcioFd_ >= 0) ::close(vcioFd_);
+}
+
+bool StatsCollector::mailboxProperty(uint32_t tag, uint32_t arg, uint32_t& value) {
+    if (vcioFd_ < 0) {
+        vcioFd_ = ::open(vcioDev_.c_str(), O_RDWR | O_CLOEXEC);
+        if (vcioFd_ < 0) return false;
+    }
+    // [size, code, tag, value buffer size, request size, value0, value1, end tag]
+    alignas(16) uint32_t msg[8] = {
+        sizeof(msg), kMboxRequest, tag, 8, 8, arg, 0, 0
+    };
+    if (ioctl(vcioFd_, IOCTL_MBOX_PROPERTY, msg) < 0) {
+        // Drop the fd; the next call reopens in case the device came back
+        ::close(vcioFd_);
+        vcioFd_ = -1;
+        return false;
+    }
+    if (msg[1] != kMboxSuccess || !(msg[4] & kMboxSuccess)) return false;
+    // GET_VOLTAGE answers (id, value); GET_THROTTLED answers the flags in value0
+    value = (tag == kTagGetThrottled) ? msg[5] : msg[6];
+    return true;
+}
+
+// Sysfs attribute holding one integer (e.g. kHz, millidegrees)
+static bool readSysfsValue(ProcFile& file, uint64_t& value) {
+    char buf[32];
+    if (file.read(buf, sizeof(buf)) <= 0) return false;
+    return procparse::parseU64(buf, value) != nullptr;
+}
+
+bool StatsCollector::readCpuFreq(double& ghz) {
+    uint64_t khz = 0;
+    if (!readSysfsValue(freq_, khz)) return false;
+    ghz = static_cast<double>(khz) / 1e6;
+    return true;
+}
+
+bool StatsCollector::readCpuTemp(double& celsius) {
+    uint64_t milli = 0;
+    if (thermalResolved_ && readSysfsValue(thermal_, milli)) {
+        celsius = static_cast<double>(milli) / 1000.0;
+        return true;
+    }
+    // thermal_zone0 is cpu-thermal on every Pi; hwmon is the fallback on
+    // kernels built without the thermal sysfs class. Resolved once, and
+    // again (at most every kThermalRetry samples) if nothing answers.
+    thermalResolved_ = false;
+    if (thermalRetry_ > 0) {
+        --thermalRetry_;
+        return false;
+    }
+    thermalRetry_ = kThermalRetry;
+    for (const std::string& path : thermalPaths_) {
+        thermal_.reset(path);
+        if (readSysfsValue(thermal_, milli)) {
+            thermalResolved_ = true;
+            celsius = static_cast<double>(milli) / 1000.0;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool readIpLastOctet(char* octet, size_t n) {
+    // Same pick as `ip -4 addr show scope global | head -n1`: first IPv4
+    // address that is neither loopback nor link-local
+    ifaddrs* list = nullptr;
+    if (getifaddrs(&list) != 0) return false;
+    bool found = false;
+    for (ifaddrs* it = list; it; it = it->ifa_next) {
+        if (!it->ifa_addr || it->ifa_addr->sa_family != AF_INET) continue;
+        uint32_t addr = ntohl(reinterpret_cast<sockaddr_in*>(it->ifa_addr)->sin_addr.s_addr);
+        if ((addr >> 24) == 127) continue;            // 127.0.0.0/8 host scope
+        if ((addr >> 16) == 0xA9FE) continue;         // 169.254.0.0/16 link scope
+        std::snprintf(octet, n, "%u", addr & 0xFF);
+        found = true;
+        break;
+    }
+    freeifaddrs(list);
+    return found;
+}
+
+bool StatsCollector::readVoltage(double& volts) {
+    uint32_t microvolts = 0;
+    if (!mailboxProperty(kTagGetVoltage, kVoltageIdCore, microvolts)) return false;
+    volts = static_cast<double>(microvolts) / 1e6;
+    return true;
+}
+
+bool StatsCollector::readThrottleRaw(uint32_t& raw) {
+    return mailboxProperty(kTagGetThrottled, 0, raw);
+}
+
+void formatCpuFreq(const Stats& s, char* out, size_t n) {
+    if (s.has(SRC_FREQ)) snprintf(out, n, "%.1fGHz", s.cpu_freq_ghz);
+    else snprintf(out, n, "N/A");
+}
+
+void formatCpuTemp(const Stats& s, char* out, size_t n) {
+    // vcgencmd measure_temp format
+    if (s.has(SRC_TEMP)) snprintf(out, n, "%.1f'C", s.cpu_temp_c);
+    else snprintf(out, n, "N/A");
+}
+
+void formatVoltage(const Stats& s, char* out, size_t n) {
+    // vcgencmd measure_volts format
+    if (s.has(SRC_VOLTAGE)) snprintf(out, n, "%.4fV", s.voltage_v);
+    else snprintf(out, n, "N/A");
+}
+
+IoTotals ioTotals(const Stats& s) {
+    IoTotals t;
+    for (int i = 0; i < s.disk_io_count; ++i) {
+        const DiskRate& d = s.disk_io[i];
+        if (std::strncmp(d.name, "dm-", 3) == 0 || std::strncmp(d.name, "md", 2) == 0) continue;
+        t.read_bps += d.read_bps;
+        t.write_bps += d.write_bps;
+        t.read_iops += d.read_iops;
+        t.write_iops += d.write_iops;
+    }
+    for (int i = 0; i < s.net_count; ++i) {
+        const NetRate& n = s.net[i];
+        t.rx_bps += n.rx_bps;
+        t.tx_bps += n.tx_bps;
+        t.rx_drops += n.rx_drops;
+        t.tx_drops += n.tx_drops;
+    }
+    return t;
+}
+
+static void setAvailable(Stats& s, StatSource src, bool ok) {
+    s.available = ok ? (s.available | src) : (s.available & ~static_cast<uint32_t>(src));
+}
+
+void StatsCollector::sample(Metric m, Stats& s) {
+    switch (m) {
+        case METRIC_CPU:
+            if (cpu_.sample()) {
+                s.cpu_percent = cpu_.total().percent;
+                s.cpu_iowait_percent = cpu_.total().iowait;
+                s.cpu_steal_percent = cpu_.total().steal;
+                s.cpu_irq_percent = cpu_.total().irq;
+                s.cpu_core_count = cpu_.coreCount();
+                for (int i = 0; i < s.cpu_core_count; ++i) s.cpu_core_percent[i] = cpu_.core(i).percent;
+            }
+            break;
+        case METRIC_MEM:
+            readMemInfo(s);
+            break;
+        case METRIC_DISK:
+            s.disk_percent = readDiskPercent("/");
+            break;
+        case METRIC_FREQ:
+            setAvailable(s, SRC_FREQ, readCpuFreq(s.cpu_freq_ghz));
+            break;
+        case METRIC_TEMP:
+            setAvailable(s, SRC_TEMP, readCpuTemp(s.cpu_temp_c));
+            break;
+        case METRIC_IP: {
+            bool ok = readIpLastOctet(s.ip_last_octet, sizeof(s.ip_last_octet));
+            if (!ok) std::snprintf(s.ip_last_octet, sizeof(s.ip_last_octet), "0");
+            setAvailable(s, SRC_IP, ok);
+            break;
+        }
+        case METRIC_VOLTAGE:
+            setAvailable(s, SRC_VOLTAGE, readVoltage(s.voltage_v));
+            break;
+        case METRIC_THROTTLE:
+            setAvailable(s, SRC_THROTTLE, readThrottleRaw(s.throttle_raw));
+            // Bits of interest (per Raspberry Pi docs):
+            // 0 under-voltage, 1 arm freq capped, 2 currently throttled, 3 soft temp limit active
+            // We'll flag "throttled" if any of these lower bits set.
+            s.throttled = (s.throttle_raw & 0xF) != 0;
+            break;
+        case METRIC_DISKIO:
+            if (diskio_.sample()) {
+                s.disk_io_count = diskio_.count();
+                for (int i = 0; i < s.disk_io_count; ++i) s.disk_io[i] = diskio_.device(i);
+            }
+            break;
+        case METRIC_NET:
+            if (net_.sample()) {
+                s.net_count = net_.count();
+                for (int i = 0; i < s.net_count; ++i) s.net[i] = net_.interface(i);
+            }
+            break;
+        case METRIC_PSI: {
+            bool ok = false;
+            for (int r = 0; r < PSI_COUNT; ++r) ok = readPsi(psi_[r], s.psi[r]) || ok;
+            setAvailable(s, SRC_PSI, ok);
+            break;
+        }
+        case METRIC_PROCS:
+            if (procs_.sample()) {
+                s.proc_count = procs_.processCount();
+                s.proc_scan_us = procs_.scanUs();
+                s.top_count = procs_.topCount();
+                for (int i = 0; i < s.top_count; ++i) {
+                    s.top_cpu[i] = procs_.topCpu(i);
+                    s.top_rss[i] = procs_.topRss(i);
+                }
+            }
+            break;
+        case METRIC_UNITS:
+            if (units_.sample()) {
+                s.unit_count = units_.unitCount();
+                s.unit_top_count = units_.topCount();
+                for (int i = 0; i < s.unit_top_count; ++i) s.units[i] = units_.top(i);
+            }
+            break;
+        case METRIC_COUNT:
+            break;
+    }
+}
+
+Stats StatsCollector::collect() {
     Stats s;
-    s.cpu_percent = readCpuPercent();
-    s.mem_percent = readMemPercent();
-    s.disk_percent = readDiskPercent("/");
-    s.cpu_freq = readCpuFreq();
-    s.cpu_temp = readCpuTemp();
-    s.ip_last_octet = readIpLastOctet();
-    s.voltage = readVoltage();
-    s.throttle_raw = readThrottleRaw();
-    // Bits of interest (per Raspberry Pi docs):
-    // 0 under-voltage, 1 arm freq capped, 2 currently throttled, 3 soft temp limit active
-    // We'll flag "throttled" if any of these lower bits set.
-    s.throttled = (s.throttle_raw & 0xF) != 0;
+    for (int m = 0; m < METRIC_COUNT; ++m) sample(static_cast<Metric>(m), s);
     return s;
 }
+
+const char* metricName(Metric m) {
+    static const char* const names[METRIC_COUNT] = {
+        "cpu", "mem", "disk", "freq", "temp", "ip", "volt", "thr", "dio", "net", "psi", "procs", "units",
+    };
+    return (m >= 0 && m < METRIC_COUNT) ? names[m] : "?";
+}
+
+Stats collectStats() {
+    static StatsCollector collector;
+    return collector.collect();
+}
@@ -1,18 +1,158 @@
 #pragma once
 #include <string>
+#include <type_traits>
+#include <cstddef>
 #include <cstdint>
+#include "cgroup_units.h"
+#include "cpu_sampler.h"
+#include "io_sampler.h"
+#include "proc_top.h"
+#include "psi.h"
+#include "proc_reader.h"
+
+// Sources that may be missing on a given board (no /dev/vcio in a
+// container, no thermal zone, no global IPv4 yet). A cleared bit in
+// Stats::available means "unavailable" and the value field is left at 0.
+enum StatSource : uint32_t {
+    SRC_IP       = 1u << 0,
+    SRC_FREQ     = 1u << 1,
+    SRC_TEMP     = 1u << 2,
+    SRC_VOLTAGE  = 1u << 3,
+    SRC_THROTTLE = 1u << 4,
+    SRC_PSI      = 1u << 5, // kernel built with CONFIG_PSI (and not psi=0)
+};
 
 struct Stats {
-    std::string ip_last_octet; // like Python code shows just last octet
+    char ip_last_octet[4] = "0"; // like Python code shows just last octet
     int cpu_percent = 0;       // 0..100
-    int mem_percent = 0;       // 0..100
+    int cpu_iowait_percent = 0;
+    int cpu_steal_percent = 0;
+    int cpu_irq_percent = 0;   // irq + softirq
+    int cpu_core_count = 0;
+    int cpu_core_percent[CpuSampler::kMaxCores] = {};
+    int mem_percent = 0;       // 0..100 (MemTotal - MemAvailable)
+    uint64_t mem_total_kb = 0;
+    uint64_t mem_available_kb = 0;
+    uint64_t mem_cached_kb = 0;
+    uint64_t mem_buffers_kb = 0;
+    uint64_t mem_dirty_kb = 0;
+    uint64_t swap_used_kb = 0; // SwapTotal - SwapFree
     int disk_percent = 0;      // 0..100
-    std::string cpu_freq;      // e.g. "1.5GHz"
-    std::string cpu_temp;      // e.g. "54°C"
-    std::string voltage;       // e.g. "1.25V"
-    uint32_t throttle_raw = 0; // raw hex flags from vcgencmd get_throttled
+    int disk_io_count = 0;     // whole disks in /proc/diskstats
+    DiskRate disk_io[DiskStatsSampler::kMaxDevices] = {};
+    int net_count = 0;         // interfaces in /proc/net/dev, lo excluded
+    NetRate net[NetDevSampler::kMaxInterfaces] = {};
+    PsiAverages psi[PSI_COUNT] = {}; // /proc/pressure averages, by PsiResource
+    int proc_count = 0;        // processes seen by the last /proc/[pid] scan
+    uint32_t proc_scan_us = 0; // what that scan cost
+    int top_count = 0;         // entries in top_cpu/top_rss
+    ProcessUsage top_cpu[ProcessSampler::kTopN] = {}; // busiest first
+    ProcessUsage top_rss[ProcessSampler::kTopN] = {}; // largest first
+    int unit_count = 0;        // tracked systemd units present in the cgroup tree
+    int unit_top_count = 0;    // entries in units
+    UnitUsage units[CgroupSampler::kTopN] = {}; // busiest first
+    double cpu_freq_ghz = 0.0; // scaling_cur_freq of cpu0
+    double cpu_temp_c = 0.0;   // SoC temperature
+    double voltage_v = 0.0;    // VideoCore core voltage
+    uint32_t throttle_raw = 0; // raw flags from the firmware GET_THROTTLED property
     bool throttled = false;    // any throttling/undervoltage active
+    uint32_t available = 0;    // StatSource bits
+
+    bool has(StatSource src) const { return (available & src) != 0; }
+};
+
+// Snapshots are copied word by word through a seqlock, so no heap members
+static_assert(std::is_trivially_copyable<Stats>::value, "Stats must stay trivially copyable");
+
+// Groups of Stats fields that are sampled together, each on its own period
+enum Metric : int {
+    METRIC_CPU,      // cpu_percent, breakdown, per-core
+    METRIC_MEM,      // mem_percent, meminfo fields
+    METRIC_DISK,     // disk_percent (statvfs, may block on network filesystems)
+    METRIC_FREQ,     // cpu_freq_ghz
+    METRIC_TEMP,     // cpu_temp_c
+    METRIC_IP,       // ip_last_octet
+    METRIC_VOLTAGE,  // voltage_v
+    METRIC_THROTTLE, // throttle_raw, throttled
+    METRIC_DISKIO,   // disk_io rates
+    METRIC_NET,      // net rates
+    METRIC_PSI,      // psi averages
+    METRIC_PROCS,    // proc_count, top_cpu, top_rss (scans every process)
+    METRIC_UNITS,    // unit_count, units (cgroup v2 of the configured units)
+    METRIC_COUNT
+};
+
+// Short name used in env configuration and log lines ("cpu", "disk", ...)
+const char* metricName(Metric m);
+
+// Text forms the log line has always used ("1.5GHz", "54.0'C", "1.2500V"),
+// or "N/A" when the source is unavailable.
+void formatCpuFreq(const Stats& s, char* out, size_t n);
+void formatCpuTemp(const Stats& s, char* out, size_t n);
+void formatVoltage(const Stats& s, char* out, size_t n);
+
+// Totals over physical disks (device-mapper and md devices sit on top of
+// them and would count the same bytes twice) and over all interfaces
+struct IoTotals {
+    uint64_t read_bps = 0, write_bps = 0;
+    uint32_t read_iops = 0, write_iops = 0;
+    uint64_t rx_bps = 0, tx_bps = 0;
+    uint32_t rx_drops = 0, tx_drops = 0;
+};
+IoTotals ioTotals(const Stats& s);
+
+// Reads /proc, sysfs, getifaddrs() and the VideoCore mailbox directly, so a
+// sample never spawns a process. Keeps the mailbox fd and every pseudo-file
+// open between calls. Device paths are injectable so a fake /dev/vcio,
+// sysfs or procfs tree can stand in for the real ones.
+class StatsCollector {
+public:
+    explicit StatsCollector(std::string vcioDev = "/dev/vcio", std::string sysRoot = "/sys",
+                            const std::string& procRoot = "/proc");
+    ~StatsCollector();
+    StatsCollector(const StatsCollector&) = delete;
+    StatsCollector& operator=(const StatsCollector&) = delete;
+
+    // Refresh one metric group in place, leaving other fields untouched
+    void sample(Metric m, Stats& s);
+    // Refresh every metric group
+    Stats collect();
+
+    // Cost above which a process scan backs off (see ProcessSampler); 0 = none
+    void setProcScanBudgetUs(uint32_t us) { procs_.setBudgetUs(us); }
+    // systemd units to account (see CgroupSampler::configure); the slice
+    // defaults to <sysRoot>/fs/cgroup/system.slice
+    void setUnits(const char* units, const std::string& sliceRoot = std::string()) {
+        units_.configure(units, sliceRoot);
+    }
+
+private:
+    std::string vcioDev_;
+    std::string sysRoot_;
+    int vcioFd_ = -1;
+    CpuSampler cpu_;
+    DiskStatsSampler diskio_;
+    NetDevSampler net_;
+    ProcessSampler procs_;
+    CgroupSampler units_;
+    ProcFile psi_[PSI_COUNT];
+    ProcFile meminfo_;
+    ProcFile freq_;
+    ProcFile thermal_;
+    // thermal_zone0, then hwmon0..7; built once so a retry doesn't allocate
+    static constexpr int kThermalPaths = 9;
+    std::string thermalPaths_[kThermalPaths];
+    bool thermalResolved_ = false;
+    static constexpr int kThermalRetry = 60;
+    int thermalRetry_ = 0;
+
+    bool mailboxProperty(uint32_t tag, uint32_t arg, uint32_t& value);
+    bool readMemInfo(Stats& s);
+    bool readCpuFreq(double& ghz);
+    bool readCpuTemp(double& celsius);
+    bool readVoltage(double& volts);
+    bool readThrottleRaw(uint32_t& raw);
 };
 
-// Collect stats from /proc and vcgencmd; all functions are non-throwing
+// Collect stats from a process-wide StatsCollector; non-throwing
 Stats collectStats();
@@ -0,0 +1,330 @@
+#include "trace.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// How one Stats value maps to a trace field
+struct Field {
+    int32_t (*get)(const Stats&);
+    void (*set)(Stats&, int32_t);
+};
+
+int32_t quantise(double v, double scale) { return static_cast<int32_t>(std::lround(v * scale)); }
+
+int32_t clampI32(uint64_t v) { return v > INT32_MAX ? INT32_MAX : static_cast<int32_t>(v); }
+
+template <int I>
+int32_t getCore(const Stats& s) { return s.cpu_core_percent[I]; }
+template <int I>
+void setCore(Stats& s, int32_t v) { s.cpu_core_percent[I] = v; }
+
+// PSI averages in hundredths of a percent
+template <int R, float PsiAverages::*M>
+int32_t getPsi(const Stats& s) { return quantise(static_cast<double>(s.psi[R].*M), 100.0); }
+template <int R, float PsiAverages::*M>
+void setPsi(Stats& s, int32_t v) { s.psi[R].*M = static_cast<float>(v) / 100.f; }
+
+template <int R>
+constexpr Field psiField(int k) {
+    return k == 0   ? Field{getPsi<R, &PsiAverages::some_avg10>, setPsi<R, &PsiAverages::some_avg10>}
+           : k == 1 ? Field{getPsi<R, &PsiAverages::some_avg60>, setPsi<R, &PsiAverages::some_avg60>}
+           : k == 2 ? Field{getPsi<R, &PsiAverages::full_avg10>, setPsi<R, &PsiAverages::full_avg10>}
+                    : Field{getPsi<R, &PsiAverages::full_avg60>, setPsi<R, &PsiAverages::full_avg60>};
+}
+
+// Replayed disks and interfaces come back as one "all" device each
+DiskRate& replayDisk(Stats& s) {
+    if (s.disk_io_count == 0) {
+        s.disk_io_count = 1;
+        std::snprintf(s.disk_io[0].name, sizeof(s.disk_io[0].name), "all");
+    }
+    return s.disk_io[0];
+}
+NetRate& replayNet(Stats& s) {
+    if (s.net_count == 0) {
+        s.net_count = 1;
+        std::snprintf(s.net[0].name, sizeof(s.net[0].name), "all");
+    }
+    return s.net[0];
+}
+
+const Field kFields[] = {
+    {nullptr, nullptr}, // time, handled by the writer and reader
+    {[](const Stats& s) { return static_cast<int32_t>(s.available); },
+     [](Stats& s, int32_t v) { s.available = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return static_cast<int32_t>(std::atoi(s.ip_last_octet)); },
+     [](Stats& s, int32_t v) { std::snprintf(s.ip_last_octet, sizeof(s.ip_last_octet), "%d", v & 0xFF); }},
+    {[](const Stats& s) { return s.cpu_percent; }, [](Stats& s, int32_t v) { s.cpu_percent = v; }},
+    {[](const Stats& s) { return s.cpu_iowait_percent; }, [](Stats& s, int32_t v) { s.cpu_iowait_percent = v; }},
+    {[](const Stats& s) { return s.cpu_steal_percent; }, [](Stats& s, int32_t v) { s.cpu_steal_percent = v; }},
+    {[](const Stats& s) { return s.cpu_irq_percent; }, [](Stats& s, int32_t v) { s.cpu_irq_percent = v; }},
+    {[](const Stats& s) { return s.cpu_core_count; }, [](Stats& s, int32_t v) { s.cpu_core_count = v; }},
+    {getCore<0>, setCore<0>}, {getCore<1>, setCore<1>}, {getCore<2>, setCore<2>}, {getCore<3>, setCore<3>},
+    {getCore<4>, setCore<4>}, {getCore<5>, setCore<5>}, {getCore<6>, setCore<6>}, {getCore<7>, setCore<7>},
+    {[](const Stats& s) { return s.mem_percent; }, [](Stats& s, int32_t v) { s.mem_percent = v; }},
+    {[](const Stats& s) { return clampI32(s.mem_total_kb); },
+     [](Stats& s, int32_t v) { s.mem_total_kb = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return clampI32(s.mem_available_kb); },
+     [](Stats& s, int32_t v) { s.mem_available_kb = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return clampI32(s.mem_cached_kb); },
+     [](Stats& s, int32_t v) { s.mem_cached_kb = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return clampI32(s.mem_buffers_kb); },
+     [](Stats& s, int32_t v) { s.mem_buffers_kb = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return clampI32(s.mem_dirty_kb); },
+     [](Stats& s, int32_t v) { s.mem_dirty_kb = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return clampI32(s.swap_used_kb); },
+     [](Stats& s, int32_t v) { s.swap_used_kb = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return s.disk_percent; }, [](Stats& s, int32_t v) { s.disk_percent = v; }},
+    // MHz, 0.01 'C and 0.1 mV, as precise as the sources
+    {[](const Stats& s) { return quantise(s.cpu_freq_ghz, 1000.0); },
+     [](Stats& s, int32_t v) { s.cpu_freq_ghz = v / 1000.0; }},
+    {[](const Stats& s) { return quantise(s.cpu_temp_c, 100.0); },
+     [](Stats& s, int32_t v) { s.cpu_temp_c = v / 100.0; }},
+    {[](const Stats& s) { return quantise(s.voltage_v, 10000.0); },
+     [](Stats& s, int32_t v) { s.voltage_v = v / 10000.0; }},
+    {[](const Stats& s) { return static_cast<int32_t>(s.throttle_raw); },
+     [](Stats& s, int32_t v) { s.throttle_raw = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return static_cast<int32_t>(s.throttled); },
+     [](Stats& s, int32_t v) { s.throttled = v != 0; }},
+    // Throughput totals in KiB/s and events/s
+    {[](const Stats& s) { return clampI32(ioTotals(s).read_bps / 1024); },
+     [](Stats& s, int32_t v) { replayDisk(s).read_bps = static_cast<uint64_t>(v) * 1024; }},
+    {[](const Stats& s) { return clampI32(ioTotals(s).write_bps / 1024); },
+     [](Stats& s, int32_t v) { replayDisk(s).write_bps = static_cast<uint64_t>(v) * 1024; }},
+    {[](const Stats& s) { return clampI32(ioTotals(s).read_iops); },
+     [](Stats& s, int32_t v) { replayDisk(s).read_iops = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return clampI32(ioTotals(s).write_iops); },
+     [](Stats& s, int32_t v) { replayDisk(s).write_iops = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return clampI32(ioTotals(s).rx_bps / 1024); },
+     [](Stats& s, int32_t v) { replayNet(s).rx_bps = static_cast<uint64_t>(v) * 1024; }},
+    {[](const Stats& s) { return clampI32(ioTotals(s).tx_bps / 1024); },
+     [](Stats& s, int32_t v) { replayNet(s).tx_bps = static_cast<uint64_t>(v) * 1024; }},
+    {[](const Stats& s) { return clampI32(ioTotals(s).rx_drops); },
+     [](Stats& s, int32_t v) { replayNet(s).rx_drops = static_cast<uint32_t>(v); }},
+    {[](const Stats& s) { return clampI32(ioTotals(s).tx_drops); },
+     [](Stats& s, int32_t v) { replayNet(s).tx_drops = static_cast<uint32_t>(v); }},
+    psiField<PSI_CPU>(0), psiField<PSI_CPU>(1), psiField<PSI_CPU>(2), psiField<PSI_CPU>(3),
+    psiField<PSI_MEMORY>(0), psiField<PSI_MEMORY>(1), psiField<PSI_MEMORY>(2), psiField<PSI_MEMORY>(3),
+    psiField<PSI_IO>(0), psiField<PSI_IO>(1), psiField<PSI_IO>(2), psiField<PSI_IO>(3),
+    {[](const Stats& s) { return s.proc_count; }, [](Stats& s, int32_t v) { s.proc_count = v; }},
+    {[](const Stats& s) { return clampI32(s.proc_scan_us); },
+     [](Stats& s, int32_t v) { s.proc_scan_us = static_cast<uint32_t>(v); }},
+};
+
+constexpr int kFieldCount = static_cast<int>(sizeof(kFields) / sizeof(kFields[0]));
+static_assert(kFieldCount <= 64, "TraceWriter/TraceReader keep 64 fields");
+static_assert(PSI_COUNT == 3, "one trace field per PSI average");
+
+// One record; a keyframe takes two
+struct Record {
+    uint16_t kind;
+    int16_t v[kFieldCount];
+};
+
+} // namespace
+
+int trace::fieldCount() { return kFieldCount; }
+size_t trace::recordSize() { return sizeof(Record); }
+
+TraceWriter::~TraceWriter() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool TraceWriter::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat st{};
+    trace::Header h{};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        // Continue a trace of this layout, never overwrite something else
+        bool ok = ::pread(fd, &h, sizeof(h), 0) == static_cast<ssize_t>(sizeof(h)) &&
+                  std::memcmp(h.magic, trace::kMagic, sizeof(h.magic)) == 0 && h.version == trace::kVersion &&
+                  h.fields == kFieldCount && h.recordSize == sizeof(Record);
+        if (!ok) {
+            error = path + ": not a trace of this version";
+            ::close(fd);
+            return false;
+        }
+        off_t body = st.st_size - static_cast<off_t>(sizeof(h));
+        off_t whole = body - body % static_cast<off_t>(sizeof(Record));
+        if (whole != body && ::ftruncate(fd, static_cast<off_t>(sizeof(h)) + whole) != 0) {
+            error = path + ": " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        startUnixMs_ = h.startUnixMs;
+        goodSize_ = static_cast<off_t>(sizeof(h)) + whole;
+    } else {
+        startUnixMs_ = -1; // set by the first sample
+        goodSize_ = 0;
+    }
+    fd_ = fd;
+    torn_ = false;
+    haveLast_ = false;
+    return true;
+}
+
+void TraceWriter::append(int64_t unixMs, const Stats& s) {
+    if (fd_ < 0) return;
+    if (torn_) {
+        // O_APPEND would put the next record after the torn bytes, and every
+        // record from there on would decode misaligned
+        if (::ftruncate(fd_, goodSize_) != 0) {
+            ++errors_;
+            return;
+        }
+        torn_ = false;
+    }
+    if (startUnixMs_ < 0) {
+        trace::Header h{};
+        std::memcpy(h.magic, trace::kMagic, sizeof(h.magic));
+        h.version = trace::kVersion;
+        h.fields = static_cast<uint16_t>(kFieldCount);
+        h.recordSize = static_cast<uint16_t>(sizeof(Record));
+        h.startUnixMs = unixMs;
+        if (::write(fd_, &h, sizeof(h)) != static_cast<ssize_t>(sizeof(h))) {
+            ++errors_;
+            torn_ = true;
+            return;
+        }
+        startUnixMs_ = unixMs;
+        goodSize_ = static_cast<off_t>(sizeof(h));
+    }
+
+    uint32_t cur[kFieldCount];
+    // A clock stepped back keeps the time where it was
+    int64_t t = unixMs - startUnixMs_;
+    cur[0] = static_cast<uint32_t>(t);
+    if (haveLast_ && static_cast<int32_t>(cur[0] - last_[0]) < 0) cur[0] = last_[0];
+    for (int i = 1; i < kFieldCount; ++i) cur[i] = static_cast<uint32_t>(kFields[i].get(s));
+
+    Record rec[2];
+    bool key = !haveLast_ || sinceKey_ >= trace::kKeyInterval;
+    if (!key) {
+        rec[0].kind = trace::DELTA;
+        for (int i = 0; i < kFieldCount && !key; ++i) {
+            int32_t d = static_cast<int32_t>(cur[i] - last_[i]);
+            if (d < INT16_MIN || d > INT16_MAX) key = true;
+            else rec[0].v[i] = static_cast<int16_t>(d);
+        }
+    }
+    if (key) {
+        rec[0].kind = trace::KEY_LO;
+        rec[1].kind = trace::KEY_HI;
+        for (int i = 0; i < kFieldCount; ++i) {
+            rec[0].v[i] = static_cast<int16_t>(static_cast<uint16_t>(cur[i]));
+            rec[1].v[i] = static_cast<int16_t>(static_cast<uint16_t>(cur[i] >> 16));
+        }
+    }
+    size_t n = (key ? 2 : 1) * sizeof(Record);
+    if (::write(fd_, rec, n) != static_cast<ssize_t>(n)) {
+        // A short write leaves a torn record: cut it off before the next
+        // append, which starts over with a keyframe
+        ++errors_;
+        torn_ = true;
+        haveLast_ = false;
+        return;
+    }
+    goodSize_ += static_cast<off_t>(n);
+    std::memcpy(last_, cur, sizeof(cur));
+    haveLast_ = true;
+    sinceKey_ = key ? 0 : sinceKey_ + 1;
+    records_ += key ? 2 : 1;
+}
+
+TraceReader::~TraceReader() {
+    if (map_) ::munmap(const_cast<uint8_t*>(map_), mapSize_);
+}
+
+bool TraceReader::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(trace::Header)) {
+        error = path + ": not a trace";
+        ::close(fd);
+        return false;
+    }
+    void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    trace::Header h;
+    std::memcpy(&h, p, sizeof(h));
+    if (std::memcmp(h.magic, trace::kMagic, sizeof(h.magic)) != 0 || h.version != trace::kVersion ||
+        h.fields != kFieldCount || h.recordSize != sizeof(Record)) {
+        error = path + ": not a trace of this version";
+        ::munmap(p, static_cast<size_t>(st.st_size));
+        return false;
+    }
+    map_ = static_cast<const uint8_t*>(p);
+    mapSize_ = static_cast<size_t>(st.st_size);
+    count_ = (mapSize_ - sizeof(h)) / sizeof(Record);
+    startUnixMs_ = h.startUnixMs;
+    rewind();
+    return true;
+}
+
+void TraceReader::rewind() {
+    pos_ = 0;
+    haveKey_ = false;
+    timeMs_ = 0;
+}
+
+// Field 0 wraps at 32 bits (49 days); the step from the previous sample
+// unwraps it. Time never goes back, as when a later append started behind
+// the clock of the one before.
+void TraceReader::advanceTime(uint32_t prevTime) {
+    int32_t d = static_cast<int32_t>(cur_[0] - prevTime);
+    if (d > 0) timeMs_ += static_cast<uint64_t>(d);
+}
+
+bool TraceReader::next(Stats& s, int64_t& unixMs) {
+    Record rec;
+    auto load = [&](size_t i) {
+        std::memcpy(&rec, map_ + sizeof(trace::Header) + i * sizeof(Record), sizeof(Record));
+    };
+    while (pos_ < count_) {
+        load(pos_++);
+        uint32_t prevTime = cur_[0];
+        if (rec.kind == trace::KEY_LO && pos_ < count_) {
+            uint16_t lo[kFieldCount];
+            for (int i = 0; i < kFieldCount; ++i) lo[i] = static_cast<uint16_t>(rec.v[i]);
+            load(pos_);
+            if (rec.kind != trace::KEY_HI) continue; // torn keyframe
+            ++pos_;
+            for (int i = 0; i < kFieldCount; ++i) {
+                cur_[i] = static_cast<uint32_t>(static_cast<uint16_t>(rec.v[i])) << 16 | lo[i];
+            }
+            if (!haveKey_) timeMs_ = cur_[0];
+            else advanceTime(prevTime);
+            haveKey_ = true;
+        } else if (rec.kind == trace::DELTA && haveKey_) {
+            for (int i = 0; i < kFieldCount; ++i) cur_[i] += static_cast<uint32_t>(static_cast<int32_t>(rec.v[i]));
+            advanceTime(prevTime);
+        } else {
+            continue;
+        }
+        s = Stats{};
+        for (int i = 1; i < kFieldCount; ++i) kFields[i].set(s, static_cast<int32_t>(cur_[i]));
+        unixMs = startUnixMs_ + static_cast<int64_t>(timeMs_);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "stats.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+// Stats sample traces for --record/--replay.
+//
+// A trace is a 32-byte header followed by fixed-size records, each a kind
+// word and one 16-bit slot per field. Fields are the numeric Stats values
+// quantised to integers (no strings: the IP becomes its last octet, disks
+// and interfaces their totals, and process names are not kept). A DELTA
+// record holds each field's change from the previous sample; a keyframe
+// takes two records (KEY_LO, KEY_HI) with the absolute low and high halves.
+// Keyframes start every file append, follow any change too large for 16
+// bits and recur every kKeyInterval samples, so the file stays a plain
+// array of equal records that can be mapped and decoded from any keyframe.
+namespace trace {
+
+constexpr char kMagic[8] = {'R', 'P', 'S', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t kVersion = 1;
+constexpr int kKeyInterval = 600;
+
+enum Kind : uint16_t { DELTA = 0x4444, KEY_LO = 0x4B4C, KEY_HI = 0x4B48 }; // "DD", "LK", "HK"
+
+// Field 0 is the sample time in ms since Header::startUnixMs
+int fieldCount();
+size_t recordSize();
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint16_t fields;
+    uint16_t recordSize;
+    int64_t startUnixMs; // wall clock of the first sample ever written
+    uint8_t reserved[8];
+};
+static_assert(sizeof(Header) == 32, "trace header layout");
+
+} // namespace trace
+
+// Appends samples to a trace file, creating it if needed. An existing trace
+// with the same layout is continued (a torn last record is cut off); any
+// other file is left alone and open() fails. One write() per sample; after
+// a short write the file is cut back to its last whole record before the
+// next one goes in.
+class TraceWriter {
+public:
+    TraceWriter() = default;
+    ~TraceWriter();
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+    void append(int64_t unixMs, const Stats& s);
+    uint64_t records() const { return records_; }
+    uint64_t errors() const { return errors_; }
+
+private:
+    int fd_ = -1;
+    int64_t startUnixMs_ = 0;
+    off_t goodSize_ = 0; // file size after the last complete write
+    bool torn_ = false;  // a write since then was short
+    bool haveLast_ = false;
+    int sinceKey_ = 0;
+    uint32_t last_[64] = {};
+    uint64_t records_ = 0;
+    uint64_t errors_ = 0;
+};
+
+// Read-only mapping of a trace; samples are decoded in order
+class TraceReader {
+public:
+    TraceReader() = default;
+    ~TraceReader();
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+    // Records in the file (a keyframe counts two)
+    size_t records() const { return count_; }
+
+    // Decode the next sample into s (fields the trace doesn't keep are left
+    // at their defaults); false at the end. Deltas before the first keyframe
+    // are skipped.
+    bool next(Stats& s, int64_t& unixMs);
+    void rewind();
+
+private:
+    const uint8_t* map_ = nullptr;
+    size_t mapSize_ = 0;
+    size_t count_ = 0;
+    size_t pos_ = 0;
+    int64_t startUnixMs_ = 0;
+    bool haveKey_ = false;
+    uint64_t timeMs_ = 0; // field 0 unwrapped to 64 bits
+    uint32_t cur_[64] = {};
+
+    void advanceTime(uint32_t prevTime);
+};
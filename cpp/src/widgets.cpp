@@ -0,0 +1,469 @@
+#include "widgets.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+Page PageRotator::at(uint64_t elapsedNs) const {
+    uint64_t period = static_cast<uint64_t>(periodMs) * 1000000ull;
+    return order[(elapsedNs / period) % static_cast<uint64_t>(count)];
+}
+
+void PageRotator::drop(Page p) {
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        if (order[i] != p) order[n++] = order[i];
+    }
+    if (n > 0) count = n;
+}
+
+// Inputs of bar/ring/spark widgets
+enum : uint8_t { IN_CPU, IN_MEM, IN_DISK, IN_TEMP };
+
+static const struct { const char* name; Page page; } kPageNames[] = {
+    {"main", Page::Main}, {"thermal", Page::Thermal}, {"io", Page::Io}, {"procs", Page::Procs}, {"cluster", Page::Cluster},
+    {"units", Page::Units},
+};
+
+// Text of a {field} placeholder; percentages read "42%" like {cpu}
+static const char* textField(const ScreenView& v, const char* key, size_t len, char* tmp, size_t cap) {
+    auto is = [&](const char* name) { return std::strlen(name) == len && std::strncmp(key, name, len) == 0; };
+    if (is("ip")) return v.ip;
+    if (is("freq")) return v.freq;
+    if (is("cpu")) return v.cpu;
+    if (is("mem")) { std::snprintf(tmp, cap, "%d%%", v.memPercent); return tmp; }
+    if (is("disk")) { std::snprintf(tmp, cap, "%d%%", v.diskPercent); return tmp; }
+    if (is("line1")) return v.line1;
+    if (is("line2")) return v.line2;
+    if (is("temp")) return v.temp;
+    if (is("power")) return v.power;
+    if (is("diskio")) return v.diskIo;
+    if (is("netio")) return v.netIo;
+    if (is("top1")) return v.top1;
+    if (is("top2")) return v.top2;
+    if (is("cluster")) return v.cluster;
+    if (is("unit1")) return v.unit1;
+    if (is("unit2")) return v.unit2;
+    return nullptr;
+}
+
+// Expand {field} placeholders; unknown ones (rejected at load) stay literal
+static void expand(const char* fmt, const ScreenView& v, char* out, size_t cap) {
+    size_t n = 0;
+    for (const char* p = fmt; *p && n + 1 < cap;) {
+        const char* close = *p == '{' ? std::strchr(p, '}') : nullptr;
+        char tmp[16];
+        const char* val = close ? textField(v, p + 1, static_cast<size_t>(close - p - 1), tmp, sizeof(tmp)) : nullptr;
+        if (!val) {
+            out[n++] = *p++;
+            continue;
+        }
+        while (*val && n + 1 < cap) out[n++] = *val++;
+        p = close + 1;
+    }
+    out[n] = '\0';
+}
+
+static int percentOf(const ScreenView& v, uint8_t in) {
+    return in == IN_MEM ? v.memPercent : (in == IN_DISK ? v.diskPercent : v.cpuPercent);
+}
+
+static bool overlaps(const Widget::Box& a, const Widget::Box& b) {
+    return a.w > 0 && b.w > 0 && a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+// Box and value the widget would draw for `v` on a W-wide canvas
+template <typename Cv>
+static void evaluate(const Widget& w, const ScreenView& v, Widget::Box& box, char* value) {
+    std::memset(value, 0, sizeof(w.value));
+    switch (w.kind) {
+        case Widget::TEXT: {
+            expand(w.format, v, value, sizeof(w.value));
+            int n = static_cast<int>(std::strlen(value));
+            int width = n ? (n * 6 - 1) * w.scale : 0;
+            int x = w.x;
+            if (w.align == Widget::CENTER) {
+                // Same rounding as Canvas::textCentered at scale 1
+                x = w.scale == 1 ? (Cv::W - n * 6) / 2 : (Cv::W - width) / 2;
+                if (x < 0) x = 0;
+            } else if (w.align == Widget::RIGHT) {
+                x = Cv::W - w.x - width;
+            }
+            box = {static_cast<int16_t>(x), w.y, static_cast<int16_t>(width), static_cast<int16_t>(7 * w.scale)};
+            break;
+        }
+        case Widget::FIT:
+            expand(w.format, v, value, sizeof(w.value));
+            box = {0, w.y, static_cast<int16_t>(Cv::W), w.h};
+            break;
+        case Widget::BAR:
+            std::snprintf(value, sizeof(w.value), "%d", percentOf(v, w.source));
+            box = {w.x, w.y, w.w, w.h};
+            break;
+        case Widget::RING: {
+            std::snprintf(value, sizeof(w.value), "%d", percentOf(v, w.source));
+            int r = w.w;
+            box = {static_cast<int16_t>(w.x - r), static_cast<int16_t>(w.y - r), static_cast<int16_t>(2 * r + 1),
+                   static_cast<int16_t>(2 * r + 1)};
+            break;
+        }
+        case Widget::SPARK:
+            static_assert(sizeof(Widget::value) >= ScreenView::kSparkSamples, "spark value does not fit");
+            std::memcpy(value, w.source == IN_TEMP ? v.tempSpark : v.cpuSpark, ScreenView::kSparkSamples);
+            box = {w.x, w.y, static_cast<int16_t>(ScreenView::kSparkSamples * w.scale),
+                   static_cast<int16_t>(ScreenView::kSparkHeight * w.yscale)};
+            break;
+        case Widget::ICON:
+            box = {w.x, w.y, 11, 7};
+            break;
+        case Widget::RULE:
+            box = {w.x, w.y, w.w, w.h};
+            break;
+        case Widget::STALL:
+            value[0] = static_cast<char>('0' + v.stall);
+            box = {0, w.y, static_cast<int16_t>(Cv::W), w.h};
+            break;
+        case Widget::NODES:
+            static_assert(sizeof(Widget::value) > ClusterSummary::kMaxBars, "node bars do not fit");
+            value[0] = static_cast<char>(v.nodeBars);
+            std::memcpy(value + 1, v.nodeCpu, ClusterSummary::kMaxBars);
+            box = {w.x, w.y, w.w, w.h};
+            break;
+    }
+}
+
+template <typename Cv>
+static void draw(Cv& canvas, const Widget& w, const Widget::Box& box, const char* value) {
+    auto plot = [&](int x, int y) { canvas.setPixel(x, y); };
+    switch (w.kind) {
+        case Widget::TEXT:
+            if (w.scale == 1) canvas.text(box.x, box.y, value);
+            else canvas.scaledText(box.x, box.y, value, w.scale);
+            break;
+        case Widget::FIT:
+            canvas.textFit(value, w.y, w.h);
+            break;
+        case Widget::BAR:
+            gauge::drawBar(w.x, w.y, w.w, w.h, std::atoi(value), plot);
+            break;
+        case Widget::RING:
+            if (w.w == 15) gauge::drawRing(kCpuRing, w.x, w.y, std::atoi(value), plot);
+            else gauge::drawRing(kCpuRingWide, w.x, w.y, std::atoi(value), plot);
+            break;
+        case Widget::SPARK:
+            drawSparkline(canvas, w.x, w.y, reinterpret_cast<const uint8_t*>(value), w.scale, w.yscale);
+            break;
+        case Widget::ICON:
+            drawWarnIcon(canvas, w.x, w.y);
+            break;
+        case Widget::RULE:
+            canvas.fillRect(w.x, w.y, w.w, w.h);
+            break;
+        case Widget::STALL:
+            drawStallOverlay(canvas, w.y, w.h, static_cast<uint8_t>(value[0] - '0'));
+            break;
+        case Widget::NODES:
+            drawNodeBars(canvas, w.x, w.y, w.w, w.h, reinterpret_cast<const uint8_t*>(value + 1),
+                         static_cast<uint8_t>(value[0]));
+            break;
+    }
+}
+
+template <typename Cv>
+void WidgetTree::render(Cv& canvas, const ScreenView& v) {
+    const int n = static_cast<int>(widgets.size());
+    bool visible[kMaxWidgets], dirty[kMaxWidgets];
+    Widget::Box box[kMaxWidgets];
+    char value[kMaxWidgets][sizeof(Widget::value)];
+
+    for (int i = 0; i < n; ++i) {
+        const Widget& w = widgets[static_cast<size_t>(i)];
+        bool cond = w.cond == Widget::IF_WARNING ? v.warning : (w.cond == Widget::IF_STALL ? v.stall != 0 : true);
+        visible[i] = cond && ((w.pages >> static_cast<int>(v.page)) & 1u);
+        if (visible[i]) evaluate<Cv>(w, v, box[i], value[i]);
+        dirty[i] = fresh_ || visible[i] != w.visible ||
+                   (visible[i] && (!(box[i] == w.drawn) || std::memcmp(value[i], w.value, sizeof(w.value)) != 0));
+    }
+
+    // Clearing a dirty box erases whatever else was drawn there, so those
+    // widgets redraw too; repeat until nothing new is pulled in
+    for (bool grew = !fresh_; grew;) {
+        grew = false;
+        for (int i = 0; i < n; ++i) {
+            if (!dirty[i]) continue;
+            const Widget& wi = widgets[static_cast<size_t>(i)];
+            for (int j = 0; j < n; ++j) {
+                if (dirty[j] || !visible[j]) continue;
+                if ((wi.visible && overlaps(wi.drawn, box[j])) || (visible[i] && overlaps(box[i], box[j]))) {
+                    dirty[j] = true;
+                    grew = true;
+                }
+            }
+        }
+    }
+
+    if (fresh_) canvas.clear();
+    for (int i = 0; i < n && !fresh_; ++i) {
+        const Widget& w = widgets[static_cast<size_t>(i)];
+        if (!dirty[i] || !w.visible) continue;
+        canvas.fillRect(w.drawn.x, w.drawn.y, w.drawn.w, w.drawn.h, false);
+        canvas.markDirty(w.drawn.x, w.drawn.y, w.drawn.w, w.drawn.h);
+    }
+    // Draw in file order, so later widgets stay on top as in a full redraw
+    for (int i = 0; i < n; ++i) {
+        if (!dirty[i]) continue;
+        Widget& w = widgets[static_cast<size_t>(i)];
+        w.visible = visible[i];
+        if (!visible[i]) continue;
+        draw(canvas, w, box[i], value[i]);
+        canvas.markDirty(box[i].x, box[i].y, box[i].w, box[i].h);
+        w.drawn = box[i];
+        std::memcpy(w.value, value[i], sizeof(w.value));
+    }
+    fresh_ = false;
+}
+
+template void WidgetTree::render(Canvas<Ssd1306_128x32, Rotation::Portrait>&, const ScreenView&);
+template void WidgetTree::render(Canvas<Ssd1306_128x64, Rotation::Portrait>&, const ScreenView&);
+template void WidgetTree::render(Canvas<Sh1106_128x64, Rotation::Portrait>&, const ScreenView&);
+template void WidgetTree::render(Canvas<Ssd1306_128x32, Rotation::Landscape>&, const ScreenView&);
+template void WidgetTree::render(Canvas<Ssd1306_128x64, Rotation::Landscape>&, const ScreenView&);
+template void WidgetTree::render(Canvas<Sh1106_128x64, Rotation::Landscape>&, const ScreenView&);
+
+const WidgetTree* LayoutFile::find(int w, int h) const {
+    for (const Section& s : sections) {
+        if (s.w == w && s.h == h) return &s.tree;
+    }
+    return nullptr;
+}
+
+// --- Parsing ----------------------------------------------------------------
+
+namespace {
+
+struct LineParser {
+    static constexpr int kMaxTokens = 24;
+    char* tok[kMaxTokens];
+    int count = 0;
+    char error[96] = "";
+
+    explicit LineParser(char* line) {
+        for (char* p = std::strtok(line, " \t\r\n"); p && count < kMaxTokens; p = std::strtok(nullptr, " \t\r\n")) {
+            tok[count++] = p;
+        }
+    }
+
+    bool fail(const char* fmt, const char* arg = "") {
+        std::snprintf(error, sizeof(error), fmt, arg);
+        return false;
+    }
+
+    bool number(int i, int lo, int hi, int16_t& out) {
+        if (i >= count) return fail("missing number");
+        char* end = nullptr;
+        long v = std::strtol(tok[i], &end, 10);
+        if (*end || v < lo || v > hi) return fail("bad number '%s'", tok[i]);
+        out = static_cast<int16_t>(v);
+        return true;
+    }
+
+    bool source(int i, bool spark, uint8_t& out) {
+        if (i >= count) return fail("missing source");
+        const char* s = tok[i];
+        if (std::strcmp(s, "cpu") == 0) out = IN_CPU;
+        else if (!spark && std::strcmp(s, "mem") == 0) out = IN_MEM;
+        else if (!spark && std::strcmp(s, "disk") == 0) out = IN_DISK;
+        else if (spark && std::strcmp(s, "temp") == 0) out = IN_TEMP;
+        else return fail("unknown source '%s'", s);
+        return true;
+    }
+
+    bool pages(const char* list, uint8_t& mask, Page* order, int* n) {
+        mask = 0;
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%s", list);
+        for (char* save = nullptr, *p = strtok_r(buf, ",+", &save); p; p = strtok_r(nullptr, ",+", &save)) {
+            bool found = false;
+            for (const auto& pn : kPageNames) {
+                if (std::strcmp(p, pn.name) != 0) continue;
+                mask = static_cast<uint8_t>(mask | (1u << static_cast<int>(pn.page)));
+                if (order && *n < static_cast<int>(Page::Count)) order[(*n)++] = pn.page;
+                found = true;
+            }
+            if (!found) return fail("unknown page '%s'", p);
+        }
+        return mask != 0 || fail("empty page list");
+    }
+};
+
+bool validFormat(const char* fmt) {
+    ScreenView probe;
+    char tmp[16];
+    for (const char* p = std::strchr(fmt, '{'); p; p = std::strchr(p + 1, '{')) {
+        const char* close = std::strchr(p, '}');
+        if (!close || !textField(probe, p + 1, static_cast<size_t>(close - p - 1), tmp, sizeof(tmp))) return false;
+    }
+    return true;
+}
+
+// Widget line after the kind keyword; trailing key=value tokens are options
+bool parseWidget(LineParser& lp, Widget& w) {
+    const char* kind = lp.tok[0];
+    int end = lp.count;
+    while (end > 1) {
+        const char* t = lp.tok[end - 1];
+        const char* eq = std::strchr(t, '=');
+        if (!eq) break;
+        std::string key(t, static_cast<size_t>(eq - t));
+        const char* val = eq + 1;
+        if (key == "page") {
+            if (!lp.pages(val, w.pages, nullptr, nullptr)) return false;
+        } else if (key == "if") {
+            if (std::strcmp(val, "warning") == 0) w.cond = Widget::IF_WARNING;
+            else if (std::strcmp(val, "stall") == 0) w.cond = Widget::IF_STALL;
+            else return lp.fail("unknown condition '%s'", val);
+        } else if (key == "scale" || key == "xs" || key == "ys") {
+            long v = std::atol(val);
+            if (v < 1 || v > 6) return lp.fail("bad %s", key.c_str());
+            if (key == "ys") w.yscale = static_cast<uint8_t>(v);
+            else w.scale = static_cast<uint8_t>(v);
+        } else {
+            break; // not an option: part of the text
+        }
+        --end;
+    }
+    lp.count = end;
+
+    // Rest of the line from token i, single-spaced
+    auto format = [&](int i) {
+        if (i >= lp.count) return lp.fail("missing text");
+        w.format[0] = '\0';
+        for (int k = i; k < lp.count; ++k) {
+            if (k > i) std::strncat(w.format, " ", sizeof(w.format) - std::strlen(w.format) - 1);
+            std::strncat(w.format, lp.tok[k], sizeof(w.format) - std::strlen(w.format) - 1);
+        }
+        return validFormat(w.format) || lp.fail("unknown {field} in '%s'", w.format);
+    };
+
+    constexpr int kMax = 255;
+    if (std::strcmp(kind, "text") == 0) {
+        w.kind = Widget::TEXT;
+        const char* x = lp.count > 1 ? lp.tok[1] : "";
+        if (std::strcmp(x, "c") == 0) {
+            w.align = Widget::CENTER;
+        } else if (x[0] == 'r') {
+            w.align = Widget::RIGHT;
+            lp.tok[1] = const_cast<char*>(x + 1);
+            if (!lp.number(1, 0, kMax, w.x)) return false;
+        } else if (!lp.number(1, -kMax, kMax, w.x)) {
+            return false;
+        }
+        return lp.number(2, -kMax, kMax, w.y) && format(3);
+    }
+    if (std::strcmp(kind, "fit") == 0) {
+        w.kind = Widget::FIT;
+        return lp.number(1, 0, kMax, w.y) && lp.number(2, 7, kMax, w.h) && format(3);
+    }
+    if (std::strcmp(kind, "bar") == 0) {
+        w.kind = Widget::BAR;
+        return lp.number(1, -kMax, kMax, w.x) && lp.number(2, -kMax, kMax, w.y) && lp.number(3, 3, kMax, w.w) &&
+               lp.number(4, 3, kMax, w.h) && lp.source(5, false, w.source);
+    }
+    if (std::strcmp(kind, "ring") == 0) {
+        w.kind = Widget::RING;
+        if (!lp.number(1, -kMax, kMax, w.x) || !lp.number(2, -kMax, kMax, w.y)) return false;
+        const char* size = lp.count > 3 ? lp.tok[3] : "";
+        if (std::strcmp(size, "small") == 0) w.w = 15;
+        else if (std::strcmp(size, "large") == 0) w.w = 20;
+        else return lp.fail("ring size must be small or large");
+        return lp.source(4, false, w.source);
+    }
+    if (std::strcmp(kind, "spark") == 0) {
+        w.kind = Widget::SPARK;
+        return lp.number(1, -kMax, kMax, w.x) && lp.number(2, -kMax, kMax, w.y) && lp.source(3, true, w.source);
+    }
+    if (std::strcmp(kind, "icon") == 0) {
+        w.kind = Widget::ICON;
+        if (!lp.number(1, -kMax, kMax, w.x) || !lp.number(2, -kMax, kMax, w.y)) return false;
+        if (lp.count < 4 || std::strcmp(lp.tok[3], "warn") != 0) return lp.fail("unknown icon");
+        return true;
+    }
+    if (std::strcmp(kind, "rule") == 0) {
+        w.kind = Widget::RULE;
+        return lp.number(1, -kMax, kMax, w.x) && lp.number(2, -kMax, kMax, w.y) && lp.number(3, 1, kMax, w.w) &&
+               lp.number(4, 1, kMax, w.h);
+    }
+    if (std::strcmp(kind, "stall") == 0) {
+        w.kind = Widget::STALL;
+        w.cond = Widget::IF_STALL;
+        return lp.number(1, 0, kMax, w.y) && lp.number(2, 12, kMax, w.h);
+    }
+    if (std::strcmp(kind, "nodes") == 0) {
+        w.kind = Widget::NODES;
+        return lp.number(1, -kMax, kMax, w.x) && lp.number(2, -kMax, kMax, w.y) &&
+               lp.number(3, ClusterSummary::kMaxBars * 2, kMax, w.w) && lp.number(4, 2, kMax, w.h);
+    }
+    return lp.fail("unknown widget '%s'", kind);
+}
+
+} // namespace
+
+bool loadLayoutFile(const char* path, LayoutFile& out, std::string& error) {
+    FILE* f = std::fopen(path, "re");
+    if (!f) {
+        error = std::string("cannot open ") + path + ": " + std::strerror(errno);
+        return false;
+    }
+    out = LayoutFile{};
+    char line[256];
+    int lineNo = 0;
+    bool ok = true;
+    while (ok && std::fgets(line, sizeof(line), f)) {
+        ++lineNo;
+        char* p = line + std::strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+        LineParser lp(p);
+        const char* what = lp.error;
+
+        if (lp.tok[0][0] == '[') {
+            LayoutFile::Section s;
+            char close = 0;
+            if (std::sscanf(lp.tok[0], "[%dx%d%c", &s.w, &s.h, &close) != 3 || close != ']' || s.w <= 0 || s.h <= 0) {
+                what = "bad section header";
+                ok = false;
+            } else {
+                out.sections.push_back(s);
+            }
+        } else if (std::strcmp(lp.tok[0], "pages") == 0) {
+            PageRotator& r = out.rotator;
+            uint8_t mask = 0;
+            r.count = 0;
+            ok = lp.count >= 2 && lp.pages(lp.tok[1], mask, r.order, &r.count);
+            if (!ok && lp.count < 2) what = "missing page list";
+            for (int i = 2; ok && i < lp.count; ++i) {
+                long ms = std::strncmp(lp.tok[i], "period=", 7) == 0 ? std::atol(lp.tok[i] + 7) : 0;
+                if (ms < 500 || ms > 600000) {
+                    what = "period must be 500..600000 ms";
+                    ok = false;
+                } else {
+                    r.periodMs = static_cast<uint32_t>(ms);
+                }
+            }
+        } else if (out.sections.empty()) {
+            what = "widget outside a [WxH] section";
+            ok = false;
+        } else {
+            WidgetTree& tree = out.sections.back().tree;
+            Widget w;
+            ok = parseWidget(lp, w);
+            if (ok && static_cast<int>(tree.widgets.size()) >= WidgetTree::kMaxWidgets) {
+                what = "too many widgets in section";
+                ok = false;
+            }
+            if (ok) tree.widgets.push_back(w);
+        }
+        if (!ok) error = std::string(path) + ":" + std::to_string(lineNo) + ": " + what;
+    }
+    std::fclose(f);
+    return ok;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "layout.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Order and dwell time of the lower-section pages. A layout file's "pages"
+// line replaces the default Main -> Thermal -> Io -> Procs -> Cluster ->
+// Units rotation every 6 s.
+struct PageRotator {
+    Page order[static_cast<int>(Page::Count)] = {Page::Main, Page::Thermal, Page::Io, Page::Procs, Page::Cluster,
+                                               Page::Units};
+    int count = static_cast<int>(Page::Count);
+    uint32_t periodMs = 6000;
+
+    Page at(uint64_t elapsedNs) const;
+    // Take a page out of the rotation (one with nothing to show); the last
+    // page stays
+    void drop(Page p);
+};
+
+// One retained element of a layout. Besides its description it keeps what
+// it drew last and where (logical canvas coordinates), so a frame only
+// re-rasterises widgets whose value moved, plus whatever they overlap.
+struct Widget {
+    enum Kind : uint8_t { TEXT, FIT, BAR, RING, SPARK, ICON, RULE, STALL, NODES };
+    enum Align : uint8_t { LEFT, CENTER, RIGHT };
+    enum Cond : uint8_t { ALWAYS, IF_WARNING, IF_STALL };
+    struct Box {
+        int16_t x = 0, y = 0, w = 0, h = 0;
+        bool operator==(const Box& o) const { return x == o.x && y == o.y && w == o.w && h == o.h; }
+    };
+
+    Kind kind = TEXT;
+    Align align = LEFT;
+    Cond cond = ALWAYS;
+    uint8_t pages = 0xFF;  // 1 << Page it shows on
+    uint8_t source = 0;    // bar/ring/spark input (widgets.cpp)
+    uint8_t scale = 1;     // text scale, or sparkline column width
+    uint8_t yscale = 1;    // sparkline height scale
+    int16_t x = 0, y = 0, w = 0, h = 0;
+    char format[32] = "";  // TEXT/FIT: literal text with {field} placeholders
+
+    bool visible = false;
+    Box drawn;             // box covered last frame (when visible)
+    char value[32] = {};   // value drawn last frame
+};
+
+// A retained layout for one canvas size. render() leaves the canvas as a
+// full redraw would, touching only dirty widgets' boxes, and reports those
+// boxes through Canvas::markDirty so the panel diff skips everything else.
+class WidgetTree {
+public:
+    static constexpr int kMaxWidgets = 48;
+
+    std::vector<Widget> widgets;
+
+    template <typename Cv>
+    void render(Cv& canvas, const ScreenView& v);
+    // Next render() starts from a cleared canvas
+    void invalidate() { fresh_ = true; }
+
+private:
+    bool fresh_ = true;
+};
+
+// Layout file: an optional "pages" line, then one "[WxH]" section per
+// logical canvas size (32x128 portrait, 128x32 landscape, ...).
+//
+//   pages main,io period=4000
+//   [32x128]
+//   fit 0 26 {ip}
+//   text c 30 {freq}
+//   ring 16 64 small cpu
+//   icon 2 101 warn page=main if=warning
+//
+// See README for every widget and option.
+struct LayoutFile {
+    PageRotator rotator;
+    struct Section {
+        int w = 0, h = 0;
+        WidgetTree tree;
+    };
+    std::vector<Section> sections;
+
+    const WidgetTree* find(int w, int h) const;
+};
+
+// Parse `path`; on failure `error` says which line and why
+bool loadLayoutFile(const char* path, LayoutFile& out, std::string& error);
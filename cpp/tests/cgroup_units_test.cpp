@@ -0,0 +1,114 @@
+// CgroupSampler on a plain directory tree standing in for the slice: units
+// created and removed while sampling, rates against the previous sample,
+// and the slice itself disappearing and coming back.
+#include "cgroup_units.h"
+#include "check.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+void writeFile(const std::string& path, const char* text) {
+    if (FILE* f = std::fopen(path.c_str(), "w")) {
+        std::fputs(text, f);
+        std::fclose(f);
+    }
+}
+
+// cpu.stat, memory.current and io.stat the way cgroupfs lays them out
+void writeUnit(const std::string& dir, unsigned long long usageUsec, unsigned long long rbytes) {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "usage_usec %llu\nuser_usec 0\nsystem_usec 0\n", usageUsec);
+    writeFile(dir + "/cpu.stat", buf);
+    writeFile(dir + "/memory.current", "8388608\n");
+    std::snprintf(buf, sizeof(buf), "8:0 rbytes=%llu wbytes=0 rios=0 wios=0 dbytes=0 dios=0\n", rbytes);
+    writeFile(dir + "/io.stat", buf);
+}
+
+void addUnit(const std::string& dir) {
+    mkdir(dir.c_str(), 0755);
+    writeUnit(dir, 0, 0);
+}
+
+void removeUnit(const std::string& dir) {
+    for (const char* f : {"/cpu.stat", "/memory.current", "/io.stat"}) unlink((dir + f).c_str());
+    rmdir(dir.c_str());
+}
+
+void sleepMs(long ms) {
+    timespec ts{ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, nullptr);
+}
+
+} // namespace
+
+int main() {
+    char tmpl[] = "/tmp/cgroup_units_test.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::fprintf(stderr, "FAIL: mkdtemp\n");
+        return 1;
+    }
+    const std::string root = std::string(tmpl) + "/system.slice";
+    mkdir(root.c_str(), 0755);
+    addUnit(root + "/web.service");
+    mkdir((root + "/session.scope").c_str(), 0755); // not a service
+
+    CgroupSampler cg;
+    cg.configure("*", root);
+    check(cg.sample() && cg.unitCount() == 1, "existing unit found");
+    check(cg.rescans() == 1 && cg.events() == 0, "slice listed once at start");
+
+    // 0.1 s of CPU and 1 MiB read over ~0.2 s: ~50% of a core, ~5 MiB/s
+    writeUnit(root + "/web.service", 100000, 1 << 20);
+    sleepMs(200);
+    cg.sample();
+    check(cg.topCount() == 1, "one unit ranked");
+    const UnitUsage& u = cg.top(0);
+    std::printf("web: cpu=%.1f%% read=%llu B/s mem=%llu kB\n", static_cast<double>(u.cpu_percent),
+                static_cast<unsigned long long>(u.read_bps), static_cast<unsigned long long>(u.mem_kb));
+    check(u.cpu_percent > 35.f && u.cpu_percent <= 50.f, "CPU rate");
+    check(u.read_bps > 3500000 && u.read_bps <= 5242880, "read rate");
+    check(u.mem_kb == 8192, "memory.current");
+
+    addUnit(root + "/db.service");
+    cg.sample();
+    check(cg.unitCount() == 2 && cg.events() == 1, "new unit picked up from an event");
+    removeUnit(root + "/web.service");
+    cg.sample();
+    check(cg.unitCount() == 1 && cg.events() == 2, "removed unit dropped from an event");
+    check(cg.rescans() == 1, "no listing while the watch is live");
+
+    // The slice goes away: listed per sample until it is back, then
+    // watched again
+    removeUnit(root + "/db.service");
+    rmdir((root + "/session.scope").c_str());
+    rmdir(root.c_str());
+    cg.sample();
+    cg.sample();
+    check(cg.unitCount() == 0, "no units without the slice");
+    const uint64_t gone = cg.rescans();
+    check(gone >= 2, "slice listed while missing");
+
+    mkdir(root.c_str(), 0755);
+    addUnit(root + "/web.service");
+    cg.sample();
+    check(cg.unitCount() == 1 && cg.rescans() == gone + 1, "slice listed once it is back");
+    const uint64_t events = cg.events();
+    addUnit(root + "/db.service");
+    cg.sample();
+    cg.sample();
+    std::printf("units=%d events=%llu rescans=%llu\n", cg.unitCount(),
+                static_cast<unsigned long long>(cg.events()), static_cast<unsigned long long>(cg.rescans()));
+    check(cg.unitCount() == 2 && cg.events() == events + 1, "watch re-armed on the new slice");
+    check(cg.rescans() == gone + 1, "no listing once watched again");
+
+    removeUnit(root + "/web.service");
+    removeUnit(root + "/db.service");
+    rmdir(root.c_str());
+    rmdir(tmpl);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdio>
+
+// Shared by the tests under cpp/tests: check() reports a failed condition
+// and counts it; main() returns failures ? 1 : 0.
+inline int failures = 0;
+
+inline void check(bool ok, const char* what) {
+    if (!ok) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+        ++failures;
+    }
+}
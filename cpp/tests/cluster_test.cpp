@@ -0,0 +1,121 @@
+// Cluster mode over loopback: several sender processes, one receiver.
+// Each sender reports three samples through ClusterSender, then replays an
+// older sequence number, which the receiver has to reject. Then one node
+// restarts: its sequence starts over under a new epoch and is accepted.
+#include "check.h"
+#include "cluster.h"
+#include "metrics.h"
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kSenders = 4;
+constexpr int kSamples = 3;
+
+// Node i: 20 + 10*i % CPU, 50 + 5*i 'C, odd nodes throttled
+Stats nodeStats(int i, int sample) {
+    Stats s;
+    s.cpu_percent = 20 + 10 * i + sample;
+    s.cpu_temp_c = 50.0 + 5.0 * i;
+    s.throttle_raw = (i % 2) ? 0x4 : 0x0;
+    s.throttled = (s.throttle_raw & 0xF) != 0;
+    s.available = SRC_TEMP | SRC_THROTTLE;
+    return s;
+}
+
+bool sendRaw(const sockaddr_in& to, const Stats& s, uint8_t id, uint16_t epoch, uint32_t seq) {
+    uint8_t buf[cluster::kDatagramSize];
+    cluster::encode(s, id, epoch, seq, buf);
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ssize_t n = ::sendto(fd, buf, sizeof(buf), 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to));
+    ::close(fd);
+    return n == static_cast<ssize_t>(sizeof(buf));
+}
+
+// Read until `total` datagrams have been counted either way
+void drain(ClusterReceiver& rx, uint64_t total) {
+    for (int tries = 0; rx.received() + rx.rejected() < total && tries < 50; ++tries) {
+        pollfd p{rx.fd(), POLLIN, 0};
+        if (poll(&p, 1, 100) > 0) rx.onReadable(monotonicNs());
+    }
+}
+
+int runSender(int i, const sockaddr_in& to) {
+    ClusterSender tx;
+    if (!tx.open(to)) return 1;
+    const uint8_t id = static_cast<uint8_t>(100 + i);
+    for (int k = 0; k < kSamples; ++k) tx.send(nodeStats(i, k), id);
+    // A late duplicate of sequence 1, after 2 went out
+    bool dup = sendRaw(to, nodeStats(i, 0), id, tx.epoch(), 1);
+    return tx.sent() == kSamples && dup ? 0 : 1;
+}
+
+} // namespace
+
+int main() {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ClusterReceiver rx;
+    if (!rx.open(addr)) {
+        std::fprintf(stderr, "FAIL: bind 127.0.0.1\n");
+        return 1;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(rx.fd(), reinterpret_cast<sockaddr*>(&addr), &len);
+
+    pid_t pids[kSenders];
+    for (int i = 0; i < kSenders; ++i) {
+        pids[i] = fork();
+        if (pids[i] == 0) _exit(runSender(i, addr));
+    }
+    for (pid_t pid : pids) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "sender exited cleanly");
+    }
+
+    // Everything is queued on the socket by now; drain it
+    drain(rx, kSenders * (kSamples + 1));
+
+    const ClusterSummary sum = rx.summary(monotonicNs());
+    std::printf("nodes=%d throttled=%d worst=%.1f@%u received=%llu rejected=%llu bars=%d\n", sum.nodes,
+                sum.throttled, static_cast<double>(sum.worstTemp), sum.worstNode,
+                static_cast<unsigned long long>(rx.received()), static_cast<unsigned long long>(rx.rejected()),
+                sum.bars);
+    check(sum.nodes == kSenders, "every sender counted once");
+    check(sum.throttled == kSenders / 2, "odd nodes throttled");
+    check(sum.haveTemp && sum.worstTemp > 64.9f && sum.worstTemp < 65.1f, "worst temperature");
+    check(sum.worstNode == 100 + kSenders - 1, "hottest node");
+    check(rx.received() == static_cast<uint64_t>(kSenders * kSamples), "in-order datagrams accepted");
+    check(rx.rejected() == static_cast<uint64_t>(kSenders), "out-of-order datagrams rejected");
+    check(sum.bars == kSenders, "one bar per node");
+    for (int i = 0; i < sum.bars && i < kSenders; ++i) {
+        // Bars in id order, each with the node's newest sample
+        check(sum.barId[i] == 100 + i && sum.barCpu[i] == 20 + 10 * i + kSamples - 1, "bar per node, newest CPU");
+    }
+
+    // Node 120 sends up to sequence 5, restarts (new epoch, sequence 0),
+    // then repeats that datagram, which is a duplicate again
+    const uint64_t received = rx.received(), rejected = rx.rejected();
+    Stats before = nodeStats(0, 0), after = nodeStats(0, 0);
+    after.cpu_percent = 90;
+    bool sent = true;
+    for (uint32_t seq = 0; seq <= 5; ++seq) sent &= sendRaw(addr, before, 120, 7, seq);
+    sent &= sendRaw(addr, after, 120, 8, 0);
+    sent &= sendRaw(addr, after, 120, 8, 0);
+    check(sent, "restart datagrams sent");
+    drain(rx, received + rejected + 8);
+    const ClusterSummary restarted = rx.summary(monotonicNs());
+    check(rx.received() == received + 7 && rx.rejected() == rejected + 1, "restarted sequence accepted once");
+    check(restarted.nodes == kSenders + 1, "restarted node counted once");
+    check(restarted.bars == kSenders + 1 && restarted.barId[kSenders] == 120 && restarted.barCpu[kSenders] == 90,
+          "restarted node shows its new sample");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+// Panel effects on emulated panels: the command bytes and controller state
+// after each contrast, inversion, power and scroll transition, what a frame
+// costs after the scroll stops, the blink and fade timelines, and the
+// ticker band drawn over a frame's last page and put back when it ends.
+#include "check.h"
+#include "display_set.h"
+#include "panel_fx.h"
+#include "ssd1306.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+// What went out since the last take()
+struct Sent {
+    Bytes cmds;
+    size_t data = 0; // GDDRAM bytes
+};
+
+// Keeps the command bytes and counts the data bytes
+class RecordingBus : public MockI2CBus {
+public:
+    int rdwr(i2c_msg* msgs, size_t count) override {
+        for (size_t i = 0; i < count; ++i) record(msgs[i].buf, msgs[i].len);
+        return MockI2CBus::rdwr(msgs, count);
+    }
+    int write(const uint8_t* data, size_t len) override {
+        record(data, len);
+        return MockI2CBus::write(data, len);
+    }
+
+    Sent take() {
+        Sent out;
+        out.cmds.swap(sent_.cmds);
+        out.data = sent_.data;
+        sent_.data = 0;
+        return out;
+    }
+
+private:
+    Sent sent_;
+
+    void record(const uint8_t* buf, size_t len) {
+        if (len == 0) return;
+        if (buf[0] == 0x40) sent_.data += len - 1;
+        else sent_.cmds.insert(sent_.cmds.end(), buf + 1, buf + len);
+    }
+};
+
+constexpr uint64_t kMs = 1000000ull;
+
+std::string readFile(const std::string& path) {
+    std::string out;
+    if (FILE* f = std::fopen(path.c_str(), "rb")) {
+        char buf[4096];
+        size_t n;
+        while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+        std::fclose(f);
+    }
+    return out;
+}
+
+// Rows [y0, y1) of two PBM dumps of the same size are identical
+bool sameRows(const std::string& a, const std::string& b, int y0, int y1) {
+    const size_t header = std::string("P4\n128 32\n").size();
+    const size_t row = 128 / 8;
+    if (a.size() != b.size() || a.size() < header + 32 * row) return false;
+    const size_t off = header + static_cast<size_t>(y0) * row;
+    return a.compare(off, static_cast<size_t>(y1 - y0) * row, b, off, static_cast<size_t>(y1 - y0) * row) == 0;
+}
+
+Stats sample(int cpu) {
+    Stats s;
+    s.available = SRC_IP | SRC_FREQ | SRC_TEMP | SRC_VOLTAGE;
+    std::snprintf(s.ip_last_octet, sizeof(s.ip_last_octet), "42");
+    s.cpu_percent = cpu;
+    s.cpu_core_count = 4;
+    s.mem_percent = 33;
+    s.disk_percent = 40;
+    s.cpu_freq_ghz = 1.5;
+    s.cpu_temp_c = 54.0;
+    s.voltage_v = 0.86;
+    return s;
+}
+
+void controllerState() {
+    auto owned = std::make_unique<RecordingBus>();
+    RecordingBus* bus = owned.get();
+    SSD1306 oled(std::move(owned), 0x3C);
+    check(oled.init(), "panel init");
+    for (int i = 0; i < SSD1306::WIDTH * SSD1306::PAGES; ++i) oled.buffer()[i] = static_cast<uint8_t>(i * 7);
+    oled.markAllDirty();
+    oled.display();
+    bus->take();
+
+    oled.setContrast(0x20);
+    check(bus->take().cmds == Bytes{0x81, 0x20} && bus->contrast() == 0x20, "contrast");
+    oled.setInverted(true);
+    check(bus->take().cmds == Bytes{0xA7} && bus->inverted(), "inverted");
+    oled.setInverted(false);
+    check(bus->take().cmds == Bytes{0xA6} && !bus->inverted(), "not inverted");
+    oled.setPower(false);
+    check(bus->take().cmds == Bytes{0xAE} && !bus->displayOn(), "power off");
+    oled.setPower(true);
+    check(bus->take().cmds == Bytes{0xAF} && bus->displayOn(), "power on");
+
+    // Last page, 64 frames per column (interval code 1)
+    const Bytes scroll = {0x2E, 0x27, 0x00, 3, 1, 3, 0x00, 0xFF, 0x2F};
+    check(oled.startScroll(ScrollDir::Left, 3, 3, 64), "scroll started");
+    check(bus->take().cmds == scroll && bus->scrolling() && oled.scrolling(), "scroll commands");
+
+    // An unchanged frame only stops the scroll
+    oled.display();
+    Sent sent = bus->take();
+    check(!sent.cmds.empty() && sent.cmds[0] == 0x2E && sent.data == 0, "stop alone");
+    check(!bus->scrolling() && !oled.scrolling(), "frame stops the scroll");
+
+    // A change off the band goes out as a diff; the band stays rotated
+    oled.startScroll(ScrollDir::Left, 3, 3, 64);
+    bus->take();
+    oled.buffer()[SSD1306::WIDTH + 5] ^= 0xFF;
+    oled.markDirty(5, 5, 1);
+    oled.display();
+    sent = bus->take();
+    check(!sent.cmds.empty() && sent.cmds[0] == 0x2E && sent.data == 1, "diff under a stopped scroll");
+
+    // A change on the rotated band resends that page whole
+    oled.startScroll(ScrollDir::Left, 3, 3, 64);
+    bus->take();
+    oled.buffer()[3 * SSD1306::WIDTH + 9] ^= 0xFF;
+    oled.markDirty(9, 9, 3);
+    oled.display();
+    check(bus->take().data == SSD1306::WIDTH, "changed band page resent whole");
+    oled.display();
+    check(bus->take().data == 0, "band page in place after its resend");
+
+    // stopScroll(): the band goes back to where the shadow says
+    oled.startScroll(ScrollDir::Left, 3, 3, 64);
+    bus->take();
+    oled.stopScroll();
+    check(bus->take().cmds == Bytes{0x2E} && !bus->scrolling(), "stop command");
+    oled.display();
+    check(bus->take().data == SSD1306::WIDTH, "stopped band resent");
+
+    // A diagonal scroll moves every row: the next frame is a full one
+    oled.startScroll(ScrollDir::UpLeft, 0, 3, 64, 1);
+    bus->take();
+    oled.display();
+    check(bus->take().data == static_cast<size_t>(SSD1306::WIDTH * SSD1306::PAGES), "full frame after a diagonal scroll");
+}
+
+void timelines() {
+    const uint64_t t0 = 1000 * kMs;
+    FxAnimator fx(0xCF);
+    check(fx.state(t0) == fx.rest() && fx.stepMs() == 0, "rest");
+
+    fx.start(PanelFx::Blink, t0);
+    check(fx.stepMs() == FxAnimator::kBlinkMs, "blink step");
+    check(fx.state(t0).inverted && fx.state(t0 + 499 * kMs).inverted, "blink first phase");
+    check(!fx.state(t0 + 500 * kMs).inverted && !fx.state(t0 + 999 * kMs).inverted, "blink second phase");
+    check(fx.state(t0 + 1000 * kMs).inverted, "blink third phase");
+    check(fx.state(t0 + 500 * kMs).contrast == 0xCF && !fx.state(t0).scroll, "blink keeps the rest");
+
+    fx.start(PanelFx::Fade, t0);
+    check(fx.stepMs() == FxAnimator::kFadeStepMs, "fade step");
+    check(fx.state(t0).contrast == 0xCF && !fx.state(t0).inverted, "fade starts at full");
+    check(fx.state(t0 + 500 * kMs).contrast == 0xCF - (0xCF - 0xCF / 8) / 2, "fade halfway down");
+    check(fx.state(t0 + 599 * kMs).contrast == fx.state(t0 + 500 * kMs).contrast, "fade holds within a step");
+    check(fx.state(t0 + 1000 * kMs).contrast == 0xCF / 8, "fade bottom");
+    check(fx.state(t0 + 1500 * kMs).contrast == fx.state(t0 + 500 * kMs).contrast, "fade back up");
+    check(fx.state(t0 + 2000 * kMs).contrast == 0xCF, "fade period");
+    uint8_t prev = 0xFF;
+    bool down = true;
+    for (uint64_t ms = 0; ms <= 1000; ms += FxAnimator::kFadeStepMs) {
+        uint8_t c = fx.state(t0 + ms * kMs).contrast;
+        down = down && c < prev;
+        prev = c;
+    }
+    check(down, "fade falls every step of the first half");
+    fx.start(PanelFx::Fade, t0 + 300 * kMs);
+    check(fx.state(t0 + 1000 * kMs).contrast == 0xCF / 8, "restart keeps the phase");
+
+    fx.start(PanelFx::Ticker, t0);
+    check(fx.state(t0).scroll && fx.stepMs() == 0, "ticker scrolls");
+    fx.stop();
+    check(fx.state(t0 + 5000 * kMs) == fx.rest() && fx.active() == PanelFx::None, "stop rests");
+}
+
+void ticker(const std::string& dir) {
+    DisplayConfig cfg;
+    cfg.layout = LayoutKind::Landscape;
+    cfg.spec = "pbm:" + dir + "/ticker.pbm";
+    std::unique_ptr<DisplayUnit> unit = DisplayUnit::create(cfg, I2CTransport::kDefaultMaxTransfer);
+    cfg.spec = "pbm:" + dir + "/plain.pbm";
+    std::unique_ptr<DisplayUnit> plain = DisplayUnit::create(cfg, I2CTransport::kDefaultMaxTransfer);
+    check(unit->init() && plain->init(), "units init");
+    auto show = [&](DisplayUnit& u, int cpu) {
+        u.render(makeScreenView(sample(cpu), Page::Main, 1.2));
+        u.display();
+    };
+    auto bytes = [](DisplayUnit& u) { return u.transportCounters().bytes; };
+    const std::string tickerPbm = dir + "/ticker.pbm", plainPbm = dir + "/plain.pbm";
+
+    show(*unit, 20);
+    show(*plain, 20);
+    check(readFile(tickerPbm) == readFile(plainPbm), "same frame without the ticker");
+
+    FxAnimator fx;
+    fx.start(PanelFx::Ticker, 0);
+    uint64_t b0 = bytes(*unit);
+    unit->applyFx(fx.state(0));
+    const uint64_t bandBytes = bytes(*unit) - b0;
+    std::string t = readFile(tickerPbm), p = readFile(plainPbm);
+    check(sameRows(t, p, 0, 24) && !sameRows(t, p, 24, 32), "ticker over the last page only");
+    check(bandBytes < 200, "ticker costs a page and the scroll setup");
+
+    // A new frame under the ticker: the diff, plus at most the band page,
+    // the scroll setup and the stop (a full frame would be 512 data bytes)
+    constexpr uint64_t kStop = 8;
+    b0 = bytes(*unit);
+    uint64_t p0 = bytes(*plain);
+    show(*unit, 60);
+    show(*plain, 60);
+    t = readFile(tickerPbm);
+    p = readFile(plainPbm);
+    check(sameRows(t, p, 0, 24) && !sameRows(t, p, 24, 32), "new frame keeps the ticker");
+    check(bytes(*unit) - b0 <= bytes(*plain) - p0 + bandBytes + kStop, "no full resend under the ticker");
+
+    // Leaving the ticker with a frame queued with it (as the bus thread
+    // runs them): one transfer, and the frame's own last page is back
+    b0 = bytes(*unit);
+    p0 = bytes(*plain);
+    unit->render(makeScreenView(sample(75), Page::Main, 1.2));
+    unit->applyFx(fx.rest());
+    unit->display();
+    show(*plain, 75);
+    check(readFile(tickerPbm) == readFile(plainPbm), "band restored with the frame");
+    check(bytes(*unit) - b0 <= bytes(*plain) - p0 + bandBytes + kStop, "leaving the ticker costs one frame");
+
+    // Leaving it without a new frame
+    unit->applyFx(fx.state(0));
+    check(!sameRows(readFile(tickerPbm), readFile(plainPbm), 24, 32), "ticker back");
+    unit->applyFx(fx.rest());
+    check(readFile(tickerPbm) == readFile(plainPbm), "band restored alone");
+}
+
+} // namespace
+
+int main() {
+    char tmpl[] = "/tmp/panel_fx_test.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::fprintf(stderr, "FAIL: mkdtemp\n");
+        return 1;
+    }
+    controllerState();
+    timelines();
+    ticker(tmpl);
+
+    unlink((std::string(tmpl) + "/ticker.pbm").c_str());
+    unlink((std::string(tmpl) + "/plain.pbm").c_str());
+    rmdir(tmpl);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+// PSI on a fake proc root: /proc/pressure files parsed with and without a
+// "full" line, and RPI_STATS_PSI specs armed as triggers (plain files take
+// the trigger string as a write, so it can be read back).
+#include "check.h"
+#include "psi.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+void writeFile(const std::string& path, const char* text) {
+    if (FILE* f = std::fopen(path.c_str(), "w")) {
+        std::fputs(text, f);
+        std::fclose(f);
+    }
+}
+
+// What the last open() wrote as the trigger, NUL included
+std::string trigger(const std::string& path) {
+    char buf[64] = {};
+    size_t n = 0;
+    if (FILE* f = std::fopen(path.c_str(), "r")) {
+        n = std::fread(buf, 1, sizeof(buf) - 1, f);
+        std::fclose(f);
+    }
+    return std::string(buf, n);
+}
+
+bool near(float a, float b) { return std::fabs(a - b) < 0.001f; }
+
+} // namespace
+
+int main() {
+    char tmpl[] = "/tmp/psi_test.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::fprintf(stderr, "FAIL: mkdtemp\n");
+        return 1;
+    }
+    const std::string root = tmpl;
+    const std::string dir = root + "/pressure";
+    mkdir(dir.c_str(), 0755);
+
+    writeFile(dir + "/cpu", "some avg10=1.50 avg60=0.25 avg300=0.10 total=123456\n"
+                            "full avg10=0.75 avg60=0.05 avg300=0.00 total=2345\n");
+    ProcFile cpu(dir + "/cpu");
+    PsiAverages a;
+    check(readPsi(cpu, a), "some + full parsed");
+    check(near(a.some_avg10, 1.5f) && near(a.some_avg60, 0.25f), "some averages");
+    check(near(a.full_avg10, 0.75f) && near(a.full_avg60, 0.05f), "full averages");
+
+    // cpu before 5.13: no full line, full stays 0
+    writeFile(dir + "/cpu", "some avg10=12.34 avg60=5.00 avg300=1.00 total=99\n");
+    PsiAverages old;
+    check(readPsi(cpu, old), "some-only parsed");
+    check(near(old.some_avg10, 12.34f) && near(old.some_avg60, 5.0f), "some-only averages");
+    check(old.full_avg10 == 0.f && old.full_avg60 == 0.f, "no full line reads as 0");
+
+    writeFile(dir + "/cpu", "full avg10=1.00 avg60=1.00 avg300=1.00 total=1\n");
+    PsiAverages bad;
+    check(!readPsi(cpu, bad), "no some line is an error");
+
+    // Unknown key ignored, 0 disables memory, io above the window keeps its
+    // default
+    writeFile(dir + "/memory", "");
+    writeFile(dir + "/io", "");
+    writeFile(dir + "/cpu", "");
+    PsiMonitor mon;
+    int armed = mon.open("cpu=250,gpu=50,memory=0,io=5000", 2000, root);
+    check(armed == 2, "two triggers armed");
+    check(mon.stallMs(PSI_CPU) == 250 && mon.fd(PSI_CPU) >= 0, "cpu threshold from the spec");
+    check(mon.stallMs(PSI_MEMORY) == 0 && mon.fd(PSI_MEMORY) < 0, "memory=0 disables");
+    check(mon.stallMs(PSI_IO) == PsiMonitor::kDefaultStallMs[PSI_IO], "threshold above the window ignored");
+    check(trigger(dir + "/cpu") == std::string("some 250000 2000000", 20), "cpu trigger string");
+    check(trigger(dir + "/io") == std::string("some 300000 2000000", 20), "io trigger string");
+
+    // Empty spec: every default; a missing pressure file just isn't armed
+    unlink((dir + "/io").c_str());
+    PsiMonitor defaults;
+    check(defaults.open(nullptr, 1000, root) == 2, "defaults armed where files exist");
+    for (int r = 0; r < PSI_COUNT; ++r) {
+        check(defaults.stallMs(static_cast<PsiResource>(r)) == PsiMonitor::kDefaultStallMs[r], "default threshold");
+    }
+    check(defaults.fd(PSI_IO) < 0, "missing file not armed");
+
+    unlink((dir + "/cpu").c_str());
+    unlink((dir + "/memory").c_str());
+    rmdir(dir.c_str());
+    rmdir(tmpl);
+    return failures ? 1 : 0;
+}
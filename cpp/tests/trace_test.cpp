@@ -0,0 +1,222 @@
+// Trace format round trip: keyframes and deltas, a keyframe forced by a
+// change too wide for 16 bits, the time field wrapping at 32 bits, a clock
+// stepping back, a torn tail cut off when the file is reopened, and a short
+// write (RLIMIT_FSIZE) cut off before the next append. Everything written is
+// decoded with TraceReader and compared field by field.
+#include "check.h"
+#include "trace.h"
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int64_t kStartMs = 1700000000000;
+
+// Every field a trace keeps, different per k; disks and interfaces are one
+// "all" device each, as a replay brings them back
+Stats sample(int k) {
+    Stats s;
+    s.available = SRC_IP | SRC_FREQ | SRC_TEMP | SRC_VOLTAGE | SRC_THROTTLE | SRC_PSI;
+    std::snprintf(s.ip_last_octet, sizeof(s.ip_last_octet), "%d", 10 + k);
+    s.cpu_percent = 20 + k;
+    s.cpu_iowait_percent = k % 5;
+    s.cpu_steal_percent = k % 3;
+    s.cpu_irq_percent = 1 + k % 2;
+    s.cpu_core_count = 4;
+    for (int c = 0; c < 8; ++c) s.cpu_core_percent[c] = c < 4 ? 10 * c + k : 0;
+    s.mem_percent = 40 + k;
+    s.mem_total_kb = k < 2 ? 3900000 : 4000000; // sample 2 jumps too far for a delta
+    s.mem_available_kb = 2000000 - 1000u * static_cast<unsigned>(k);
+    s.mem_cached_kb = 500000 + 10u * static_cast<unsigned>(k);
+    s.mem_buffers_kb = 60000;
+    s.mem_dirty_kb = 100u * static_cast<unsigned>(k);
+    s.swap_used_kb = 0;
+    s.disk_percent = 55;
+    s.disk_io_count = 1;
+    std::snprintf(s.disk_io[0].name, sizeof(s.disk_io[0].name), "all");
+    s.disk_io[0].read_bps = 1024u * (100u + static_cast<unsigned>(k));
+    s.disk_io[0].write_bps = 1024u * 7u;
+    s.disk_io[0].read_iops = 3u + static_cast<unsigned>(k);
+    s.disk_io[0].write_iops = 1;
+    s.net_count = 1;
+    std::snprintf(s.net[0].name, sizeof(s.net[0].name), "all");
+    s.net[0].rx_bps = 1024u * (50u + static_cast<unsigned>(k));
+    s.net[0].tx_bps = 1024u * 9u;
+    s.net[0].rx_drops = static_cast<unsigned>(k);
+    for (int r = 0; r < PSI_COUNT; ++r) {
+        s.psi[r].some_avg10 = static_cast<float>(r + k) * 0.25f;
+        s.psi[r].some_avg60 = 1.5f;
+        s.psi[r].full_avg10 = r == PSI_CPU ? 0.f : 0.5f;
+    }
+    s.proc_count = 180 + k;
+    s.proc_scan_us = 900;
+    s.cpu_freq_ghz = 1.5 + 0.1 * (k % 3);
+    s.cpu_temp_c = 50.25 + k;
+    s.voltage_v = 0.8625;
+    s.throttle_raw = k % 4 == 3 ? 0x5 : 0;
+    s.throttled = s.throttle_raw != 0;
+    return s;
+}
+
+bool near(double a, double b, double tol) { return std::fabs(a - b) <= tol; }
+
+// Name of the first kept field that differs, or nullptr
+const char* differs(const Stats& a, const Stats& b) {
+    struct F {
+        const char* name;
+        bool same;
+    };
+    const DiskRate &da = a.disk_io[0], &db = b.disk_io[0];
+    const NetRate &na = a.net[0], &nb = b.net[0];
+    const F fields[] = {
+        {"available", a.available == b.available},
+        {"ip", std::strcmp(a.ip_last_octet, b.ip_last_octet) == 0},
+        {"cpu", a.cpu_percent == b.cpu_percent},
+        {"iowait", a.cpu_iowait_percent == b.cpu_iowait_percent},
+        {"steal", a.cpu_steal_percent == b.cpu_steal_percent},
+        {"irq", a.cpu_irq_percent == b.cpu_irq_percent},
+        {"cores", a.cpu_core_count == b.cpu_core_count &&
+                      std::memcmp(a.cpu_core_percent, b.cpu_core_percent, 8 * sizeof(int)) == 0},
+        {"mem", a.mem_percent == b.mem_percent},
+        {"mem_total", a.mem_total_kb == b.mem_total_kb},
+        {"mem_available", a.mem_available_kb == b.mem_available_kb},
+        {"mem_cached", a.mem_cached_kb == b.mem_cached_kb},
+        {"mem_buffers", a.mem_buffers_kb == b.mem_buffers_kb},
+        {"mem_dirty", a.mem_dirty_kb == b.mem_dirty_kb},
+        {"swap", a.swap_used_kb == b.swap_used_kb},
+        {"disk", a.disk_percent == b.disk_percent},
+        {"freq", near(a.cpu_freq_ghz, b.cpu_freq_ghz, 0.0005)},
+        {"temp", near(a.cpu_temp_c, b.cpu_temp_c, 0.005)},
+        {"volt", near(a.voltage_v, b.voltage_v, 0.00005)},
+        {"throttle", a.throttle_raw == b.throttle_raw && a.throttled == b.throttled},
+        {"disk_io", a.disk_io_count == b.disk_io_count && da.read_bps == db.read_bps && da.write_bps == db.write_bps &&
+                        da.read_iops == db.read_iops && da.write_iops == db.write_iops},
+        {"net", a.net_count == b.net_count && na.rx_bps == nb.rx_bps && na.tx_bps == nb.tx_bps &&
+                    na.rx_drops == nb.rx_drops && na.tx_drops == nb.tx_drops},
+        {"procs", a.proc_count == b.proc_count && a.proc_scan_us == b.proc_scan_us},
+    };
+    for (const F& f : fields) {
+        if (!f.same) return f.name;
+    }
+    for (int r = 0; r < PSI_COUNT; ++r) {
+        const PsiAverages &pa = a.psi[r], &pb = b.psi[r];
+        if (!near(pa.some_avg10, pb.some_avg10, 0.005) || !near(pa.some_avg60, pb.some_avg60, 0.005) ||
+            !near(pa.full_avg10, pb.full_avg10, 0.005) || !near(pa.full_avg60, pb.full_avg60, 0.005)) {
+            return "psi";
+        }
+    }
+    return nullptr;
+}
+
+struct Expected {
+    int64_t unixMs;
+    Stats s;
+};
+
+} // namespace
+
+int main() {
+    char path[] = "/tmp/trace_test.XXXXXX";
+    int tmp = mkstemp(path);
+    if (tmp < 0) {
+        std::fprintf(stderr, "FAIL: mkstemp\n");
+        return 1;
+    }
+    ::close(tmp);
+    ::unlink(path); // the writer creates it
+    std::vector<Expected> want;
+    std::string error;
+    const off_t header = static_cast<off_t>(sizeof(trace::Header));
+    const off_t record = static_cast<off_t>(trace::recordSize());
+
+    {
+        TraceWriter w;
+        check(w.open(path, error), "new trace opened");
+        auto put = [&](int64_t atMs, int k, int64_t shownMs) {
+            Stats s = sample(k);
+            w.append(atMs, s);
+            want.push_back({shownMs, s});
+        };
+        put(kStartMs, 0, kStartMs);               // keyframe
+        put(kStartMs + 1000, 1, kStartMs + 1000); // delta
+        put(kStartMs + 2000, 2, kStartMs + 2000); // keyframe, see sample()
+        put(kStartMs + 3000, 3, kStartMs + 3000); // delta
+        // Days apart (keyframes), up to the time field wrapping at 2^32 ms
+        put(kStartMs + 1500000000, 4, kStartMs + 1500000000);
+        put(kStartMs + 3000000000, 5, kStartMs + 3000000000);
+        put(kStartMs + 4294966796, 6, kStartMs + 4294966796);
+        put(kStartMs + 4294967796, 7, kStartMs + 4294967796); // delta across the wrap
+        put(kStartMs + 4294967000, 8, kStartMs + 4294967796); // clock stepped back: time holds
+        check(w.records() == 14 && w.errors() == 0, "records written");
+    }
+
+    // A torn record at the end, as after a crash mid-write
+    struct stat st{};
+    ::stat(path, &st);
+    check(st.st_size == header + 14 * record, "file holds whole records");
+    if (FILE* f = std::fopen(path, "ab")) {
+        std::fwrite("torn tail", 1, 9, f);
+        std::fclose(f);
+    }
+
+    {
+        TraceWriter w;
+        check(w.open(path, error), "trace reopened");
+        ::stat(path, &st);
+        check(st.st_size == header + 14 * record, "torn tail cut off on open");
+        w.append(kStartMs + 4294970000, sample(9)); // keyframe: every append starts with one
+        want.push_back({kStartMs + 4294970000, sample(9)});
+        w.append(kStartMs + 4294971000, sample(10));
+        want.push_back({kStartMs + 4294971000, sample(10)});
+
+        // Room for half a record: the next delta is written short
+        std::signal(SIGXFSZ, SIG_IGN);
+        rlimit old{};
+        getrlimit(RLIMIT_FSIZE, &old);
+        ::stat(path, &st);
+        rlimit cap = old;
+        cap.rlim_cur = static_cast<rlim_t>(st.st_size + record / 2);
+        setrlimit(RLIMIT_FSIZE, &cap);
+        w.append(kStartMs + 4294972000, sample(11));
+        setrlimit(RLIMIT_FSIZE, &old);
+        check(w.errors() == 1, "short write counted");
+
+        w.append(kStartMs + 4294973000, sample(12)); // cuts the torn bytes, then a keyframe
+        want.push_back({kStartMs + 4294973000, sample(12)});
+        w.append(kStartMs + 4294974000, sample(13));
+        want.push_back({kStartMs + 4294974000, sample(13)});
+        check(w.errors() == 1, "append after a short write succeeds");
+    }
+    ::stat(path, &st);
+    check(st.st_size == header + 20 * record, "no torn bytes left in the file");
+
+    TraceReader r;
+    check(r.open(path, error), "trace mapped");
+    check(r.records() == 20, "reader sees every record");
+    Stats got;
+    int64_t unixMs = 0;
+    size_t n = 0;
+    for (; r.next(got, unixMs); ++n) {
+        if (n >= want.size()) continue;
+        char what[96];
+        const char* field = differs(want[n].s, got);
+        std::snprintf(what, sizeof(what), "sample %zu field %s", n, field ? field : "");
+        check(!field, what);
+        std::snprintf(what, sizeof(what), "sample %zu time %lld", n, static_cast<long long>(unixMs - kStartMs));
+        check(unixMs == want[n].unixMs, what);
+    }
+    std::printf("samples=%zu/%zu records=%zu\n", n, want.size(), r.records());
+    check(n == want.size(), "every sample decoded");
+
+    ::unlink(path);
+    return failures ? 1 : 0;
+}